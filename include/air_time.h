@@ -0,0 +1,49 @@
+#ifndef AIR_TIME_H
+#define AIR_TIME_H
+
+namespace LoraDv {
+
+class Config;
+
+struct AirTimeReport {
+  int payloadSize;          // over the air superframe packet size in bytes
+  int framesPerPacket;      // audio frames per superframe packet
+  float packetAirTimeMs;    // time on air of one superframe packet
+  float packetAudioMs;      // audio duration carried by one superframe packet
+  float dutyCycle;          // air time / audio time, backlog builds up above 1.0
+  float latencyMs;          // end to end latency, superframe capture + air time + decode
+  bool isRealTime;          // audio rate can be sustained with safety margin
+};
+
+class AirTime {
+
+public:
+  static float getLoraSymbolTimeMs(int sf, long bw);
+  static bool isLoraLowDataRateOptimize(int sf, long bw);
+  static float getLoraTimeOnAirMs(int payloadSize, int sf, long bw, int cr, int preambleLen,
+    bool isImplicitHeader, bool isCrcOn);
+  static float getFskTimeOnAirMs(int payloadSize, float bitRateKbps);
+  static float getLoraRequiredSnr(int sf);
+
+  static int getCodec2FrameSize(int codec2Mode);
+  static int getCodec2FrameBits(int codec2Mode);
+  static int getCodec2FrameMs(int codec2Mode);
+
+  static bool isLoraImplicitHeader(const Config &config);
+  static float getTimeOnAirMs(const Config &config, int sf, int payloadSize);
+  static void evaluate(const Config &config, AirTimeReport &report);
+  static void evaluate(const Config &config, int sf, int codecMode, AirTimeReport &report);
+
+private:
+  static constexpr float CfgRealTimeMaxDuty = 0.9f;   // leave headroom for rx/tx turnaround and processing
+  static constexpr float CfgLdroSymbolTimeMs = 16.0f; // low data rate optimization threshold
+  static constexpr int CfgFskPreambleBits = 16;       // radiolib fsk default preamble length
+  static constexpr int CfgFskSyncWordSize = 2;        // radiolib fsk default sync word length
+  static constexpr int CfgFskLengthSize = 1;          // variable packet length field
+  static constexpr int CfgFskCrcSize = 2;             // radiolib fsk default crc length
+  static constexpr int CfgRateDescriptorSize = 1;     // adaptive rate descriptor size
+};
+
+} // LoraDv
+
+#endif // AIR_TIME_H
@@ -10,14 +10,40 @@ class AudioCodec {
 
 public:
   virtual bool start(std::shared_ptr<const Config> config) = 0;
+  // decoder only instance for received streams of another codec or mode,
+  // pcm is produced at the given rate if codec supports several
+  virtual bool startDecoder(std::shared_ptr<const Config> config, int mode, int sampleRate) = 0;
   virtual void stop() = 0;
 
+  // codec2 mode or opus bit rate, changed between transmissions
+  virtual bool setMode(int mode) = 0;
+
+  // returns 0 if codec dtx found nothing worth sending in the frame
   virtual int encode(uint8_t *encodedOut, int16_t *pcmIn) = 0;
-  virtual int decode(int16_t *pcmOut, uint8_t *encodedIn, uint16_t encodedSize) = 0;
+  virtual int decode(int16_t *pcmOut, const uint8_t *encodedIn, uint16_t encodedSize) = 0;
+
+  // packet loss concealment, synthesizes one missing frame
+  virtual int conceal(int16_t *pcmOut) = 0;
+
+  // missing frame from redundancy carried by the next frame, concealed if there is none
+  virtual int recover(int16_t *pcmOut, const uint8_t *nextEncodedIn, uint16_t nextEncodedSize) = 0;
+
+  // expected link packet loss, codec could spend bit rate on redundancy for it
+  virtual void setPacketLoss(int lossPercent) = 0;
+
+  // encoder quality for cpu time trade off, false if codec has no such control
+  virtual bool setComplexity(int complexity) = 0;
+
+  // frame length within superframe, below 8 * frame size if frames are bit-packed
+  virtual int getFrameBits() const = 0;
 
   virtual bool isFixedFrameSize() const = 0;
+
+  // native codec rate, i2s audio is resampled to it
+  virtual int getSampleRate() const = 0;
   
   virtual int getFrameSize() const = 0;
+  virtual int getFrameBufferSize() const = 0;
   virtual int getPcmFrameSize() const = 0;
   virtual int getPcmFrameBufferSize() const = 0;
 };
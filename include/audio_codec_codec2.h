@@ -8,25 +8,54 @@ namespace LoraDv {
 class AudioCodecCodec2 : public AudioCodec {
 
 public:
+  static const int CfgSampleRate = 8000;     // all modes are narrowband
+
   AudioCodecCodec2();
 
+  // codec2 allocates its state itself, only the largest frames are placed in the arena
+  static size_t getArenaSize(const Config &config);
+  static int getMaxPcmFrameSize(const Config &config, int sampleRate);
+
   virtual bool start(std::shared_ptr<const Config> config) override;
+  virtual bool startDecoder(std::shared_ptr<const Config> config, int mode, int sampleRate) override;
   virtual void stop() override;
 
+  virtual bool setMode(int mode) override;
+
   virtual int encode(uint8_t *encodedOut, int16_t *pcmIn) override;
-  virtual int decode(int16_t *pcmOut, uint8_t *encodedIn, uint16_t encodedSize) override;
+  virtual int decode(int16_t *pcmOut, const uint8_t *encodedIn, uint16_t encodedSize) override;
+  virtual int conceal(int16_t *pcmOut) override;
+  virtual int recover(int16_t *pcmOut, const uint8_t *nextEncodedIn, uint16_t nextEncodedSize) override;
+
+  virtual void setPacketLoss(int lossPercent) override {}
+  virtual bool setComplexity(int complexity) override { return false; }
 
   virtual bool isFixedFrameSize() const override { return true; }
 
+  virtual int getSampleRate() const override { return CfgSampleRate; }
+
+  virtual int getFrameBits() const override { return codecBitsPerFrame_; }
   virtual int getFrameSize() const override;
+  virtual int getFrameBufferSize() const override { return CfgMaxFrameSize; }
   virtual int getPcmFrameSize() const override;
   virtual int getPcmFrameBufferSize() const override;
 
 private:
+  static const int CfgMaxFrameSize = 8;       // largest frame among all modes
+  static const int CfgMaxPcmFrameSize = 320;  // largest pcm frame among all modes
+  static const int CfgMaxFadeShift = 4;       // concealed frame fade out steps
+
   struct CODEC2 *codec_; 
+  int mode_;
 
+  bool isBitPacked_;
   int codecSamplesPerFrame_;
   int codecBytesPerFrame_;
+  int codecBitsPerFrame_;
+
+  uint8_t lastFrame_[CfgMaxFrameSize];
+  bool hasLastFrame_;
+  int concealedInRow_;
 };
 
 } // namespace LoraDv
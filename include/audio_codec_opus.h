@@ -3,32 +3,57 @@
 
 #include <opus.h>
 #include "audio_codec.h"
+#include "heap_arena.h"
 
 namespace LoraDv {
 
 class AudioCodecOpus : public AudioCodec {
 
 public:
-  AudioCodecOpus();
+  // encoder and decoder state is placed in the arena if given, it is released with the arena
+  AudioCodecOpus(HeapArena *arena = nullptr);
+
+  // arena share of the state and the largest frames for the configured sample rate
+  static size_t getArenaSize(const Config &config);
+  static int getMaxPcmFrameSize(const Config &config, int sampleRate);
 
   virtual bool start(std::shared_ptr<const Config> config) override;
+  virtual bool startDecoder(std::shared_ptr<const Config> config, int mode, int sampleRate) override;
   virtual void stop() override;
 
+  virtual bool setMode(int mode) override;
+
   virtual int encode(uint8_t *encodedOut, int16_t *pcmIn) override;
-  virtual int decode(int16_t *pcmOut, uint8_t *encodedIn, uint16_t encodedSize) override;
+  virtual int decode(int16_t *pcmOut, const uint8_t *encodedIn, uint16_t encodedSize) override;
+  virtual int conceal(int16_t *pcmOut) override;
+  virtual int recover(int16_t *pcmOut, const uint8_t *nextEncodedIn, uint16_t nextEncodedSize) override;
+
+  virtual void setPacketLoss(int lossPercent) override;
+  virtual bool setComplexity(int complexity) override;
+
+  virtual int getFrameBits() const override { return 0; }
 
   virtual bool isFixedFrameSize() const override { return false; }
 
+  virtual int getSampleRate() const override { return sampleRate_; }
+
   virtual int getFrameSize() const override { return encodedFrameBufferSize_; }
+  virtual int getFrameBufferSize() const override { return encodedFrameBufferSize_; }
   virtual int getPcmFrameSize() const override { return pcmFrameSize_; };
   virtual int getPcmFrameBufferSize() const override { return pcmFrameBufferSize_; };
 
 private:
   const int CfgComplexity = 0;
-  const int CfgEncodedFrameBufferSize = 1024;
+  static const int CfgEncodedFrameBufferSize = 1024;
+  const int CfgDtxFrameSize = 2;          // encoded frames up to this size need not be sent
+  static const int CfgMaxPacketMs = 120;  // longest opus packet, bounds decoded output
 
+  HeapArena *arena_;
   OpusEncoder *opusEncoder_;
   OpusDecoder *opusDecoder_;
+  int sampleRate_;
+  bool isFecEnabled_;
+  bool isDtxEnabled_;
 
   int pcmFrameSize_;
   int pcmFrameBufferSize_;
@@ -0,0 +1,48 @@
+#ifndef AUDIO_GAIN_H
+#define AUDIO_GAIN_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+// Fixed point playback gain with look-ahead limiter and soft clipper.
+//
+// Volume is applied as Q3.12 gain, so up to 8x fits into 32 bit products
+// of 16 bit samples without floating point. The whole frame is known in
+// advance, so limiter gain ramps down to reach its target at the loudest
+// sample and recovers slowly over the following frames. Residual peaks
+// above the limiter level are rounded off by a quadratic soft knee, which
+// reaches full scale with zero slope and saturates beyond, instead of
+// wrapping around.
+class AudioGain {
+
+public:
+  static const int CfgGainShift = 12;             // gain fraction bits
+
+  AudioGain();
+
+  void setVolume(int volume);                     // volume in percent
+  void reset();
+
+  // input and output could be the same buffer
+  void process(const int16_t *pcmIn, int16_t *pcmOut, int sampleCount);
+
+private:
+  static const int32_t CfgLimitLevel = 29204;     // limiter threshold, -1 dBFS
+  static const int32_t CfgMaxLevel = 32767;       // soft clipper saturation level
+  static const int32_t CfgKneeWidth = 2 * (CfgMaxLevel - CfgLimitLevel); // input span of the soft knee
+  static const int32_t CfgKneeRecip = (1 << 24) / (2 * CfgKneeWidth) + 1; // rounded up, knee stays below full scale
+  static const int CfgReleaseShift = 3;           // gain recovers by 1/8 per frame
+  static const int CfgRampShift = 8;              // extra gain bits while ramping
+
+  static inline int16_t softClip(int32_t sample);
+
+private:
+  int volume_;
+  int32_t volumeGain_;
+  int32_t gain_;
+};
+
+} // LoraDv
+
+#endif // AUDIO_GAIN_H
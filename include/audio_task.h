@@ -9,11 +9,35 @@
 #include "loradv_config.h"
 #include "pm_service.h"
 #include "audio_codec.h"
+#include "voice_fec.h"
+#include "rate_controller.h"
+#include "voice_header.h"
+#include "jitter_buffer.h"
+#include "packet_queue.h"
+#include "audio_gain.h"
+#include "mic_dsp.h"
+#include "voice_activity.h"
+#include "resampler.h"
+#include "opus_superframe.h"
+#include "complexity_controller.h"
+#include "decoder_cache.h"
+#include "heap_arena.h"
 
 namespace LoraDv {
 
 class RadioTask;
 
+struct AudioStageStats {
+  long frames;          // frames passed through the stage
+  long dropped;         // frames lost on a full queue
+  int64_t totalUs;      // time spent in the stage
+  uint32_t maxUs;       // longest time spent on one frame
+
+  void add(uint32_t us) { frames++; totalUs += us; if (us > maxUs) maxUs = us; }
+  uint32_t getAvgUs() const { return frames > 0 ? (uint32_t)(totalUs / frames) : 0; }
+  void reset() { frames = 0; dropped = 0; totalUs = 0; maxUs = 0; }
+};
+
 class AudioTask {
 
 public:
@@ -28,38 +52,159 @@ public:
   void record() const;
 
   void setPtt(bool isPttOn);
+  // codec is rebuilt from the changed config between transmissions
+  void reconfigure() const;
 
   inline void setVolume(int volume) { if (volume <= maxVolume_) volume_ = volume; }
   void changeVolume(int deltaVolume);
   inline int getVolume() const { return volume_; }
 
+  inline const VoiceStreamStats &getRxStats() const { return rxTracker_.getStats(); }
+  inline const JitterBufferStats &getPlayoutStats() const { return jitterBuffer_.getStats(); }
+
+  inline const AudioStageStats &getCaptureStats() const { return captureStats_; }
+  inline const AudioStageStats &getEncodeStats() const { return encodeStats_; }
+  inline const AudioStageStats &getDecodeStats() const { return decodeStats_; }
+  inline const AudioStageStats &getPlaybackStats() const { return playbackStats_; }
+  inline const ComplexityStats &getComplexityStats() const { return complexityController_.getStats(); }
+
 private:
   const i2s_port_t CfgAudioI2sSpkId = I2S_NUM_0;  // audio i2s speaker number
   const i2s_port_t CfgAudioI2sMicId = I2S_NUM_1;  // audio i2s mic number
 
   const uint32_t CfgAudioPlayBit = 0x01;          // task bit for playback
   const uint32_t CfgAudioRecBit = 0x02;           // task bit for recording
+  const uint32_t CfgAudioFrameBit = 0x04;         // task bit for captured frame
+  const uint32_t CfgAudioConfigBit = 0x08;        // task bit for config change
 
   const int CfgAudioTaskStack = 32768;            // audio stack size
+  const int CfgAudioTaskCore = 1;                 // encode and decode worker core
+  const int CfgAudioIoTaskStack = 4096;           // capture and playback stack size
+  const int CfgAudioIoTaskCore = 0;               // i2s capture and playback core, shared with radio
+  const int CfgAudioIoTaskPriority = 6;           // i2s stages preempt radio
+  const int CfgCaptureWaitMs = 100;               // captured frame wait, ptt is checked after
+  const int CfgMicDspBudgetPercent = 10;          // mic dsp share of the frame duration
   const int CfgPlayCompletedDelayMs = 500;        // playback stopped status after ms
+  const int CfgFecFlushDelayMs = 100;             // extra wait for missing fec packets
+  const int CfgPlayoutLeadFrames = 2;             // frames queued to i2s ahead of playback
+  const int CfgMaxLostConcealMs = 400;            // longest concealed sequence gap
+  const int CfgSidIntervalMs = 400;               // silence descriptor repeat period in speech pauses
+  const int CfgInitialLossPercent = 5;            // expected link loss before any stream is measured
+  const int CfgLossGainShift = 2;                 // link loss smoothing over received streams, 1/4
+  const int CfgSwitchPollMs = 20;                 // idle i2s stages are polled before codec switch
+  const uint32_t CfgMaxSwitchUs = 100000;         // codec switch time budget
 
 private:
   void installAudio(int bytesPerSample) const;
   void uninstallAudio() const;
 
+  static const int CfgPcmSlotSize = 1920;         // longest opus frame, 120 ms at 8 kHz, limits own codec slots
+  static const int CfgCaptureQueueSlots = 8;      // captured frames buffered for encoder
+  static const int CfgPlaybackQueueSlots = 4;     // decoded frames buffered for speaker
+  static const int CfgPreRollSlots = 4;           // captured frames held back before speech onset
+
   static void task(void *param);
+  static void captureTask(void *param);
+  static void playbackTask(void *param);
 
   void audioTask();
+  void audioCaptureTask();
+  void audioPlaybackTask();
+  bool audioTaskSetupCodec();
+  void audioTaskStopCodec();
+  bool audioTaskCanReconfigure() const;
+  void audioTaskReconfigure();
+  void audioTaskShutdown();
+  size_t audioTaskArenaSize(int codec, int captureSlotSize, int fecDepth, int fecPacketSize, uint32_t micDspStages) const;
+  size_t audioTaskMaxArenaSize() const;
+  int audioTaskCaptureSlotSize() const;
+  uint32_t audioTaskMicDspStages() const;
+  int audioTaskFecPacketSize() const;
+  void audioTaskLogStage(const char *name, AudioStageStats &stats);
+  void audioTaskLogAllocs(const char *name, uint32_t allocCount) const;
+  void audioTaskLogMicDsp();
+  void audioTaskLogComplexity();
   void audioTaskPlay();
+  void audioTaskPlayFrame(const uint8_t *encodedFrame, int encodedFrameSize);
+  void audioTaskPlaySuperframe(const uint8_t *packet, int packetSize);
+  void audioTaskPlayConceal();
+  void audioTaskPlayComfortNoise();
+  void audioTaskPlayPcm(int pcmFrameSize);
+  void audioTaskPlayFec();
+  void audioTaskPlayLost(long lostCount);
+  bool audioTaskPlayHeader(const uint8_t *packet, int packetSize, bool &isEot);
+  void audioTaskPlayEnd();
+  void audioTaskPlayout();
+  void audioTaskPlayoutEnd();
+  void audioTaskPlayoutFlush();
+  void audioTaskUpdateLoss(const VoiceStreamStats &stats);
+  void audioTaskSetupPlayout();
+  TickType_t audioTaskWaitTicks() const;
+  void audioTaskSetupVad();
+  void audioTaskSetupComplexity();
+  bool audioTaskSetupResampler();
+  int audioTaskI2sFrameSize() const { return codecSamplesPerFrame_ * i2sSampleRate_ / codecSampleRate_; }
+  int16_t *audioTaskCaptureFrame(const PacketView &pcmFrame, int &sampleCount);
+  void audioTaskCaptureStart();
+  void audioTaskVox();
   void audioTaskRecord();
+  void audioTaskRecordDelayed(bool isVoice);
+  void audioTaskRecordFrame(int16_t *pcmFrame, bool isVoice);
+  bool audioTaskRecordBegin();
+  void audioTaskRecordPackFrame();
+  // padding of the last byte is always shorter than a frame
+  int audioTaskRecordFrameCount() const { return 8 * (txPacketSize_ - packetHeaderSize_) / codecBitsPerFrame_; }
+  bool audioTaskRecordSuperframe();
+  void audioTaskRecordPause();
+  void audioTaskRecordSend();
+  void audioTaskRecordFlush(bool isEot);
+  void audioTaskRecordFec(bool isEot);
+  void audioTaskRecordEot();
+  void audioTaskRecordSid();
+  void audioTaskRecordPad();
+  void audioTaskSetProfile(const RateProfile &profile);
+  bool audioTaskSelectDecoder(uint8_t codecId);
+  void audioTaskSetupFec(const RateProfile &profile);
 
   void playTimerReset();
+  void playTimerStop();
   static bool playTimerEnter(void *param);
   void playTimer();
 
 private:
   std::shared_ptr<const Config> config_;
   TaskHandle_t audioTaskHandle_;
+  TaskHandle_t captureTaskHandle_;
+  TaskHandle_t playbackTaskHandle_;
+
+  // slots are in the arena, capture ones are sized by the own codec frame
+  PacketQueue<CfgCaptureQueueSlots> captureQueue_;
+  PacketQueue<CfgPlaybackQueueSlots> playbackQueue_;
+  PacketQueue<CfgPreRollSlots> preRollQueue_;
+
+  // codec state and frame buffers, allocation counts are logged per stream
+  HeapArena audioArena_;
+  uint32_t playoutAllocCount_;
+  int16_t *captureDropBuffer_;
+  volatile int captureSamples_;
+  volatile bool isCapturing_;
+
+  AudioStageStats captureStats_;
+  AudioStageStats encodeStats_;
+  AudioStageStats decodeStats_;
+  AudioStageStats playbackStats_;
+
+  int i2sSampleRate_;
+  int codecSampleRate_;
+  Resampler captureResampler_;
+  Resampler playbackResampler_;
+  int16_t *captureFrameBuffer_;
+  int16_t *playbackFrameBuffer_;
+
+  MicDsp micDsp_;
+  bool isComplexityAdaptive_;
+  ComplexityController complexityController_;
+  VoiceActivityDetector vad_;
 
   std::shared_ptr<RadioTask> radioTask_;
   std::shared_ptr<PmService> pmService_;
@@ -69,16 +214,66 @@ private:
 
   std::shared_ptr<AudioCodec> audioCodec_;
 
+  // received stream could use other codec than the own one
+  DecoderCache decoderCache_;
+  std::shared_ptr<AudioCodec> rxCodec_;
+  uint8_t rxCodecId_;
+  int rxBytesPerFrame_;
+  int rxBitsPerFrame_;
+
   int16_t *pcmFrameBuffer_;
   uint8_t *encodedFrameBuffer_;
+  int encodedFrameBufferSize_;
 
   int codecSamplesPerFrame_;
   int codecBytesPerFrame_;
+  int codecBitsPerFrame_;   // frame length in superframe, codec2 frames could be bit-packed
+  int codecMode_;
+
+  bool isReconfigPending_;
+  bool isFixedPacketSize_;
+  bool isVoiceHdr_;
+  int packetHeaderSize_;
+  uint8_t txSeq_;
+  byte *txPacket_;
+  int txPacketSize_;
+  VoiceStreamTracker rxTracker_;
+  int linkLossPercent_;     // smoothed loss of received streams, expected for own transmission
+
+  bool isOpusSuperframe_;
+  OpusSuperframe opusSuperframe_;
+
+  JitterBuffer jitterBuffer_;
+  uint8_t *jitterStorage_;
+  bool isPlayoutStarted_;
+  uint32_t playoutNextMs_;
+
+  bool isFecEnabled_;
+  int fecFlushTimeoutMs_;
+  uint32_t fecFlushAtMs_;
+  VoiceFecEncoder fecEncoder_;
+  VoiceFecDecoder fecDecoder_;
+  uint8_t *fecEncoderBuffer_;
+  uint8_t *fecDecoderBuffer_;
+  int fecDepth_;            // fec buffers are sized for these till the next setup
+  int fecPacketSize_;
+
+  bool isDtxEnabled_;
+  bool isVoxEnabled_;
+  int preRollFrames_;       // frames sent in front of detected speech
+  int voiceFrames_;         // delayed frames which are still within speech
+  bool isTalkSpurt_;
+  uint32_t lastSidMs_;
+  int comfortNoiseLevel_;
+  uint32_t comfortNoiseSeed_;
 
+  AudioGain playbackGain_;
   long volume_;
   long maxVolume_;
 
-  bool isPttOn_;
+  volatile bool isPttOn_;
+  volatile bool isVoxListening_;
+  volatile bool isVoxKeyed_;
   volatile bool isRunning_;
   volatile bool shouldUpdateScreen_;
   volatile bool isPlaying_;
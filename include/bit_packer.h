@@ -0,0 +1,22 @@
+#ifndef BIT_PACKER_H
+#define BIT_PACKER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+// Packs codec frames back to back at bit positions, msb first as codec2
+// stores its bits, so frames which are not byte aligned need no padding.
+// Unused bits of the last written byte are cleared.
+class BitPacker {
+
+public:
+  static int getSize(int bitCount) { return (bitCount + 7) / 8; }
+
+  static void write(uint8_t *data, int bitPos, const uint8_t *frame, int bitCount);
+  static void read(const uint8_t *data, int bitPos, uint8_t *frame, int bitCount);
+};
+
+} // LoraDv
+
+#endif // BIT_PACKER_H
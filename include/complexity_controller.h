@@ -0,0 +1,63 @@
+#ifndef COMPLEXITY_CONTROLLER_H
+#define COMPLEXITY_CONTROLLER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+struct ComplexityStats {
+  long frames;          // measured encoder calls
+  long raised;          // complexity steps up
+  long lowered;         // complexity steps down
+  long overruns;        // frames encoded slower than real time
+  uint32_t maxCycles;   // longest encoder call
+  int complexity;       // current encoder complexity
+};
+
+// Encoder complexity control from measured encode time against the frame deadline.
+//
+// Encoder gets a share of the frame duration, the rest is left for mic dsp,
+// radio and the other core's interrupts. Complexity goes down right away
+// when a frame exceeds the budget, so deadline is kept, and goes up one step
+// after the decaying peak of encode time stays well below the budget for a
+// while, the wait is doubled after each step down, so it does not oscillate.
+// Does not depend on the platform, cycles are passed by the caller.
+class ComplexityController {
+
+public:
+  static const int CfgMinComplexity = 0;
+  static const int CfgMaxComplexity = 10;
+
+  ComplexityController();
+
+  void setup(uint32_t frameCycles, int complexity);
+  void reset();
+  void resetStats();
+
+  // returns true if complexity has changed
+  bool update(uint32_t cycles);
+
+  int getComplexity() const { return complexity_; }
+  inline const ComplexityStats &getStats() const { return stats_; }
+
+private:
+  static const int CfgBudgetPercent = 50;         // encoder share of the frame duration
+  static const int CfgRaisePercent = 60;          // peak below this part of the budget allows a step up
+  static const int CfgRaiseFrames = 16;           // frames with headroom in row before a step up
+  static const int CfgMaxRaiseFrames = 512;       // wait limit, doubled after every step down
+  static const int CfgPeakDecayShift = 4;         // peak falls by 1/16 per frame
+
+private:
+  uint32_t frameCycles_;
+  uint32_t budgetCycles_;
+  uint32_t peakCycles_;
+  int complexity_;
+  int calmFrames_;
+  int raiseFrames_;
+
+  ComplexityStats stats_;
+};
+
+} // LoraDv
+
+#endif // COMPLEXITY_CONTROLLER_H
@@ -63,6 +63,8 @@
 #define CFG_LORA_CRC                1           // 0 - disabled, 1 - 1 byte, 2 - 2 bytes
 #define CFG_LORA_SYNC               0x12        // sync word (0x12 - private used by other trackers, 0x34 - public used by LoRaWAN)
 #define CFG_LORA_PREAMBLE_LEN       8           // preamble length from 6 to 65535
+#define CFG_LORA_ADAPTIVE           false       // adapt spreading factor and codec mode to link quality
+#define CFG_LORA_IMPLICIT           false       // implicit header fixed size packets for codec2, always on for SF6
 
 // fsk modem default parameters (they need to match between devices!!!)
 #define CFG_FSK_BIT_RATE            4.8         // bit rate in Kbps from 0.6 to 300.0
@@ -103,15 +105,28 @@
 #define CFG_AUDIO_CODEC_CODEC2      0
 #define CFG_AUDIO_CODEC_OPUS        1
 #define CFG_AUDIO_CODEC             CFG_AUDIO_CODEC_CODEC2
-#define CFG_AUDIO_SAMPLE_RATE       8000
+#define CFG_AUDIO_SAMPLE_RATE       8000        // i2s rate, 8000, 12000, 16000, 24000 or 48000
+#define CFG_AUDIO_OPUS_SAMPLE_RATE  8000        // opus codec rate, resampled from i2s rate
 #define CFG_AUDIO_CODEC2_MODE       CODEC2_MODE_1600
 #define CFG_AUDIO_MAX_PKT_SIZE      48          // maximum super frame size
 #define CFG_AUDIO_MAX_VOL           500         // maximum volume
 #define CFG_AUDIO_VOL               300         // default volume
+#define CFG_AUDIO_FEC_DEPTH         0           // codec2 fec interleaving depth in packets (1-7), 0 - disabled
+#define CFG_AUDIO_CODEC2_BITPACK    false       // codec2 frames without padding bits (1300, 700C), off for codec2_talkie
+#define CFG_AUDIO_VOICE_HDR         false       // sequence, codec and end of transmission header, off for codec2_talkie
+#define CFG_AUDIO_MIC_DSP           false       // high-pass, noise gate, agc and compressor before encoder
+#define CFG_AUDIO_NOISE_SUP         false       // spectral subtraction noise suppression before encoder
+#define CFG_AUDIO_DTX               false       // stop sending audio in speech pauses while ptt is pressed
+#define CFG_AUDIO_VOX               false       // start transmission on speech without ptt
+#define CFG_AUDIO_VOX_HANG_MS       500         // keep transmitting after speech ends, also for dtx
+#define CFG_AUDIO_VOX_PREROLL_MS    120         // audio sent from before the speech was detected
 
 // audio, opus
 #define CFG_AUDIO_OPUS_BITRATE      3200
 #define CFG_AUDIO_OPUS_PCMLEN       120
+#define CFG_AUDIO_OPUS_SUPERFRAME   false       // multi-frame opus packets, off for codec2_talkie
+#define CFG_AUDIO_OPUS_CBR          false       // constant bit rate, predictable packet sizes
+#define CFG_AUDIO_OPUS_FEC          true        // in-band fec for measured loss, opus uses it at higher bit rates
 
 // audio, experimental
 #define CFG_AUDIO_ENABLE_PRIVACY    false
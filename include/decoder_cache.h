@@ -0,0 +1,59 @@
+#ifndef DECODER_CACHE_H
+#define DECODER_CACHE_H
+
+#include <stdint.h>
+#include <memory>
+
+#include "audio_codec.h"
+
+namespace LoraDv {
+
+// Decoders for received streams of a codec other than the own one.
+//
+// Decoder is created on the first packet of such stream and reused for the
+// next ones, it is keyed by the voice header codec id. At most
+// CfgMaxDecoders are kept, least recently used one is replaced when the
+// cache is full, decoders not used for CfgIdleMs are freed, so memory is
+// held only while mixed codec stations are heard.
+class DecoderCache {
+
+public:
+  static const int CfgMaxDecoders = 2;            // decoders kept besides the own codec
+  static const uint32_t CfgIdleMs = 60000;        // unused decoder is freed after
+
+  DecoderCache();
+  ~DecoderCache();
+
+  // decoded audio is produced at the given rate if codec supports several
+  void setup(std::shared_ptr<const Config> config, int sampleRate);
+  void clear();
+
+  // cached or new decoder, nullptr if codec id is unknown or decoder could not start
+  std::shared_ptr<AudioCodec> get(uint8_t codecId, uint32_t now);
+  void evict(uint32_t now);
+
+  // time till the next idle decoder is freed, -1 if cache is empty
+  int getEvictWaitMs(uint32_t now) const;
+
+  // codec id of a packet without voice header, own codec unless its framing could not produce the packet
+  static uint8_t detectCodec(const Config &config, int codecMode, const uint8_t *packet, int packetSize);
+
+private:
+  struct Entry {
+    std::shared_ptr<AudioCodec> codec;
+    uint8_t codecId;
+    uint32_t lastUsedMs;
+  };
+
+  static std::shared_ptr<AudioCodec> create(uint8_t codecId);
+  void release(Entry &entry);
+
+private:
+  std::shared_ptr<const Config> config_;
+  int sampleRate_;
+  Entry entries_[CfgMaxDecoders];
+};
+
+} // LoraDv
+
+#endif // DECODER_CACHE_H
@@ -0,0 +1,57 @@
+#ifndef HEAP_ARENA_H
+#define HEAP_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace LoraDv {
+
+// Memory of one subsystem, reserved as a single heap block on start.
+//
+// Allocations bump a pointer within the block and are all released at once
+// on reset, so buffers and codec state are rebuilt in place when the codec
+// is switched, and the heap does not fragment over long uptimes. Block is
+// allocated once by the first reserve, it is never replaced, so it should
+// be reserved at the largest size the subsystem could need. Global operator
+// new calls, nothrow ones included, are counted, so steady state could be
+// verified to make none. Aligned c++17 versions are not replaced, firmware
+// is c++11. Direct malloc calls, e.g. inside codec2 and opus, are not seen.
+class HeapArena {
+
+public:
+  static const size_t CfgAlign = 8;               // allocation size granularity, keeps codec state word aligned
+
+  HeapArena(const char *name);
+  ~HeapArena();
+
+  // allocates the block on first call, later calls fail if it is too small,
+  // everything allocated before is released
+  bool reserve(size_t size);
+  void reset();
+  void release();
+
+  // nullptr if the block is exhausted
+  void *allocate(size_t size);
+  template<typename T> T *allocate(int count) { return static_cast<T*>(allocate(sizeof(T) * count)); }
+
+  // upper bound of the block size for the allocation of the given size
+  static size_t getBlockSize(size_t size) { return (size + CfgAlign - 1) / CfgAlign * CfgAlign; }
+
+  size_t getSize() const { return size_; }
+  size_t getUsed() const { return used_; }
+  void logReport() const;
+
+  static uint32_t getAllocCount();
+  static void logHeap();
+
+private:
+  const char *name_;
+  uint8_t *block_;
+  size_t size_;
+  size_t used_;
+  size_t peak_;
+};
+
+} // LoraDv
+
+#endif // HEAP_ARENA_H
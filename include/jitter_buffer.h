@@ -0,0 +1,110 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+struct JitterBufferStats {
+  long underruns;       // frames concealed because buffer ran empty
+  long overruns;        // frames dropped to keep latency bounded or on full buffer
+  long concealed;       // all concealed frames, including erased ones
+  int jitterMs;         // smoothed packet inter-arrival jitter
+  int targetDelayMs;    // current playout delay
+};
+
+// Playout buffer of encoded frames between the radio queue and the speaker.
+//
+// Frames arrive in bursts, one radio packet or fec block at a time, and
+// are played one per frame period. Playback starts after the target delay,
+// which follows the smoothed inter-arrival jitter (RFC 3550 estimator), so
+// late packets do not cause audible gaps. Empty buffer during the stream
+// and erased frames are returned as conceal requests for the codec plc.
+// Does not depend on the platform, time is passed by the caller. Frame
+// storage of CfgBufferSize bytes is placed by the caller.
+class JitterBuffer {
+
+public:
+  static const int CfgBufferSize = 4096;          // encoded frames storage in bytes
+  static const int CfgMaxFrames = 128;            // maximum buffered frames
+
+  enum class Frame {
+    None,               // nothing to play, buffering or stream is over
+    Audio,              // encoded frame is returned
+    Conceal,            // frame is missing, codec needs to conceal it
+    Silence             // speech pause signalled by sender, comfort noise is played
+  };
+
+  JitterBuffer();
+
+  void setup(int frameMs, uint8_t *storage);
+  void reset();
+
+  bool isActive() const { return frameCount_ > 0 || isPlaying_; }
+  int getFrameMs() const { return frameMs_; }
+
+  // frames pushed since previous arrival are one burst
+  bool push(const uint8_t *frame, int frameSize);
+  bool pushErased();
+  // lost packet frames, the ones already concealed on underrun are skipped
+  void pushLost(int frameCount);
+  void onArrival(uint32_t nowMs);
+  void onEndOfStream() { isEndOfStream_ = true; }
+  // sender stopped sending audio, could be repeated to keep the stream alive
+  void onSilence();
+
+  // called once per frame period, frame is valid till next push
+  Frame pop(uint32_t nowMs, const uint8_t *&frame, int &frameSize);
+  // next buffered frame if it is not erased, for codec fec of the concealed one
+  bool peek(const uint8_t *&frame, int &frameSize) const;
+
+  inline const JitterBufferStats &getStats() const { return stats_; }
+
+private:
+  static const int CfgJitterGainShift = 4;        // jitter smoothing, 1/16 as in rfc 3550
+  static const int CfgJitterFactor = 2;           // delay in jitter units
+  static const int CfgMaxDelayMs = 1000;          // upper playout delay limit
+  static const int CfgStreamTimeoutMs = 500;      // stop concealing after no frames for ms
+  static const int CfgSilenceTimeoutMs = 2000;    // stop comfort noise after no silence updates for ms
+
+  struct Entry {
+    uint16_t offset;    // frame position in storage
+    uint16_t size;      // zero for erased frame
+    uint16_t span;      // size with skipped storage tail in front of it
+  };
+
+  bool allocate(int frameSize, int &offset);
+  void onTalkSpurt();
+  void dropOldest();
+  void updateTargetDelay();
+
+private:
+  int frameMs_;
+
+  uint8_t *storage_;
+  Entry entries_[CfgMaxFrames];
+  int head_;
+  int frameCount_;
+  int writePos_;
+  int usedBytes_;
+
+  bool isPlaying_;
+  bool isEndOfStream_;
+  bool isSilence_;
+  int silenceInRow_;
+  uint32_t firstFrameMs_;
+  int concealedInRow_;
+
+  bool hasArrival_;
+  uint32_t lastArrivalMs_;
+  int lastBurstMs_;
+  int maxBurstMs_;
+  int burstFrames_;
+  int jitterMs16_;
+
+  JitterBufferStats stats_;
+};
+
+} // LoraDv
+
+#endif // JITTER_BUFFER_H
@@ -37,6 +37,8 @@ public:
   int LoraSync_;        // lora sync word/packet id, 0x34
   int LoraCrc_;         // lora crc mode, 0 - disabled, 1 - 1 byte, 2 - 2 bytes
   int LoraPreambleLen_; // lora preamble length from 6 to 65535
+  bool LoraAdaptive;    // adaptive spreading factor and codec mode
+  bool LoraImplicit;    // implicit header fixed size packets for codec2
 
   // fsk modulation parameters
   float FskBitRate;     // fsk bit rate, 0.6 - 300.0 Kbps
@@ -61,15 +63,28 @@ public:
 
   // audio params
   int AudioCodec;         // type of audio codec, 0 - Codec2, 1 - OPUS
-  uint32_t AudioSampleRate_; // Sample rate
+  uint32_t AudioSampleRate_; // i2s mic and speaker sample rate
 
   // codec2
   int AudioCodec2Mode;   // Audio Codec2 mode
   int AudioMaxPktSize;   // Aggregated packet maximum size
+  int AudioFecDepth;     // FEC interleaving depth in packets, 0 - disabled
+  bool AudioCodec2BitPack; // frames are bit-packed in superframe without byte padding
+  bool AudioVoiceHdr;    // voice stream framing header
+  bool AudioMicDsp;      // mic processing before encoder
+  bool AudioNoiseSup;    // mic noise suppression before encoder
+  bool AudioDtx;         // no audio in speech pauses
+  bool AudioVox;         // voice activated transmission
+  int AudioVoxHangMs;    // speech detection hang time
+  int AudioVoxPreRollMs_; // audio before speech detection
 
   // audio opus
   int AudioOpusRate;  // opus bit rate 2.4 - 512 kbps
+  uint32_t AudioOpusSampleRate_; // opus codec sample rate, 8, 12, 16, 24, 48 kHz
   float AudioOpusPcmLen;   // opus pcm frame length, 2.5, 5, 10, 20, 40, 60, 80, 100, 120 ms  
+  bool AudioOpusSuperframe; // combine opus frames into one packet up to maximum packet size
+  bool AudioOpusCbr;        // constant bit rate, every opus frame has the same size
+  bool AudioOpusFec;        // in-band fec driven by measured link loss
 
   // i2s speaker
   byte AudioSpkPinBclk_; // Speaker i2s clk pin
@@ -62,6 +62,7 @@ private:
   static std::shared_ptr<AiEsp32RotaryEncoder> rotaryEncoder_;
 
   std::shared_ptr<SettingsMenu> settingsMenu_;
+  bool isSettingsMenuOpen_;
 
   // other
   volatile bool btnPressed_;
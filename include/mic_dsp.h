@@ -0,0 +1,106 @@
+#ifndef MIC_DSP_H
+#define MIC_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "heap_arena.h"
+#include "noise_suppressor.h"
+
+namespace LoraDv {
+
+struct MicDspStats {
+  long frames;                  // processed frames
+  uint64_t totalCycles[5];      // cpu cycles spent per stage
+  uint32_t maxCycles[5];        // longest frame per stage in cpu cycles
+};
+
+// Fixed point transmit side processing of captured mic frames before encoding.
+//
+// Stages run in place one after another:
+//  - high-pass, removes mic dc offset and rumble below ~80 Hz
+//  - noise suppressor, spectral subtraction, delays audio by about 32 ms
+//  - noise gate, attenuates background between words with hysteresis and hold
+//  - agc, slowly brings speech to the target level, frozen while gate is closed
+//  - compressor, 4:1 above the threshold, reaches its gain by the frame peak
+// Gains are Q3.12 and ramped over the frame, so there are no steps between
+// frames. Does not depend on the platform except for the cycle counter.
+class MicDsp {
+
+public:
+  static const int CfgStageHighPass = 0;
+  static const int CfgStageNoise = 1;
+  static const int CfgStageGate = 2;
+  static const int CfgStageAgc = 3;
+  static const int CfgStageCompressor = 4;
+  static const int CfgStageCount = 5;
+  static const uint32_t CfgStageAll = (1 << CfgStageCount) - 1;
+
+  MicDsp();
+
+  // noise suppressor buffers depend on the rate, they are placed in the arena if the stage is on
+  static size_t getArenaSize(int sampleRate, uint32_t stageMask);
+  bool setup(int sampleRate, uint32_t stageMask, HeapArena *arena);
+  void reset();
+
+  void process(int16_t *pcm, int sampleCount);
+
+  bool isGateOpen() const { return isGateOpen_; }
+  inline const MicDspStats &getStats() const { return stats_; }
+  void resetStats();
+
+private:
+  static const int CfgGainShift = 12;             // gain fraction bits
+  static const int32_t CfgUnityGain = 1 << CfgGainShift;
+
+  static const int CfgHighPassHz = 80;            // pole at 1 - 2 pi fc / fs
+  static const int CfgHighPassCoefBits = 16;      // pole distance from 1 fraction bits
+  static const int CfgHighPassFracBits = 8;       // filter state extra precision
+
+  static const int32_t CfgGateOpenLevel = 200;    // mean absolute level to open, ~-44 dBFS
+  static const int32_t CfgGateCloseLevel = 120;   // mean absolute level to close
+  static const int32_t CfgGateFloorGain = 410;    // closed gate gain, -20 dB
+  static const int CfgGateHoldMs = 200;           // keep open after speech
+
+  static const int32_t CfgAgcTargetLevel = 3000;  // mean absolute speech level, ~-20 dBFS
+  static const int32_t CfgAgcMinGain = 2048;      // 0.5x
+  static const int32_t CfgAgcMaxGain = 32767;     // 8x
+  static const int CfgAgcAttackShift = 2;         // gain decrease per frame, 1/4 of the difference
+  static const int CfgAgcReleaseShift = 4;        // gain increase per frame, 1/16 of the difference
+
+  static const int32_t CfgCompThreshold = 16384;  // compression above, -6 dBFS
+  static const int CfgCompRatioShift = 2;         // 4:1
+  static const int CfgCompReleaseShift = 2;       // gain recovery per frame
+
+  static inline int16_t saturate(int32_t sample);
+  static void applyGain(int16_t *pcm, int sampleCount, int32_t fromGain, int32_t toGain, int rampLength);
+  static int32_t getMeanLevel(const int16_t *pcm, int sampleCount);
+
+  void processHighPass(int16_t *pcm, int sampleCount);
+  void processGate(int16_t *pcm, int sampleCount);
+  void processAgc(int16_t *pcm, int sampleCount);
+  void processCompressor(int16_t *pcm, int sampleCount);
+
+private:
+  int sampleRate_;
+  uint32_t stageMask_;
+
+  int32_t highPassCoef_;
+  int16_t highPassInput_;
+  int32_t highPassState_;
+
+  NoiseSuppressor noiseSuppressor_;
+
+  bool isGateOpen_;
+  int gateHoldSamples_;
+  int32_t gateGain_;
+
+  int32_t agcGain_;
+  int32_t compGain_;
+
+  MicDspStats stats_;
+};
+
+} // LoraDv
+
+#endif // MIC_DSP_H
@@ -0,0 +1,80 @@
+#ifndef NOISE_SUPPRESSOR_H
+#define NOISE_SUPPRESSOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "heap_arena.h"
+
+namespace LoraDv {
+
+// Spectral subtraction noise suppressor for narrow band speech.
+//
+// Works on 32 ms blocks with 50% overlap and sqrt hann window, so any frame
+// size could be passed and output is delayed by one block. Block length is
+// the power of two closest to 32 ms at the sample rate, 256 points at 8 kHz,
+// buffers are placed in the subsystem arena. Noise
+// power in every bin is tracked with minimum statistics: the smoothed power
+// minimum is searched over a sliding window of subwindows, so noise follows
+// slow changes while speech pauses are short. Uses single precision float,
+// which is done by the ESP32 fpu.
+class NoiseSuppressor {
+
+public:
+  static const int CfgBlockMs = 32;               // block length
+  static const int CfgMaxFftSize = 1024;          // 32 ms up to 24 kHz, shorter blocks above
+
+  NoiseSuppressor();
+
+  static int getFftSize(int sampleRate);
+  static size_t getArenaSize(int sampleRate);
+
+  bool setup(int sampleRate, HeapArena *arena);
+  // clears audio in flight, noise estimate is kept as background changes slowly
+  void reset();
+  void resetNoise();
+
+  int getFftSize() const { return fftSize_; }
+
+  // in place, output lags input by getFftSize() samples
+  void process(int16_t *pcm, int sampleCount);
+
+private:
+  static const int CfgSubwindowMs = 256;          // minimum search subwindow
+  static const int CfgSubwindowCount = 6;         // minimum search window, 1.5 s
+
+  void processBlock();
+  void fft(float *re, float *im) const;
+
+private:
+  int fftSize_;
+  int hopSize_;                   // new samples per block, half of the block
+  int binCount_;
+
+  float *window_;                 // fft size
+  float *cos_;                    // half fft size
+  float *sin_;
+  uint16_t *bitReverse_;          // fft size
+
+  float *history_;                // hop size
+  float *overlap_;                // fft size
+  float *re_;
+  float *im_;
+
+  int16_t *inHop_;                // hop size
+  int16_t *outHop_;
+  int hopPos_;
+
+  float *power_;                  // bin count
+  float *smoothedPower_;
+  float *subwindowMin_;
+  float *windowMin_;              // subwindow count times bin count
+  float *noise_;
+  int subwindowBlocksMax_;        // blocks per subwindow
+  int subwindowBlocks_;
+  int subwindowIndex_;
+};
+
+} // LoraDv
+
+#endif // NOISE_SUPPRESSOR_H
@@ -0,0 +1,73 @@
+#ifndef OPUS_SUPERFRAME_H
+#define OPUS_SUPERFRAME_H
+
+#include <stdint.h>
+#include <opus.h>
+
+namespace LoraDv {
+
+// Combines opus frames into one multi-frame opus packet and splits it back.
+//
+// Standard opus repacketizer is used, so the superframe is still a valid
+// opus packet, frames share one toc byte and carry one byte length prefix
+// each, or none when all frames are of the same size (cbr). One opus packet
+// holds up to 120 ms of audio. Repacketizer keeps pointers to the frames,
+// so they are copied into own storage first.
+class OpusSuperframe {
+
+public:
+  static const int CfgMaxPacketMs = 120;          // opus packet duration limit
+  static const int CfgMaxFrames = 48;             // opus packet frame count limit
+  static const int CfgBufferSize = 256;           // combined frames storage, radio packet limit
+
+  OpusSuperframe();
+  ~OpusSuperframe();
+
+  bool setup(float frameMs, int maxPacketSize);
+  void reset();
+
+  bool hasFrames() const { return frameCount_ > 0; }
+  bool isFull() const { return frameCount_ >= maxFrames_; }
+  int getMaxFrames() const { return maxFrames_; }
+
+  // frame could be added without exceeding maximum packet size, first one always fits
+  bool canAppend(const uint8_t *frame, int frameSize) const;
+  bool append(const uint8_t *frame, int frameSize);
+  // combined packet size or 0 on failure, storage is empty afterwards
+  int write(uint8_t *packet, int maxPacketSize);
+
+  // returns number of frames in the packet, 0 if packet is broken
+  int readBegin(const uint8_t *packet, int packetSize);
+  // frame is written as a single frame opus packet, read packet must be still valid
+  int readFrame(int index, uint8_t *frame, int maxFrameSize);
+
+  // packet structure is a valid opus one, single frame packets of any content pass
+  static bool isValidPacket(const uint8_t *packet, int packetSize);
+
+  // largest combined packet size for frames of the same size
+  static int getPacketSize(int frameCount, int frameSize, bool isCbr);
+  static int getFramesPerPacket(float frameMs, int frameSize, int maxPacketSize, bool isCbr);
+
+private:
+  static const int CfgTocSize = 1;                // opus frame configuration byte
+  static const int CfgCountSize = 1;              // frame count byte of code 3 packet
+  static const int CfgShortLengthLimit = 252;     // frame lengths below are coded in one byte
+  static const uint8_t CfgTocConfigMask = 0xFC;   // mode, bandwidth, duration and stereo bits
+
+  static int getLengthSize(int frameSize) { return frameSize - CfgTocSize < CfgShortLengthLimit ? 1 : 2; }
+
+private:
+  OpusRepacketizer *repacketizer_;
+  int maxPacketSize_;
+  int maxFrames_;
+
+  uint8_t buffer_[CfgBufferSize];
+  int bufferSize_;
+  int frameCount_;
+  int lengthBytes_;       // length prefixes of all frames, upper bound
+  int lastLengthSize_;    // last frame goes without length prefix
+};
+
+} // LoraDv
+
+#endif // OPUS_SUPERFRAME_H
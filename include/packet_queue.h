@@ -0,0 +1,123 @@
+#ifndef PACKET_QUEUE_H
+#define PACKET_QUEUE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+namespace LoraDv {
+
+struct PacketView {
+  uint8_t *data;        // slot payload, owned by the consumer until released
+  int size;             // payload size in bytes
+};
+
+// Lock-free single producer/single consumer queue of fixed size packet slots.
+// Producer reserves a slot with writeBegin(), fills it in place and publishes
+// it with writeEnd(), consumer gets a view with readBegin() and returns the
+// slot with readEnd(), so whole packets are moved without per byte calls and
+// packet boundaries can never drift from the payload. Producer could leave
+// a header in front of the payload by publishing it with an offset.
+template <int SlotCount>
+class PacketQueueBase {
+
+  static_assert((SlotCount & (SlotCount - 1)) == 0, "Slot count must be power of 2");
+
+public:
+  PacketQueueBase() : data_(nullptr), slotSize_(0), head_(0), tail_(0) {}
+
+  int getSlotSize() const { return slotSize_; }
+
+  // producer side
+  uint8_t *writeBegin() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= (uint32_t)SlotCount) return nullptr;
+    return data_ + (head & (SlotCount - 1)) * slotSize_;
+  }
+  void writeEnd(int size, int offset = 0) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    slots_[head & (SlotCount - 1)].size = size;
+    slots_[head & (SlotCount - 1)].offset = offset;
+    head_.store(head + 1, std::memory_order_release);
+  }
+  bool push(const uint8_t *data, int size) {
+    uint8_t *slot = writeBegin();
+    if (slot == nullptr || size > slotSize_) return false;
+    memcpy(slot, data, size);
+    writeEnd(size);
+    return true;
+  }
+
+  // consumer side
+  bool readBegin(PacketView &packet) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    const Slot &slot = slots_[tail & (SlotCount - 1)];
+    packet.data = data_ + (tail & (SlotCount - 1)) * slotSize_ + slot.offset;
+    packet.size = slot.size;
+    return true;
+  }
+  void readEnd() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+  // drops all published slots
+  void clear() {
+    tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  bool isEmpty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+  int size() const {
+    return (int)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+
+protected:
+  // storage is published to the consumer with the next written slot
+  void setStorage(uint8_t *data, int slotSize) {
+    data_ = data;
+    slotSize_ = slotSize;
+  }
+
+private:
+  struct Slot {
+    int size;
+    int offset;
+  };
+
+  uint8_t *data_;
+  int slotSize_;
+  Slot slots_[SlotCount];
+  std::atomic<uint32_t> head_;
+  std::atomic<uint32_t> tail_;
+};
+
+// slots are stored inline
+template <int SlotCount, int SlotSize = 0>
+class PacketQueue : public PacketQueueBase<SlotCount> {
+
+public:
+  PacketQueue() { this->setStorage(storage_, SlotSize); }
+
+private:
+  alignas(4) uint8_t storage_[SlotCount * SlotSize];
+};
+
+// slots are sized at runtime and stored by the caller, e.g. in a subsystem arena
+template <int SlotCount>
+class PacketQueue<SlotCount, 0> : public PacketQueueBase<SlotCount> {
+
+public:
+  static size_t getStorageSize(int slotSize) { return (size_t)SlotCount * slotSize; }
+
+  // queue must be empty, consumer could still poll it
+  bool setup(uint8_t *storage, int slotSize) {
+    if (storage == nullptr || !this->isEmpty()) return false;
+    this->setStorage(storage, slotSize);
+    return true;
+  }
+};
+
+} // LoraDv
+
+#endif // PACKET_QUEUE_H
@@ -0,0 +1,76 @@
+#ifndef RADIO_CIPHER_H
+#define RADIO_CIPHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ChaCha.h>
+#include <Poly1305.h>
+
+namespace LoraDv {
+
+// Packet privacy with authentication, ChaCha20 with truncated Poly1305 tag,
+// one time mac key is taken from keystream block 0 as in RFC 8439.
+//
+// Nonce is random per boot salt followed by packet counter, so keystream
+// of the next packets is generated ahead while radio is idle and transmit
+// is one XOR pass while copying payload into the radio buffer.
+//
+// Packet: [header][nonce:8][ciphertext][tag:4], header is authenticated only
+class RadioCipher {
+
+public:
+  static const int CfgNonceLen = 8;             // salt and counter
+  static const int CfgTagLen = 4;               // truncated poly1305 tag
+  static const int CfgOverhead = CfgNonceLen + CfgTagLen;
+  static const int CfgMaxPayload = 256;         // longest payload per packet
+  static const int CfgPrecomputeCount = 4;      // packets with keystream generated ahead
+
+  RadioCipher();
+
+  void setKey(const uint8_t *key, size_t keyLen);
+  void setSalt(uint32_t salt);
+
+  // keystream length generated ahead, longer payloads get theirs generated on encrypt
+  void setStreamSize(int streamSize);
+
+  // generates keystream for next transmitted packets, call when idle
+  void precompute();
+
+  // returns packet size, payload could be anywhere including own ciphertext position
+  int encrypt(uint8_t *packet, int headerSize, const uint8_t *payload, int payloadSize);
+
+  // decrypts in place, returns payload size or -1 if packet is not authentic
+  int decrypt(uint8_t *packet, int headerSize, int packetSize);
+
+  inline long getAuthFailCount() const { return authFailCount_; }
+
+private:
+  static const int CfgPolyKeyLen = 32;
+  static const int CfgPolyTagLen = 16;
+
+  struct KeyStream {
+    uint32_t counter;
+    bool isReady;
+    uint8_t polyKey[CfgPolyKeyLen];
+    uint8_t stream[CfgMaxPayload];
+  };
+
+  void makeNonce(uint32_t counter, uint8_t *nonce) const;
+  void generate(const uint8_t *nonce, uint8_t *polyKey, uint8_t *stream, int streamLen);
+  void computeTag(const uint8_t *polyKey, const uint8_t *data, int dataLen, uint8_t *tag);
+
+private:
+  ChaCha chacha_;
+  Poly1305 poly_;
+
+  uint32_t salt_;
+  uint32_t txCounter_;
+  int streamSize_;
+  KeyStream txStreams_[CfgPrecomputeCount];
+
+  long authFailCount_;
+};
+
+} // LoraDv
+
+#endif // RADIO_CIPHER_H
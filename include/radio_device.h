@@ -0,0 +1,45 @@
+#ifndef RADIO_DEVICE_H
+#define RADIO_DEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace LoraDv {
+
+// Radio hardware abstraction used by RadioTask, return codes follow
+// RadioLib convention, 0 on success, negative on error.
+class RadioDevice {
+
+public:
+  static const int CfgErrNone = 0;
+
+  virtual ~RadioDevice() {}
+
+  virtual int beginLora(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes, int preambleLen) = 0;
+  virtual int beginFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, uint8_t shaping) = 0;
+
+  // isr is called on packet received or transmit done
+  virtual void setIsr(void (*isr)(void)) = 0;
+
+  virtual int setFrequency(long freq) = 0;
+  virtual int setSpreadingFactor(int sf) = 0;
+
+  // fixed packet length without lora header, required for spreading factor 6
+  virtual int implicitHeader(size_t len) = 0;
+  virtual int explicitHeader() = 0;
+
+  virtual int startReceive() = 0;
+  virtual int getPacketLength() = 0;
+  virtual int readData(uint8_t *data, size_t len) = 0;
+
+  virtual int startTransmit(uint8_t *data, size_t len) = 0;
+  virtual int finishTransmit() = 0;
+
+  virtual float getRssi() = 0;
+  virtual float getSnr() = 0;
+  virtual long random(long max) = 0;
+};
+
+} // LoraDv
+
+#endif // RADIO_DEVICE_H
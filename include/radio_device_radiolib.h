@@ -0,0 +1,56 @@
+#ifndef RADIO_DEVICE_RADIOLIB_H
+#define RADIO_DEVICE_RADIOLIB_H
+
+#include <Arduino.h>
+#include <memory>
+#include <DebugLog.h>
+#include <RadioLib.h>
+
+#include "loradv_config.h"
+#include "radio_device.h"
+
+namespace LoraDv {
+
+class RadioDeviceRadioLib : public RadioDevice {
+
+public:
+  RadioDeviceRadioLib(std::shared_ptr<const Config> config);
+
+  virtual int beginLora(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes, int preambleLen) override;
+  virtual int beginFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, uint8_t shaping) override;
+
+  virtual void setIsr(void (*isr)(void)) override;
+
+  virtual int setFrequency(long freq) override;
+  virtual int setSpreadingFactor(int sf) override { return rig_->setSpreadingFactor(sf); }
+
+  virtual int implicitHeader(size_t len) override;
+  virtual int explicitHeader() override;
+
+  virtual int startReceive() override;
+  virtual int getPacketLength() override { return rig_->getPacketLength(); }
+  virtual int readData(uint8_t *data, size_t len) override { return rig_->readData(data, len); }
+
+  virtual int startTransmit(uint8_t *data, size_t len) override { return rig_->startTransmit(data, len); }
+  virtual int finishTransmit() override { return rig_->finishTransmit(); }
+
+  virtual float getRssi() override { return rig_->getRSSI(); }
+  virtual float getSnr() override { return rig_->getSNR(); }
+  virtual long random(long max) override { return rig_->random(max); }
+
+private:
+  void setupModule();
+  static int getImageCalBand(long freq);
+
+private:
+  std::shared_ptr<const Config> config_;
+  std::shared_ptr<MODULE_NAME> rig_;
+  void (*isr_)(void);
+  bool isIsrInstalled_;
+  size_t implicitLen_;
+  int imageCalBand_;
+};
+
+} // LoraDv
+
+#endif // RADIO_DEVICE_RADIOLIB_H
@@ -0,0 +1,142 @@
+#ifndef RADIO_DEVICE_SIM_H
+#define RADIO_DEVICE_SIM_H
+
+// host only simulated radio channel for off target pipeline benchmarks
+#ifndef ARDUINO
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "radio_device.h"
+
+namespace LoraDv {
+
+struct RadioChannelParams {
+  float lossRate;           // packet loss probability, 0..1
+  float bitErrorRate;       // bit error probability, corrupted packets fail crc if enabled
+  int latencyMs;            // extra delivery latency on top of air time
+  float rssi;               // reported rssi in dBm
+  float snr;                // reported snr in dB
+  float rssiJitter;         // rssi and snr random variation
+  bool isAirTimeEnabled;    // delay transmit done and delivery by modulation time on air
+};
+
+// modulation of a packet on air, receiver demodulates it only if its own one matches
+struct RadioModulationSim {
+  bool isLora;
+  long freq;
+  long bw;
+  int sf;
+  int sync;
+  bool isImplicitHeader;
+  float bitRate;
+};
+
+struct RadioChannelStats {
+  long sent;
+  long delivered;
+  long lost;
+  long corrupted;
+};
+
+class RadioDeviceSim;
+
+class RadioChannelSim : public std::enable_shared_from_this<RadioChannelSim> {
+
+public:
+  RadioChannelSim(const RadioChannelParams &params, unsigned int seed = 1);
+
+  std::shared_ptr<RadioDeviceSim> createDevice();
+
+  void setParams(const RadioChannelParams &params);
+  RadioChannelParams getParams();
+  RadioChannelStats getStats();
+
+  void transmit(std::weak_ptr<RadioDeviceSim> sender, const RadioModulationSim &modulation,
+    const std::vector<uint8_t> &packet, float airTimeMs);
+
+private:
+  void deliver(const std::weak_ptr<RadioDeviceSim> &sender, const RadioModulationSim &modulation,
+    const std::vector<uint8_t> &packet);
+
+private:
+  std::mutex mutex_;
+  RadioChannelParams params_;
+  RadioChannelStats stats_;
+  std::mt19937 rng_;
+  std::vector<std::weak_ptr<RadioDeviceSim>> devices_;
+};
+
+class RadioDeviceSim : public RadioDevice, public std::enable_shared_from_this<RadioDeviceSim> {
+
+public:
+  RadioDeviceSim(std::shared_ptr<RadioChannelSim> channel);
+
+  virtual int beginLora(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes, int preambleLen) override;
+  virtual int beginFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, uint8_t shaping) override;
+
+  virtual void setIsr(void (*isr)(void)) override;
+
+  virtual int setFrequency(long freq) override;
+  virtual int setSpreadingFactor(int sf) override;
+
+  virtual int implicitHeader(size_t len) override;
+  virtual int explicitHeader() override;
+
+  virtual int startReceive() override;
+  virtual int getPacketLength() override;
+  virtual int readData(uint8_t *data, size_t len) override;
+
+  virtual int startTransmit(uint8_t *data, size_t len) override;
+  virtual int finishTransmit() override;
+
+  virtual float getRssi() override;
+  virtual float getSnr() override;
+  virtual long random(long max) override;
+
+  // called from channel
+  bool isListening(const RadioModulationSim &modulation);
+  void onTransmitDone();
+  void onReceive(const std::vector<uint8_t> &packet, bool isCorrupted, float rssi, float snr);
+
+private:
+  static const int CfgErrCrcMismatch = -7;
+  static const int CfgErrTxBusy = -5;
+
+  enum class Mode { Standby, Receive, Transmit };
+
+  float getTimeOnAirMs(size_t len) const;
+  RadioModulationSim getModulation() const;
+  void callIsr();
+
+private:
+  std::shared_ptr<RadioChannelSim> channel_;
+  std::mutex mutex_;
+  void (*isr_)(void);
+
+  Mode mode_;
+  bool isLora_;
+  long freq_;
+  long bw_;
+  int sf_;
+  int cr_;
+  int preambleLen_;
+  int sync_;
+  bool isCrcOn_;
+  size_t implicitLen_;
+  float bitRate_;
+
+  std::vector<uint8_t> rxPacket_;
+  bool isRxCorrupted_;
+  float rssi_;
+  float snr_;
+};
+
+} // LoraDv
+
+#endif // ARDUINO
+
+#endif // RADIO_DEVICE_SIM_H
@@ -2,15 +2,20 @@
 #define RADIO_TASK_H
 
 #include <Arduino.h>
+#include <atomic>
 #include <memory>
 #include <DebugLog.h>
 #include <RadioLib.h>
-#include <CircularBuffer.h>
-#include <ChaCha.h>
 
 #include "loradv_config.h"
+#include "packet_queue.h"
 #include "audio_task.h"
 #include "utils.h"
+#include "air_time.h"
+#include "radio_device.h"
+#include "rate_controller.h"
+#include "radio_cipher.h"
+#include "heap_arena.h"
 #include "config.h"
 
 namespace LoraDv {
@@ -23,68 +28,117 @@ public:
   RadioTask();
 
   void start(std::shared_ptr<const Config> config, std::shared_ptr<AudioTask> audioTask);
+  inline void setDevice(std::shared_ptr<RadioDevice> device) { rig_ = device; }
   inline void stop() { isRunning_ = false; }
   bool loop();
 
   void setFreq(long freq) const;
   inline bool isHalfDuplex() const { return config_->LoraFreqTx != config_->LoraFreqRx; }
   inline float getRssi() const { return lastRssi_; }
+  inline uint32_t getChannelSwitchUs() const { return rigSwitchUs_; }
+  inline uint32_t getChannelSwitchMaxUs() const { return rigSwitchMaxUs_; }
 
-  bool hasData() const;
-  bool readPacketSize(byte &packetSize);
-  bool readNextByte(byte &b);
+  inline bool hasData() const { return !loraRadioRxQueue_.isEmpty(); }
+  inline bool readPacketBegin(PacketView &packet) { return loraRadioRxQueue_.readBegin(packet); }
+  inline void readPacketEnd() { loraRadioRxQueue_.readEnd(); }
 
   void transmit() const;
   void startTransmit() const;
   void startReceive() const;
   
-  bool writePacketSize(byte packetSize);
-  bool writeNextByte(byte b);
+  inline byte *writePacketBegin() { return loraRadioTxQueue_.writeBegin(); }
+  inline void writePacketEnd(int packetSize) { loraRadioTxQueue_.writeEnd(packetSize); }
+  static int getMaxPacketSize() { return CfgRadioPacketBufLen - RadioCipher::CfgOverhead - CfgRadioRateDescLen; }
+  inline long getAuthFailCount() const { return cipher_.getAuthFailCount(); }
+
+  inline bool isRateAdaptive() const { return isRateAdaptive_; }
+  RateProfile getTxProfile() const;
+  RateProfile getRxProfile() const;
+  // packet format and rate profiles follow the codec switched at runtime
+  void codecChanged() const;
+  // packets missing by voice header sequence gaps, fading losses never reach the radio as crc errors
+  void packetsLost(int count);
 
 private:
-  static const int CfgRadioQueueLen = 512;          // circular buffer length
+  static const int CfgRadioQueueSlots = 8;          // packet queue length in slots
   static const int CfgRadioPacketBufLen = 256;      // packet buffer length
+  static const int CfgRadioRateDescLen = 1;         // adaptive rate descriptor length
+  static const uint32_t CfgRateResetMs = 30000;     // fall back to base profile without peer packets
 
   static const uint32_t CfgRadioRxBit = 0x01;       // task bit for rx
   static const uint32_t CfgRadioTxBit = 0x02;       // task bit for tx
   static const uint32_t CfgRadioRxStartBit = 0x04;  // task bit for start rx
   static const uint32_t CfgRadioTxStartBit = 0x10;  // task bit for start tx
+  static const uint32_t CfgRadioTxDoneBit = 0x20;   // task bit for tx completed
+  static const uint32_t CfgRadioRateResetBit = 0x40; // task bit for rate profile reset
+  static const uint32_t CfgRadioCodecBit = 0x80;    // task bit for codec change
+  static const uint32_t CfgRadioLossBit = 0x100;    // task bit for sequence gap losses
 
   const int CfgRadioTaskStack = 4096;
+  const int CfgRadioTaskCore = 0;                   // shared with i2s stages, codec runs on the other core
 
 private:
   void setupRig(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes);
   void setupRigFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, byte shaping);
 
+  void logAirTime() const;
+  RateProfile getProfile(int profileIndex) const;
+  void setRigProfile(int profileIndex);
+  void setRigImplicitHeader(int profileIndex);
+  void setRigFreq(long freq);
+
   static IRAM_ATTR void onRigIsrRxPacket();
 
   static void task(void *param);
 
   void rigTask();
-  void rigTaskReceive(byte *packetBuf, byte *tmpBuf);
-  void rigTaskTransmit(byte *packetBuf, byte *tmpBuf);
+  void rigTaskReceive(byte *packetBuf);
+  void rigTaskTransmit();
+  void rigTaskTransmitNext();
+  void rigTaskTransmitDone();
+  bool rigTaskTransmitPrepare(int txBufIndex);
   void rigTaskStartReceive();
   void rigTaskStartTransmit();
+  void rigTaskRateReset();
+  void rigTaskCodecChanged();
+  void rigTaskCipherSetup();
 
 private:
   std::shared_ptr<const Config> config_;
 
-  std::shared_ptr<MODULE_NAME> rig_;
+  std::shared_ptr<RadioDevice> rig_;
   std::shared_ptr<AudioTask> audioTask_;
 
-  uint8_t iv_[8];
-  std::shared_ptr<ChaCha> cipher_;
+  RadioCipher cipher_;
 
   static TaskHandle_t loraTaskHandle_;
 
-  CircularBuffer<uint8_t, CfgRadioQueueLen> loraRadioRxQueue_;
-  CircularBuffer<uint8_t, CfgRadioQueueLen> loraRadioRxQueueIndex_;
-  CircularBuffer<uint8_t, CfgRadioQueueLen> loraRadioTxQueue_;
-  CircularBuffer<uint8_t, CfgRadioQueueLen> loraRadioTxQueueIndex_;
+  PacketQueue<CfgRadioQueueSlots, CfgRadioPacketBufLen> loraRadioRxQueue_;
+  PacketQueue<CfgRadioQueueSlots, CfgRadioPacketBufLen> loraRadioTxQueue_;
+
+  HeapArena radioArena_;    // receive and transmit packet buffers
+  byte *txBuf_[2];          // one packet is on air while next one is prepared
+  int txBufSize_[2];
+  int txBufIndex_;          // buffer which is on air
 
   bool rigIsImplicitMode_;
-  bool isIsrInstalled_;
+  int rigImplicitSize_;     // fixed packet size in implicit header mode
+  long rigFreq_;            // frequency radio is tuned to
+  volatile uint32_t rigSwitchUs_;
+  volatile uint32_t rigSwitchMaxUs_;
+
+  bool isRateAdaptive_;
+  RateController rateController_;
+  volatile int txProfile_;  // profile peer listens with
+  volatile int rxProfile_;  // profile we listen with
+  int rigProfile_;          // profile radio is configured with
+  int sentProfile_;         // recommended profile which was sent to the peer
+  volatile uint32_t lastRxMs_;
+  std::atomic<int> lostPackets_;  // sequence gap losses not yet passed to rate controller
+
   static volatile bool loraIsrEnabled_;
+  static volatile bool rigIsTxActive_;
+  bool isRxStartPending_;
   volatile bool isRunning_;
   volatile bool shouldUpdateScreen_;
   float lastRssi_;
@@ -0,0 +1,71 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+class Config;
+
+struct RateProfile {
+  int sf;               // lora spreading factor
+  int codecMode;        // codec2 mode or opus bit rate
+};
+
+// Closed loop rate control, selects the densest lora spreading factor and
+// codec mode combination which the measured snr and packet loss support.
+// Profiles are derived from the shared config, so peers build the same
+// ladder and exchange profile indices in a one byte in-band descriptor:
+// high nibble is the profile used for transmission, low nibble is the
+// profile the sender wants to receive with.
+class RateController {
+
+public:
+  static const int CfgMaxProfiles = 8;
+
+  RateController();
+
+  void setup(const Config &config);
+  void reset();
+
+  inline int getProfileCount() const { return profileCount_; }
+  inline const RateProfile &getProfile(int index) const { return profiles_[index]; }
+  inline int getBaseIndex() const { return baseIndex_; }
+  inline bool isValidIndex(int index) const { return index >= 0 && index < profileCount_; }
+
+  void onPacketReceived(float snr);
+  void onPacketLost(int count);
+
+  inline int getRecommended() const { return recommended_; }
+  inline float getSnr() const { return snrAvg_; }
+  inline float getLoss() const { return lossAvg_; }
+
+  static uint8_t encodeDescriptor(int txIndex, int rxIndex) { return (txIndex << 4) | (rxIndex & 0x0F); }
+  static int getDescriptorTxIndex(uint8_t descriptor) { return descriptor >> 4; }
+  static int getDescriptorRxIndex(uint8_t descriptor) { return descriptor & 0x0F; }
+
+private:
+  static constexpr float CfgAvgFactor = 0.2f;         // ewma smoothing of snr and loss
+  static constexpr float CfgSnrMarginDb = 3.0f;       // required margin over demodulator limit
+  static constexpr float CfgSnrHysteresisDb = 2.0f;   // extra margin to move to denser profile
+  static constexpr float CfgLossStepDown = 0.1f;      // loss rate to move to more robust profile
+  static constexpr float CfgLossStepUp = 0.02f;       // loss rate to allow denser profile
+  static const int CfgMinPacketsPerStep = 4;          // packets between profile changes
+
+  void update();
+
+private:
+  RateProfile profiles_[CfgMaxProfiles];
+  int profileCount_;
+  int baseIndex_;
+
+  int recommended_;
+  int packetsSinceStep_;
+  bool hasSnr_;
+  float snrAvg_;
+  float lossAvg_;
+};
+
+} // LoraDv
+
+#endif // RATE_CONTROLLER_H
@@ -0,0 +1,50 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+// Rational ratio polyphase resampler between i2s and codec sample rates.
+//
+// Input is upsampled by L, low-pass filtered and decimated by M, where
+// L/M is the reduced rate ratio, only filter phases which produce output
+// samples are computed. Windowed sinc filter is designed on setup with
+// Q14 coefficients, processing is integer only on caller buffers, so
+// nothing is allocated. Ratios with L and M up to 6 are supported, which
+// covers 8, 12, 16, 24 and 48 kHz in any direction.
+class Resampler {
+
+public:
+  Resampler();
+
+  bool setup(int inRate, int outRate);
+  void reset();
+
+  // rates differ, otherwise process should not be called
+  bool isActive() const { return up_ != down_; }
+
+  // output count is exact when input count is a multiple of the ratio denominator
+  int process(const int16_t *in, int inCount, int16_t *out, int maxOutCount);
+
+private:
+  static const int CfgTapsPerPhase = 16;          // filter length in units of the lower rate
+  static const int CfgMaxRatio = 6;               // largest L or M after reduction
+  static const int CfgMaxTaps = CfgTapsPerPhase * CfgMaxRatio;
+  static const int CfgCoefShift = 14;             // coefficient fraction bits
+  static const int CfgPassbandPercent = 90;       // cutoff relative to the lower nyquist frequency
+
+private:
+  int up_;
+  int down_;
+  int taps_;                      // taps per phase
+  int phase_;                     // next output position in upsampled domain
+  int pos_;                       // delay line newest sample
+
+  int16_t coefs_[CfgMaxTaps];     // phase major, coefs_[p * taps_ + i] = h[p + i * L]
+  int16_t history_[2 * CfgMaxTaps]; // delay line is written twice, so taps are read without wrap
+};
+
+} // LoraDv
+
+#endif // RESAMPLER_H
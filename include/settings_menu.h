@@ -12,6 +12,8 @@
 #include "loradv_config.h"
 #include "radio_task.h"
 #include "utils.h"
+#include "air_time.h"
+#include "voice_fec.h"
 
 namespace LoraDv {
 
@@ -34,6 +36,8 @@ class SettingsMenu {
 public:
   SettingsMenu(std::shared_ptr<Config> config);
 
+  // menu is built once and reopened from its first item
+  void reset();
   void draw(std::shared_ptr<Adafruit_SSD1306> display);
 
   void onEncoderPositionChanged(int delta);
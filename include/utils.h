@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 
+#include "air_time.h"
+
 namespace LoraDv {
 
 class Utils {
@@ -0,0 +1,49 @@
+#ifndef VOICE_ACTIVITY_H
+#define VOICE_ACTIVITY_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+// Frame energy voice activity detector.
+//
+// Background level follows frame mean absolute level quickly down and slowly
+// up, so it stays at the noise floor during speech. Frame is speech when its
+// level is well above the floor, detection is held for the hang time, so
+// pauses between words do not cut the transmission. Floor is unknown after
+// setup, so it is learned quickly for a short time before speech is detected.
+class VoiceActivityDetector {
+
+public:
+  VoiceActivityDetector();
+
+  void setup(int frameMs, int hangMs);
+  void reset();
+
+  // returns true for speech frames and during hang time after them
+  bool process(const int16_t *pcm, int sampleCount);
+
+  bool isActive() const { return hangFrames_ > 0; }
+  int32_t getNoiseLevel() const { return noiseLevel_; }
+
+private:
+  static const int32_t CfgSpeechRatio = 3;        // speech level above noise floor, ~10 dB
+  static const int32_t CfgMinSpeechLevel = 150;   // absolute speech level, ~-47 dBFS
+  static const int32_t CfgMinNoiseLevel = 8;      // noise floor could not go below
+  static const int CfgNoiseDownShift = 2;         // floor falls by 1/4 of the difference
+  static const int CfgNoiseUpShift = 6;           // floor rises by 1/64 of the difference
+  static const int CfgSpeechUpShift = 4;          // extra slow down of the rise during speech
+  static const int CfgOnsetFrames = 2;            // speech frames in row to start
+  static const int CfgLearnMs = 400;              // floor follows level quickly after setup
+
+private:
+  int hangFramesMax_;
+  int hangFrames_;
+  int onsetFrames_;
+  int learnFrames_;
+  int32_t noiseLevel_;
+};
+
+} // LoraDv
+
+#endif // VOICE_ACTIVITY_H
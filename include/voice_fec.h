@@ -0,0 +1,125 @@
+#ifndef VOICE_FEC_H
+#define VOICE_FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace LoraDv {
+
+// Cross packet forward error correction for fixed size codec frames.
+//
+// Frames of one block are interleaved over depth data packets, frame f goes
+// to packet f % depth, so a lost packet becomes scattered single frame
+// erasures instead of one long gap. One XOR parity packet per block allows
+// recovery of any single lost data packet.
+//
+// Data packet:   [seq:4|0:1|index:3] [frames...]
+// Parity packet: [seq:4|1:1|0:3] [block frame count] [xor of data payloads]
+//
+// Block buffers are placed by the caller, e.g. in the subsystem arena, and
+// sized by getBufferSize() for the depth and packet size.
+class VoiceFec {
+
+public:
+  static const int CfgMaxDepth = 7;             // maximum data packets per block
+  static const int CfgMaxPacketSize = 256;      // maximum packet size
+  static const int CfgDataHeaderSize = 1;       // data packet header size
+  static const int CfgParityHeaderSize = 2;     // parity packet header size
+  static const int CfgMinFrameSize = 4;         // smallest codec frame size
+  static const int CfgMaxBlockFrames = 255;     // block frame count is one byte in the parity header
+
+  static int getDepth(int depth) { return depth < CfgMaxDepth ? depth : CfgMaxDepth; }
+  // frames of every data packet, block frame count has to fit its byte
+  static int getFramesPerPacket(int frameSize, int maxPacketSize, int depth) {
+    int frameCount = (maxPacketSize - CfgParityHeaderSize) / frameSize;
+    int maxFrameCount = depth > 0 ? CfgMaxBlockFrames / getDepth(depth) : CfgMaxBlockFrames;
+    return frameCount < maxFrameCount ? frameCount : maxFrameCount;
+  }
+
+protected:
+  static const uint8_t CfgParityFlag = 0x08;
+  static const uint8_t CfgIndexMask = 0x07;
+
+  VoiceFec();
+  void setup(int depth, int frameSize, int maxPacketSize, uint8_t *frames);
+  int getPacketFrameCount(int index, int blockFrameCount) const;
+
+  static int getPacketSize(int packetSize) { return packetSize < CfgMaxPacketSize ? packetSize : CfgMaxPacketSize; }
+
+protected:
+  int depth_;
+  int frameSize_;
+  int packetSize_;
+  int framesPerPacket_;
+  int maxFrames_;
+  uint8_t *frames_;         // depth * packet size
+};
+
+class VoiceFecEncoder : public VoiceFec {
+
+public:
+  VoiceFecEncoder();
+
+  static size_t getBufferSize(int depth, int maxPacketSize);
+  void setup(int depth, int frameSize, int maxPacketSize, uint8_t *buffer);
+
+  // returns true when block is full and packets need to be sent
+  bool writeFrame(const uint8_t *frame);
+  bool hasFrames() const { return frameCount_ > 0; }
+
+  // data packets followed by the parity packet
+  int getPacketCount() const;
+  int readPacket(int index, uint8_t *packetOut) const;
+  void nextBlock();
+
+private:
+  int frameCount_;
+  uint8_t blockSeq_;
+};
+
+class VoiceFecDecoder : public VoiceFec {
+
+public:
+  VoiceFecDecoder();
+
+  static size_t getBufferSize(int depth, int maxPacketSize);
+  void setup(int depth, int frameSize, int maxPacketSize, uint8_t *buffer);
+
+  // returns true when block is completed and frames are ready to be read
+  bool writePacket(const uint8_t *packet, int packetSize);
+  bool hasPending() const { return isCollecting_; }
+  void flush();
+
+  // returns frames in original order, erased frames are marked and need concealment
+  bool readFrame(const uint8_t *&frame, bool &isErased);
+
+  int getRecoveredCount() const { return recoveredCount_; }
+  int getErasedCount() const { return erasedCount_; }
+
+private:
+  void startBlock(uint8_t blockSeq);
+  bool isBlockComplete() const;
+  int getReceivedFrameCount(int index) const;
+  void completeBlock();
+
+  uint8_t *getPacket(int index) const { return packets_ + index * packetSize_; }
+
+private:
+  uint8_t *packets_;                                    // depth + 1 payloads, parity is last
+  int packetSizes_[CfgMaxDepth + 1];                    // 0 if not received
+  int parityFrameCount_;
+  uint8_t blockSeq_;
+  bool isCollecting_;
+  bool isBlockDone_;
+
+  bool *erased_;                                        // one per block frame
+  int frameCount_;
+  int readFrameIndex_;
+
+  int recoveredCount_;
+  int erasedCount_;
+};
+
+} // LoraDv
+
+#endif // VOICE_FEC_H
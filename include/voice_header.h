@@ -0,0 +1,71 @@
+#ifndef VOICE_HEADER_H
+#define VOICE_HEADER_H
+
+#include <stdint.h>
+
+namespace LoraDv {
+
+// Optional voice stream framing header, prepended to every radio packet.
+//
+// [eot:1|sid:1|reserved:1|codec:5] [seq:8]
+//
+// Codec id is the codec2 mode or CfgCodecOpus, CfgCodecNone marks a packet
+// without audio. Silence descriptor packet is sent instead of audio during
+// speech pauses and carries background noise level for comfort noise:
+// [0:1|1:1|0:1|CfgCodecNone] [seq:8] [level:8]. Without the header packets
+// carry raw codec frames, same as codec2_talkie does.
+class VoiceHeader {
+
+public:
+  static const int CfgSize = 2;                   // header size in bytes
+  static const int CfgSidSize = CfgSize + 1;      // silence descriptor packet size
+  static const uint8_t CfgCodecOpus = 0x10;       // opus, bit rate is in the opus toc
+  static const uint8_t CfgCodecNone = 0x1F;       // end of transmission without audio
+
+  static uint8_t getCodecId(int codecType, int codecMode);
+  static void write(uint8_t *packet, uint8_t codecId, uint8_t seq, bool isEot);
+  static bool read(const uint8_t *packet, int packetSize, uint8_t &codecId, uint8_t &seq, bool &isEot);
+  static void setEot(uint8_t *packet) { packet[0] |= CfgEotFlag; }
+
+  static void writeSid(uint8_t *packet, uint8_t seq, int noiseLevel);
+  static bool readSid(const uint8_t *packet, int packetSize, int &noiseLevel);
+
+private:
+  static const uint8_t CfgEotFlag = 0x80;
+  static const uint8_t CfgSidFlag = 0x40;
+  static const int CfgSidLevelShift = 2;          // noise level resolution
+  static const uint8_t CfgCodecMask = 0x1F;
+};
+
+struct VoiceStreamStats {
+  long received;        // packets accepted for playback
+  long lost;            // sequence gaps
+  long duplicated;      // repeated or late packets, dropped
+  long undecodable;     // unknown codec or broken header, dropped
+};
+
+// Tracks packet sequence numbers of one received voice stream.
+class VoiceStreamTracker {
+
+public:
+  VoiceStreamTracker();
+
+  void reset();
+
+  // returns false if packet is a duplicate or came too late
+  bool onPacket(uint8_t seq);
+  void onUndecodable() { stats_.undecodable++; }
+
+  inline const VoiceStreamStats &getStats() const { return stats_; }
+
+private:
+  static const uint8_t CfgMaxSeqGap = 128;        // larger forward gap is treated as late packet
+
+  VoiceStreamStats stats_;
+  uint8_t expectedSeq_;
+  bool isStarted_;
+};
+
+} // LoraDv
+
+#endif // VOICE_HEADER_H
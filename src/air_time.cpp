@@ -0,0 +1,164 @@
+#include <math.h>
+#include <algorithm>
+#include <codec2.h>
+
+#include "air_time.h"
+#include "loradv_config.h"
+#include "voice_fec.h"
+#include "voice_header.h"
+#include "radio_cipher.h"
+#include "opus_superframe.h"
+
+namespace LoraDv {
+
+float AirTime::getLoraSymbolTimeMs(int sf, long bw)
+{
+  return 1000.0f * (float)(1L << sf) / (float)bw;
+}
+
+bool AirTime::isLoraLowDataRateOptimize(int sf, long bw)
+{
+  // radiolib enables it automatically for long symbols
+  return getLoraSymbolTimeMs(sf, bw) >= CfgLdroSymbolTimeMs;
+}
+
+float AirTime::getLoraTimeOnAirMs(int payloadSize, int sf, long bw, int cr, int preambleLen,
+  bool isImplicitHeader, bool isCrcOn)
+{
+  // semtech an1200.13, cr is 5..8 for 4/5..4/8
+  float symbolTimeMs = getLoraSymbolTimeMs(sf, bw);
+  int de = isLoraLowDataRateOptimize(sf, bw) ? 1 : 0;
+  int ih = isImplicitHeader ? 1 : 0;
+  int crc = isCrcOn ? 1 : 0;
+  float preambleMs = (preambleLen + 4.25f) * symbolTimeMs;
+  int payloadBits = 8 * payloadSize - 4 * sf + 28 + 16 * crc - 20 * ih;
+  int payloadSymbols = 8 + std::max((int)ceil((float)payloadBits / (4 * (sf - 2 * de))) * cr, 0);
+  return preambleMs + payloadSymbols * symbolTimeMs;
+}
+
+float AirTime::getFskTimeOnAirMs(int payloadSize, float bitRateKbps)
+{
+  int bits = CfgFskPreambleBits + 8 * (CfgFskSyncWordSize + CfgFskLengthSize + payloadSize + CfgFskCrcSize);
+  return (float)bits / bitRateKbps;
+}
+
+float AirTime::getLoraRequiredSnr(int sf)
+{
+  // demodulator snr limit
+  switch (sf) {
+    case 6: return -5.0;
+    case 7: return -7.5;
+    case 8: return -10.0;
+    case 9: return -12.6;
+    case 10: return -15.0;
+    case 11: return -17.5;
+    case 12: return -20.0;
+  }
+  return -7.0;
+}
+
+int AirTime::getCodec2FrameSize(int codec2Mode)
+{
+  switch (codec2Mode) {
+    case CODEC2_MODE_3200: return 8;
+    case CODEC2_MODE_2400: return 6;
+    case CODEC2_MODE_1600: return 8;
+    case CODEC2_MODE_1400: return 7;
+    case CODEC2_MODE_1300: return 7;
+    case CODEC2_MODE_1200: return 6;
+    case CODEC2_MODE_700C: return 4;
+  }
+  return 0;
+}
+
+int AirTime::getCodec2FrameBits(int codec2Mode)
+{
+  switch (codec2Mode) {
+    case CODEC2_MODE_3200: return 64;
+    case CODEC2_MODE_2400: return 48;
+    case CODEC2_MODE_1600: return 64;
+    case CODEC2_MODE_1400: return 56;
+    case CODEC2_MODE_1300: return 52;
+    case CODEC2_MODE_1200: return 48;
+    case CODEC2_MODE_700C: return 28;
+  }
+  return 0;
+}
+
+int AirTime::getCodec2FrameMs(int codec2Mode)
+{
+  switch (codec2Mode) {
+    case CODEC2_MODE_3200:
+    case CODEC2_MODE_2400:
+      return 20;
+  }
+  return 40;
+}
+
+bool AirTime::isLoraImplicitHeader(const Config &config)
+{
+  // packet length must be known in advance, so only fixed frame size codec
+  return config.ModType == CFG_MOD_TYPE_LORA && config.AudioCodec == CFG_AUDIO_CODEC_CODEC2 &&
+    (config.LoraImplicit || config.LoraSf == 6);
+}
+
+float AirTime::getTimeOnAirMs(const Config &config, int sf, int payloadSize)
+{
+  if (config.ModType == CFG_MOD_TYPE_FSK)
+    return getFskTimeOnAirMs(payloadSize, config.FskBitRate);
+  return getLoraTimeOnAirMs(payloadSize, sf, config.LoraBw, config.LoraCodingRate,
+    config.LoraPreambleLen_, isLoraImplicitHeader(config), config.LoraCrc_ != 0);
+}
+
+void AirTime::evaluate(const Config &config, AirTimeReport &report)
+{
+  int codecMode = config.AudioCodec == CFG_AUDIO_CODEC_OPUS ? config.AudioOpusRate : config.AudioCodec2Mode;
+  evaluate(config, config.LoraSf, codecMode, report);
+}
+
+void AirTime::evaluate(const Config &config, int sf, int codecMode, AirTimeReport &report)
+{
+  int frameSize;
+  int frameBits = 0;
+  float frameMs;
+  if (config.AudioCodec == CFG_AUDIO_CODEC_OPUS) {
+    // variable size codec, codec mode is bit rate, one frame per packet or a multi-frame superframe
+    frameMs = config.AudioOpusPcmLen;
+    frameSize = (int)ceil(codecMode * config.AudioOpusPcmLen / 8000.0f);
+    report.framesPerPacket = config.AudioOpusSuperframe
+      ? OpusSuperframe::getFramesPerPacket(frameMs, frameSize, config.AudioMaxPktSize, config.AudioOpusCbr) : 1;
+  } else {
+    // fixed size codec, frames aggregated up to the maximum packet size
+    frameMs = getCodec2FrameMs(codecMode);
+    frameSize = getCodec2FrameSize(codecMode);
+    frameBits = 8 * frameSize;
+    if (config.AudioCodec2BitPack && config.AudioFecDepth == 0) frameBits = getCodec2FrameBits(codecMode);
+    report.framesPerPacket = frameBits > 0 ? std::max(8 * config.AudioMaxPktSize / frameBits, 1) : 1;
+  }
+  bool isFec = config.AudioCodec != CFG_AUDIO_CODEC_OPUS && config.AudioFecDepth > 0 && frameSize > 0;
+  if (isFec) {
+    report.framesPerPacket = std::max(VoiceFec::getFramesPerPacket(frameSize, config.AudioMaxPktSize, config.AudioFecDepth), 1);
+  }
+  // largest packet, also used as fixed implicit header packet size
+  report.payloadSize = config.AudioCodec == CFG_AUDIO_CODEC_OPUS
+    ? OpusSuperframe::getPacketSize(report.framesPerPacket, frameSize, config.AudioOpusCbr)
+    : (report.framesPerPacket * frameBits + 7) / 8;
+  if (isFec) report.payloadSize += VoiceFec::CfgParityHeaderSize;
+  if (config.AudioVoiceHdr) report.payloadSize += VoiceHeader::CfgSize;
+  if (config.AudioEnPriv) report.payloadSize += RadioCipher::CfgOverhead;
+  if (config.LoraAdaptive && config.ModType == CFG_MOD_TYPE_LORA) report.payloadSize += CfgRateDescriptorSize;
+
+  report.packetAirTimeMs = getTimeOnAirMs(config, sf, report.payloadSize);
+  report.packetAudioMs = report.framesPerPacket * frameMs;
+  report.dutyCycle = report.packetAudioMs > 0 ? report.packetAirTimeMs / report.packetAudioMs : 0;
+  report.latencyMs = report.packetAudioMs + report.packetAirTimeMs + frameMs;
+  if (isFec) {
+    // one parity packet per block, whole block is collected before sending and before playing
+    int depth = config.AudioFecDepth;
+    report.dutyCycle *= (float)(depth + 1) / depth;
+    report.latencyMs += (depth - 1) * (report.packetAudioMs + report.packetAirTimeMs);
+  }
+  report.isRealTime = report.dutyCycle > 0 && report.dutyCycle < CfgRealTimeMaxDuty;
+}
+
+} // LoraDv
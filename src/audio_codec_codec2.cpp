@@ -1,44 +1,107 @@
 #include "audio_codec_codec2.h"
+#include "heap_arena.h"
 
 namespace LoraDv {
 
 AudioCodecCodec2::AudioCodecCodec2()
   : codec_(0)
+  , mode_(-1)
+  , isBitPacked_(false)
   , codecSamplesPerFrame_(0)
   , codecBytesPerFrame_(0)
+  , codecBitsPerFrame_(0)
+  , hasLastFrame_(false)
+  , concealedInRow_(0)
 {
 }
 
+size_t AudioCodecCodec2::getArenaSize(const Config &config)
+{
+  return HeapArena::getBlockSize(sizeof(int16_t) * CfgMaxPcmFrameSize) + HeapArena::getBlockSize(CfgMaxFrameSize);
+}
+
+int AudioCodecCodec2::getMaxPcmFrameSize(const Config &config, int sampleRate)
+{
+  // frames resampled to a higher rate are longer
+  int rate = sampleRate > CfgSampleRate ? sampleRate : CfgSampleRate;
+  return (CfgMaxPcmFrameSize * rate + CfgSampleRate - 1) / CfgSampleRate;
+}
+
 bool AudioCodecCodec2::start(std::shared_ptr<const Config> config) 
 {
-  codec_ = codec2_create(config->AudioCodec2Mode);
+  // voice fec interleaves whole bytes, so its frames stay byte aligned
+  isBitPacked_ = config->AudioCodec2BitPack && config->AudioFecDepth == 0;
+  return setMode(config->AudioCodec2Mode);
+}
+
+bool AudioCodecCodec2::startDecoder(std::shared_ptr<const Config> config, int mode, int sampleRate)
+{
+  // codec2 state is shared by encoder and decoder, frames are always at 8 kHz
+  isBitPacked_ = config->AudioCodec2BitPack && config->AudioFecDepth == 0;
+  return setMode(mode);
+}
+
+void AudioCodecCodec2::stop() 
+{
+  if (codec_ != NULL) codec2_destroy(codec_);
+  codec_ = NULL;
+  mode_ = -1;
+}
+
+bool AudioCodecCodec2::setMode(int mode)
+{
+  if (mode == mode_) return true;
+  stop();
+  codec_ = codec2_create(mode);
   if (codec_ == NULL) {
     LOG_ERROR("Failed to create Codec2");
     return false;
   }
+  mode_ = mode;
+  hasLastFrame_ = false;
   codecSamplesPerFrame_ = codec2_samples_per_frame(codec_);
   codecBytesPerFrame_ = codec2_bytes_per_frame(codec_);
-  LOG_INFO("Codec2 started", config->AudioCodec2Mode, codecSamplesPerFrame_, codecBytesPerFrame_);
+  codecBitsPerFrame_ = isBitPacked_ ? codec2_bits_per_frame(codec_) : 8 * codecBytesPerFrame_;
+  LOG_INFO("Codec2 started", mode, codecSamplesPerFrame_, codecBytesPerFrame_, codecBitsPerFrame_);
   return true;
 }
 
-void AudioCodecCodec2::stop() 
-{
-  codec2_destroy(codec_);
-}
-
 int AudioCodecCodec2::encode(uint8_t *encodedOut, int16_t *pcmIn) 
 {
     codec2_encode(codec_, encodedOut, pcmIn);
     return codecBytesPerFrame_;
 }
 
-int AudioCodecCodec2::decode(int16_t *pcmOut, uint8_t *encodedIn, uint16_t encodedSize)
+int AudioCodecCodec2::decode(int16_t *pcmOut, const uint8_t *encodedIn, uint16_t encodedSize)
 {
     codec2_decode(codec_, pcmOut, encodedIn);
+    memcpy(lastFrame_, encodedIn, codecBytesPerFrame_);
+    hasLastFrame_ = true;
+    concealedInRow_ = 0;
     return codecSamplesPerFrame_;
 }
 
+int AudioCodecCodec2::conceal(int16_t *pcmOut)
+{
+  if (!hasLastFrame_) {
+    memset(pcmOut, 0, sizeof(int16_t) * codecSamplesPerFrame_);
+    return codecSamplesPerFrame_;
+  }
+  // repeat last good frame with fade out
+  if (concealedInRow_ < CfgMaxFadeShift) concealedInRow_++;
+  codec2_decode(codec_, pcmOut, lastFrame_);
+  for (int i = 0; i < codecSamplesPerFrame_; i++) {
+    pcmOut[i] >>= concealedInRow_;
+  }
+  return codecSamplesPerFrame_;
+}
+
+int AudioCodecCodec2::recover(int16_t *pcmOut, const uint8_t *nextEncodedIn, uint16_t nextEncodedSize)
+{
+  // no redundancy in codec2 frames, voice fec recovers them before the codec
+  return conceal(pcmOut);
+}
+
 int AudioCodecCodec2::getFrameSize() const
 {
   return codec2_bytes_per_frame(codec_);
@@ -51,7 +114,8 @@ int AudioCodecCodec2::getPcmFrameSize() const
 
 int AudioCodecCodec2::getPcmFrameBufferSize() const
 {
-  return codec2_samples_per_frame(codec_);
+  // fits any mode, so mode could be changed without reallocation
+  return CfgMaxPcmFrameSize;
 }
 
 } // namespace LoraDv
\ No newline at end of file
@@ -1,61 +1,139 @@
+#include <math.h>
+
 #include "audio_codec_opus.h"
 
 namespace LoraDv {
 
-AudioCodecOpus::AudioCodecOpus() 
-  : opusEncoder_(0)
+AudioCodecOpus::AudioCodecOpus(HeapArena *arena) 
+  : arena_(arena)
+  , opusEncoder_(0)
   , opusDecoder_(0)
+  , sampleRate_(0)
+  , isFecEnabled_(false)
+  , isDtxEnabled_(false)
   , pcmFrameSize_(0)
   , pcmFrameBufferSize_(0)
   , encodedFrameBufferSize_(0)
 {
 }
 
+size_t AudioCodecOpus::getArenaSize(const Config &config)
+{
+  int pcmFrameBufferSize = config.AudioOpusSampleRate_ / 1000 * CfgMaxPacketMs;
+  return HeapArena::getBlockSize(opus_encoder_get_size(1)) 
+    + HeapArena::getBlockSize(opus_decoder_get_size(1))
+    + HeapArena::getBlockSize(sizeof(int16_t) * pcmFrameBufferSize)
+    + HeapArena::getBlockSize(CfgEncodedFrameBufferSize);
+}
+
+int AudioCodecOpus::getMaxPcmFrameSize(const Config &config, int sampleRate)
+{
+  // frames resampled to a higher rate are longer
+  int rate = sampleRate > config.AudioOpusSampleRate_ ? sampleRate : config.AudioOpusSampleRate_;
+  return (int)ceilf(rate * config.AudioOpusPcmLen / 1000);
+}
+
 bool AudioCodecOpus::start(std::shared_ptr<const Config> config) 
 {
-  int encoderError;
-  opusEncoder_ = opus_encoder_create(config->AudioSampleRate_, 1, OPUS_APPLICATION_VOIP, &encoderError);
-  if (encoderError != OPUS_OK) {
-    LOG_ERROR("Failed to create OPUS encoder, error", encoderError);
-    return false;
+  sampleRate_ = config->AudioOpusSampleRate_;
+  // state is placed into the arena if given, rebuilding it does not touch the heap
+  int encoderError = OPUS_ALLOC_FAIL;
+  if (arena_ != nullptr) {
+    opusEncoder_ = (OpusEncoder*)arena_->allocate(opus_encoder_get_size(1));
+    if (opusEncoder_ != nullptr) encoderError = opus_encoder_init(opusEncoder_, sampleRate_, 1, OPUS_APPLICATION_VOIP);
+  } else {
+    opusEncoder_ = opus_encoder_create(sampleRate_, 1, OPUS_APPLICATION_VOIP, &encoderError);
   }
-  encoderError = opus_encoder_init(opusEncoder_, config->AudioSampleRate_, 1, OPUS_APPLICATION_VOIP);
   if (encoderError != OPUS_OK) {
-    LOG_ERROR("Failed to initialize OPUS encoder, error", encoderError);
+    LOG_ERROR("Failed to create OPUS encoder, error", encoderError);
     return false;
   }
   opus_encoder_ctl(opusEncoder_, OPUS_SET_BITRATE(config->AudioOpusRate));
   opus_encoder_ctl(opusEncoder_, OPUS_SET_COMPLEXITY(CfgComplexity));
   opus_encoder_ctl(opusEncoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+  // hard cbr keeps every frame and so every superframe packet of the same size
+  opus_encoder_ctl(opusEncoder_, OPUS_SET_VBR(config->AudioOpusCbr ? 0 : 1));
+  // in-band fec carries previous frame at lower rate, amount follows expected loss
+  isFecEnabled_ = config->AudioOpusFec;
+  opus_encoder_ctl(opusEncoder_, OPUS_SET_INBAND_FEC(isFecEnabled_ ? 1 : 0));
+  opus_encoder_ctl(opusEncoder_, OPUS_SET_PACKET_LOSS_PERC(0));
+  // encoder marks silent frames, they are not sent same as in speech pauses
+  isDtxEnabled_ = config->AudioDtx;
+  opus_encoder_ctl(opusEncoder_, OPUS_SET_DTX(isDtxEnabled_ ? 1 : 0));
+
+  // configure decoder, same as the decoder only instance
+  return startDecoder(config, config->AudioOpusRate, sampleRate_);
+}
 
-  // configure decoder
-  int decoderError;
-  opusDecoder_ = opus_decoder_create(config->AudioSampleRate_, 1, &decoderError);
+bool AudioCodecOpus::startDecoder(std::shared_ptr<const Config> config, int mode, int sampleRate)
+{
+  // bit rate and frame duration are in the opus toc, so mode is not needed
+  sampleRate_ = sampleRate;
+  int decoderError = OPUS_ALLOC_FAIL;
+  if (arena_ != nullptr) {
+    opusDecoder_ = (OpusDecoder*)arena_->allocate(opus_decoder_get_size(1));
+    if (opusDecoder_ != nullptr) decoderError = opus_decoder_init(opusDecoder_, sampleRate_, 1);
+  } else {
+    opusDecoder_ = opus_decoder_create(sampleRate_, 1, &decoderError);
+  }
   if (decoderError != OPUS_OK) {
     LOG_ERROR("Failed to create OPUS decoder, error", decoderError);
     return false;
   } 
-
-  pcmFrameSize_ = (int)(config->AudioSampleRate_ / 1000 * config->AudioOpusPcmLen);
-  pcmFrameBufferSize_ = 10 * pcmFrameSize_;
+  // decoded output is bounded by the longest opus packet
+  pcmFrameSize_ = (int)(sampleRate_ / 1000 * config->AudioOpusPcmLen);
+  pcmFrameBufferSize_ = sampleRate_ / 1000 * CfgMaxPacketMs;
   encodedFrameBufferSize_ = CfgEncodedFrameBufferSize;
   return true;
 }
 
 void AudioCodecOpus::stop() 
 {
-  opus_encoder_destroy(opusEncoder_);
-  opus_decoder_destroy(opusDecoder_);
+  // decoder only instance has no encoder, arena state is released with the arena
+  if (arena_ == nullptr && opusEncoder_ != 0) opus_encoder_destroy(opusEncoder_);
+  if (arena_ == nullptr && opusDecoder_ != 0) opus_decoder_destroy(opusDecoder_);
+  opusEncoder_ = 0;
+  opusDecoder_ = 0;
+}
+
+bool AudioCodecOpus::setMode(int mode)
+{
+  return opus_encoder_ctl(opusEncoder_, OPUS_SET_BITRATE(mode)) == OPUS_OK;
 }
 
 int AudioCodecOpus::encode(uint8_t *encodedOut, int16_t *pcmIn) 
 {
-  return opus_encode(opusEncoder_, pcmIn, pcmFrameSize_, encodedOut, encodedFrameBufferSize_);
+  int encodedSize = opus_encode(opusEncoder_, pcmIn, pcmFrameSize_, encodedOut, encodedFrameBufferSize_);
+  if (isDtxEnabled_ && encodedSize > 0 && encodedSize <= CfgDtxFrameSize) return 0;
+  return encodedSize;
 }
 
-int AudioCodecOpus::decode(int16_t *pcmOut, uint8_t *encodedIn, uint16_t encodedSize) 
+int AudioCodecOpus::decode(int16_t *pcmOut, const uint8_t *encodedIn, uint16_t encodedSize) 
 {
   return opus_decode(opusDecoder_, encodedIn, encodedSize, pcmOut, pcmFrameBufferSize_, 0);
 }
 
+int AudioCodecOpus::conceal(int16_t *pcmOut)
+{
+  // decoder extrapolates from its state when there is no data
+  return opus_decode(opusDecoder_, NULL, 0, pcmOut, pcmFrameSize_, 0);
+}
+
+int AudioCodecOpus::recover(int16_t *pcmOut, const uint8_t *nextEncodedIn, uint16_t nextEncodedSize)
+{
+  // decoder falls back to concealment if next frame has no fec data
+  return opus_decode(opusDecoder_, nextEncodedIn, nextEncodedSize, pcmOut, pcmFrameSize_, 1);
+}
+
+bool AudioCodecOpus::setComplexity(int complexity)
+{
+  return opus_encoder_ctl(opusEncoder_, OPUS_SET_COMPLEXITY(complexity)) == OPUS_OK;
+}
+
+void AudioCodecOpus::setPacketLoss(int lossPercent)
+{
+  if (!isFecEnabled_) return;
+  opus_encoder_ctl(opusEncoder_, OPUS_SET_PACKET_LOSS_PERC(lossPercent));
+}
+
 } // namespace LoraDv
\ No newline at end of file
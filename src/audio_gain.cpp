@@ -0,0 +1,80 @@
+#include "audio_gain.h"
+
+namespace LoraDv {
+
+AudioGain::AudioGain()
+  : volume_(-1)
+  , volumeGain_(0)
+  , gain_(0)
+{
+  setVolume(100);
+}
+
+void AudioGain::setVolume(int volume)
+{
+  if (volume == volume_) return;
+  volume_ = volume;
+  volumeGain_ = ((int32_t)volume << CfgGainShift) / 100;
+  if (gain_ > volumeGain_) gain_ = volumeGain_;
+}
+
+void AudioGain::reset()
+{
+  gain_ = volumeGain_;
+}
+
+int16_t AudioGain::softClip(int32_t sample)
+{
+  // above the limiter level slope falls from 1 to 0 over the knee, y = x - x^2 / (2 * width),
+  // division is a multiply by the rounded up reciprocal
+  int32_t level = sample < 0 ? -sample : sample;
+  int32_t over = level - CfgLimitLevel;
+  if (over <= 0) return sample;
+  if (over >= CfgKneeWidth) {
+    level = CfgMaxLevel;
+  } else {
+    level -= ((over * over) >> 8) * CfgKneeRecip >> 16;
+  }
+  return sample < 0 ? -level : level;
+}
+
+void AudioGain::process(const int16_t *pcmIn, int16_t *pcmOut, int sampleCount)
+{
+  if (sampleCount <= 0) return;
+
+  // look ahead for the loudest sample
+  int32_t peak = 0;
+  int peakIndex = 0;
+  for (int i = 0; i < sampleCount; i++) {
+    int32_t level = pcmIn[i] < 0 ? -(int32_t)pcmIn[i] : pcmIn[i];
+    if (level > peak) {
+      peak = level;
+      peakIndex = i;
+    }
+  }
+
+  // attack is reached by the peak, release is spread over the frame
+  int32_t targetGain = volumeGain_;
+  if ((peak * targetGain) >> CfgGainShift > CfgLimitLevel) {
+    targetGain = (CfgLimitLevel << CfgGainShift) / peak;
+  }
+  int rampLength = sampleCount;
+  if (targetGain < gain_) {
+    rampLength = peakIndex + 1;
+  } else if (targetGain > gain_) {
+    targetGain = gain_ + ((targetGain - gain_ + (1 << CfgReleaseShift) - 1) >> CfgReleaseShift);
+  }
+
+  int32_t rampGain = gain_ << CfgRampShift;
+  int32_t rampStep = ((targetGain - gain_) << CfgRampShift) / rampLength;
+  for (int i = 0; i < rampLength; i++) {
+    rampGain += rampStep;
+    pcmOut[i] = softClip((pcmIn[i] * (rampGain >> CfgRampShift)) >> CfgGainShift);
+  }
+  for (int i = rampLength; i < sampleCount; i++) {
+    pcmOut[i] = softClip((pcmIn[i] * targetGain) >> CfgGainShift);
+  }
+  gain_ = targetGain;
+}
+
+} // LoraDv
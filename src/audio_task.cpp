@@ -2,22 +2,84 @@
 
 #include "audio_codec_codec2.h"
 #include "audio_codec_opus.h"
+#include "air_time.h"
+#include "bit_packer.h"
 
 namespace LoraDv {
 
 AudioTask::AudioTask()
   : config_(nullptr)
   , audioTaskHandle_(0)
+  , captureTaskHandle_(0)
+  , playbackTaskHandle_(0)
+  , audioArena_("Audio")
+  , playoutAllocCount_(0)
+  , captureDropBuffer_(0)
+  , captureSamples_(0)
+  , isCapturing_(false)
+  , captureStats_()
+  , encodeStats_()
+  , decodeStats_()
+  , playbackStats_()
+  , i2sSampleRate_(0)
+  , codecSampleRate_(0)
+  , captureResampler_()
+  , playbackResampler_()
+  , captureFrameBuffer_(0)
+  , playbackFrameBuffer_(0)
+  , micDsp_()
+  , isComplexityAdaptive_(false)
+  , complexityController_()
+  , vad_()
   , radioTask_(nullptr)
   , pmService_(nullptr)
   , audioCodec_(nullptr)
+  , decoderCache_()
+  , rxCodec_(nullptr)
+  , rxCodecId_(VoiceHeader::CfgCodecNone)
+  , rxBytesPerFrame_(0)
+  , rxBitsPerFrame_(0)
   , pcmFrameBuffer_(0)
   , encodedFrameBuffer_(0)
+  , encodedFrameBufferSize_(0)
   , codecSamplesPerFrame_(0)
   , codecBytesPerFrame_(0)
+  , codecBitsPerFrame_(0)
+  , codecMode_(0)
+  , isReconfigPending_(false)
+  , isFixedPacketSize_(false)
+  , isVoiceHdr_(false)
+  , packetHeaderSize_(0)
+  , txSeq_(0)
+  , txPacket_(nullptr)
+  , txPacketSize_(0)
+  , linkLossPercent_(0)
+  , isOpusSuperframe_(false)
+  , opusSuperframe_()
+  , jitterStorage_(nullptr)
+  , isPlayoutStarted_(false)
+  , playoutNextMs_(0)
+  , isFecEnabled_(false)
+  , fecFlushTimeoutMs_(0)
+  , fecFlushAtMs_(0)
+  , fecEncoderBuffer_(nullptr)
+  , fecDecoderBuffer_(nullptr)
+  , fecDepth_(0)
+  , fecPacketSize_(0)
+  , isDtxEnabled_(false)
+  , isVoxEnabled_(false)
+  , preRollFrames_(0)
+  , voiceFrames_(0)
+  , isTalkSpurt_(false)
+  , lastSidMs_(0)
+  , comfortNoiseLevel_(0)
+  , comfortNoiseSeed_(1)
+  , playbackGain_()
   , volume_(0)
   , maxVolume_(0)
   , isPttOn_(false)
+  , isVoxListening_(false)
+  , isVoxKeyed_(false)
   , isRunning_(false)
   , shouldUpdateScreen_(false)
   , isPlaying_(false)
@@ -31,8 +93,9 @@ void AudioTask::start(std::shared_ptr<const Config> config, std::shared_ptr<Radi
   radioTask_ = radioTask;
   pmService_ = pmService;
   volume_ = config->AudioVol;
+  linkLossPercent_ = CfgInitialLossPercent;
   maxVolume_ = config->AudioMaxVol_;
-  xTaskCreate(&task, "AudioTask", CfgAudioTaskStack, this, 5, &audioTaskHandle_);
+  xTaskCreatePinnedToCore(&task, "AudioTask", CfgAudioTaskStack, this, 5, &audioTaskHandle_, CfgAudioTaskCore);
 }
 
 void AudioTask::changeVolume(int deltaVolume) 
@@ -47,7 +110,7 @@ void AudioTask::installAudio(int bytesPerSample) const
   // speaker
   i2s_config_t i2sSpeakerConfig = {
     .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
-    .sample_rate = config_->AudioSampleRate_,
+    .sample_rate = (uint32_t)i2sSampleRate_,
     .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
     .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
     .communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_STAND_I2S),
@@ -73,7 +136,7 @@ void AudioTask::installAudio(int bytesPerSample) const
   // mic
   i2s_config_t i2sMicConfig = {
     .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-    .sample_rate = config_->AudioSampleRate_,
+    .sample_rate = (uint32_t)i2sSampleRate_,
     .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
     .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
     .communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_STAND_I2S),
@@ -116,6 +179,14 @@ void AudioTask::playTimerReset()
   playTimerTask_ = playTimer_.in(CfgPlayCompletedDelayMs, playTimerEnter, this);
 }
 
+void AudioTask::playTimerStop()
+{
+  if (playTimerTask_ != 0) {
+    playTimer_.cancel(playTimerTask_);
+  }
+  playTimer();
+}
+
 bool AudioTask::playTimerEnter(void *param)
 {
   static_cast<AudioTask*>(param)->playTimer();
@@ -141,6 +212,11 @@ void AudioTask::setPtt(bool isPttOn)
   isPttOn_ = isPttOn;
 }
 
+void AudioTask::reconfigure() const
+{
+  xTaskNotify(audioTaskHandle_, CfgAudioConfigBit, eSetBits);
+}
+
 void AudioTask::play() const
 {
   xTaskNotify(audioTaskHandle_, CfgAudioPlayBit, eSetBits);
@@ -156,149 +232,1173 @@ void AudioTask::task(void *param) {
   static_cast<AudioTask*>(param)->audioTask();
 }
 
+void AudioTask::captureTask(void *param) {
+  static_cast<AudioTask*>(param)->audioCaptureTask();
+}
+
+void AudioTask::playbackTask(void *param) {
+  static_cast<AudioTask*>(param)->audioPlaybackTask();
+}
+
 void AudioTask::audioTask()
 {
   LOG_INFO("Audio task started");
   isRunning_ = true;
 
+  // arena is reserved once at its largest, so codec switches never reallocate it
+  if (!audioArena_.reserve(audioTaskMaxArenaSize())) {
+    audioTaskShutdown();
+    return;
+  }
+  if (!audioTaskSetupCodec()) {
+    LOG_ERROR("Failed to setup codec");
+    audioTaskShutdown();
+    return;
+  }
+
+  delay(3000);
+  installAudio(audioTaskI2sFrameSize());
+
+  // i2s stages are dma driven and only move frames, codec work stays on this core
+  xTaskCreatePinnedToCore(&captureTask, "AudioCapture", CfgAudioIoTaskStack, this, 
+    CfgAudioIoTaskPriority, &captureTaskHandle_, CfgAudioIoTaskCore);
+  xTaskCreatePinnedToCore(&playbackTask, "AudioPlayback", CfgAudioIoTaskStack, this, 
+    CfgAudioIoTaskPriority, &playbackTaskHandle_, CfgAudioIoTaskCore);
+
+  while(isRunning_) {
+    uint32_t audioBits = 0;
+    if (xTaskNotifyWaitIndexed(0, 0x00, ULONG_MAX, &audioBits, audioTaskWaitTicks()) == pdTRUE) {
+      LOG_DEBUG("Audio task command bits", audioBits);
+      if (audioBits & CfgAudioConfigBit) {
+        isReconfigPending_ = true;
+      }
+      if (audioBits & CfgAudioPlayBit) {
+        audioTaskPlay();
+      } else if (audioBits & CfgAudioRecBit) {
+        audioTaskRecord();
+      }
+    }
+    // incomplete fec block and no more packets, play what was received
+    if (fecDecoder_.hasPending() && (int32_t)(millis() - fecFlushAtMs_) >= 0) {
+      fecDecoder_.flush();
+      audioTaskPlayFec();
+    }
+    audioTaskPlayout();
+    audioTaskVox();
+    // decoders of other codecs are freed when nobody transmits with them for a while
+    if (rxCodec_ == audioCodec_) decoderCache_.evict(millis());
+    if (isReconfigPending_ && audioTaskCanReconfigure()) {
+      audioTaskReconfigure();
+    }
+  }
+  audioTaskShutdown();
+}
+
+void AudioTask::audioTaskShutdown()
+{
+  isRunning_ = false;
+  // capture and playback tasks exit on wake up, they are not created if the first setup fails
+  if (captureTaskHandle_ != 0) xTaskNotify(captureTaskHandle_, 0, eNoAction);
+  if (playbackTaskHandle_ != 0) xTaskNotify(playbackTaskHandle_, 0, eNoAction);
+
+  audioTaskStopCodec();
+  audioArena_.release();
+
+  uninstallAudio();
+
+  LOG_INFO("Audio task stopped");
+  vTaskDelete(NULL);
+}
+
+size_t AudioTask::audioTaskArenaSize(int codec, int captureSlotSize, int fecDepth, int fecPacketSize, 
+  uint32_t micDspStages) const
+{
+  // every buffer at its largest, pcm buffer and split frame buffer also fit other codecs
+  size_t codecSize = codec == CFG_AUDIO_CODEC_OPUS
+    ? AudioCodecOpus::getArenaSize(*config_)
+    : AudioCodecCodec2::getArenaSize(*config_);
+  size_t queueSize = HeapArena::getBlockSize(captureQueue_.getStorageSize(captureSlotSize))
+    + HeapArena::getBlockSize(preRollQueue_.getStorageSize(captureSlotSize))
+    + HeapArena::getBlockSize(playbackQueue_.getStorageSize(CfgPcmSlotSize));
+  // fec is used only by fixed frame size codecs, but it is known after codec start
+  size_t fecSize = 0;
+  if (fecDepth > 0) {
+    fecSize = HeapArena::getBlockSize(VoiceFecEncoder::getBufferSize(fecDepth, fecPacketSize))
+      + HeapArena::getBlockSize(VoiceFecDecoder::getBufferSize(fecDepth, fecPacketSize));
+  }
+  // mic dsp runs at the codec rate
+  int codecRate = codec == CFG_AUDIO_CODEC_OPUS
+    ? config_->AudioOpusSampleRate_ : AudioCodecCodec2::CfgSampleRate;
+  size_t micDspSize = MicDsp::getArenaSize(codecRate, micDspStages);
+  return codecSize + queueSize + fecSize + micDspSize + HeapArena::getBlockSize(JitterBuffer::CfgBufferSize)
+    + 4 * HeapArena::getBlockSize(CfgPcmSlotSize) + HeapArena::getBlockSize(OpusSuperframe::CfgBufferSize);
+}
+
+size_t AudioTask::audioTaskMaxArenaSize() const
+{
+  // any codec and setting the menu could select, fec is used by codec2 only
+  size_t codec2Size = audioTaskArenaSize(CFG_AUDIO_CODEC_CODEC2, CfgPcmSlotSize, VoiceFec::CfgMaxDepth,
+    RadioTask::getMaxPacketSize(), MicDsp::CfgStageAll);
+  size_t opusSize = audioTaskArenaSize(CFG_AUDIO_CODEC_OPUS, CfgPcmSlotSize, 0, 0, MicDsp::CfgStageAll);
+  return max(codec2Size, opusSize);
+}
+
+int AudioTask::audioTaskFecPacketSize() const
+{
+  return min(config_->AudioMaxPktSize, RadioTask::getMaxPacketSize());
+}
+
+uint32_t AudioTask::audioTaskMicDspStages() const
+{
+  uint32_t stages = 0;
+  if (config_->AudioMicDsp) stages |= MicDsp::CfgStageAll & ~(1 << MicDsp::CfgStageNoise);
+  if (config_->AudioNoiseSup) stages |= 1 << MicDsp::CfgStageNoise;
+  return stages;
+}
+
+int AudioTask::audioTaskCaptureSlotSize() const
+{
+  // captured frames are at the i2s rate, pre-roll ones at the codec rate
+  int frameSize = config_->AudioCodec == CFG_AUDIO_CODEC_OPUS
+    ? AudioCodecOpus::getMaxPcmFrameSize(*config_, config_->AudioSampleRate_)
+    : AudioCodecCodec2::getMaxPcmFrameSize(*config_, config_->AudioSampleRate_);
+  return min((int)sizeof(int16_t) * frameSize, (int)CfgPcmSlotSize);
+}
+
+bool AudioTask::audioTaskSetupCodec()
+{
+  // codec state and buffers are rebuilt in place within the block reserved on start
+  if (!audioArena_.reserve(audioTaskArenaSize(config_->AudioCodec, audioTaskCaptureSlotSize(), 
+      config_->AudioFecDepth, audioTaskFecPacketSize(), audioTaskMicDspStages()))) return false;
+  int slotSamples = CfgPcmSlotSize / sizeof(int16_t);
+  captureDropBuffer_ = audioArena_.allocate<int16_t>(slotSamples);
+  // queues are idle on reconfigure, so their slots are moved with the arena
+  int captureSlotSize = audioTaskCaptureSlotSize();
+  if (!captureQueue_.setup(audioArena_.allocate<uint8_t>(captureQueue_.getStorageSize(captureSlotSize)), captureSlotSize)
+      || !preRollQueue_.setup(audioArena_.allocate<uint8_t>(preRollQueue_.getStorageSize(captureSlotSize)), captureSlotSize)
+      || !playbackQueue_.setup(audioArena_.allocate<uint8_t>(playbackQueue_.getStorageSize(CfgPcmSlotSize)), CfgPcmSlotSize)) {
+    LOG_ERROR("Failed to setup audio queues");
+    return false;
+  }
+  jitterStorage_ = audioArena_.allocate<uint8_t>(JitterBuffer::CfgBufferSize);
+
   // select and codec
   if (config_->AudioCodec == CFG_AUDIO_CODEC_CODEC2)
     audioCodec_.reset(new AudioCodecCodec2());
   else if (config_->AudioCodec == CFG_AUDIO_CODEC_OPUS)
-    audioCodec_.reset(new AudioCodecOpus());
+    audioCodec_.reset(new AudioCodecOpus(&audioArena_));
   else {
     LOG_ERROR("Unknown codec", config_->AudioCodec);
-    return;
+    return false;
   }
 
-  audioCodec_->start(config_);
+  if (!audioCodec_->start(config_)) {
+    LOG_ERROR("Failed to start codec");
+    return false;
+  }
 
   // construct buffers
   codecSamplesPerFrame_ = audioCodec_->getPcmFrameSize();
   codecBytesPerFrame_ = audioCodec_->getFrameSize();
-  pcmFrameBuffer_ = new int16_t[audioCodec_->getPcmFrameBufferSize()];
-  encodedFrameBuffer_ = new uint8_t[codecBytesPerFrame_];
+  codecBitsPerFrame_ = audioCodec_->getFrameBits();
+  codecMode_ = config_->AudioCodec == CFG_AUDIO_CODEC_OPUS ? config_->AudioOpusRate : config_->AudioCodec2Mode;
+  // decoders of other codecs produce up to the longest opus frame and split frames up to the radio packet
+  int superframeSize = OpusSuperframe::CfgBufferSize;
+  encodedFrameBufferSize_ = max(audioCodec_->getFrameBufferSize(), superframeSize);
+  pcmFrameBuffer_ = audioArena_.allocate<int16_t>(max(audioCodec_->getPcmFrameBufferSize(), slotSamples));
+  encodedFrameBuffer_ = audioArena_.allocate<uint8_t>(encodedFrameBufferSize_);
 
-  delay(3000);
-  installAudio(codecSamplesPerFrame_);
+  // i2s runs at its own rate, codec gets its native rate through resamplers
+  codecSampleRate_ = audioCodec_->getSampleRate();
+  if (!audioTaskSetupResampler()) return false;
+  // decoders of other codecs could need playback resampling even at the same i2s and codec rate
+  if (captureResampler_.isActive()) {
+    captureFrameBuffer_ = audioArena_.allocate<int16_t>(slotSamples);
+  }
+  playbackFrameBuffer_ = audioArena_.allocate<int16_t>(slotSamples);
+  if (captureDropBuffer_ == nullptr || pcmFrameBuffer_ == nullptr || encodedFrameBuffer_ == nullptr 
+      || playbackFrameBuffer_ == nullptr || jitterStorage_ == nullptr) return false;
+  // fec block buffers are needed only by fixed frame size codecs
+  isFecEnabled_ = audioCodec_->isFixedFrameSize() && config_->AudioFecDepth > 0;
+  if (isFecEnabled_) {
+    // menu edits the live config, fec is set up again on profile change with these sizes
+    fecDepth_ = config_->AudioFecDepth;
+    fecPacketSize_ = audioTaskFecPacketSize();
+    fecEncoderBuffer_ = audioArena_.allocate<uint8_t>(VoiceFecEncoder::getBufferSize(fecDepth_, fecPacketSize_));
+    fecDecoderBuffer_ = audioArena_.allocate<uint8_t>(VoiceFecDecoder::getBufferSize(fecDepth_, fecPacketSize_));
+    if (fecEncoderBuffer_ == nullptr || fecDecoderBuffer_ == nullptr) return false;
+  }
+  // mic dsp runs at the codec rate, noise suppressor buffers depend on it
+  if (!micDsp_.setup(codecSampleRate_, audioTaskMicDspStages(), &audioArena_)) {
+    LOG_ERROR("Noise suppressor does not fit the arena, it is off");
+  }
+  audioArena_.logReport();
+  playoutAllocCount_ = HeapArena::getAllocCount();
 
-  while(isRunning_) {
-    uint32_t audioBits = 0;
-    xTaskNotifyWaitIndexed(0, 0x00, ULONG_MAX, &audioBits, portMAX_DELAY);
+  // implicit lora header needs every packet to be full
+  isFixedPacketSize_ = AirTime::isLoraImplicitHeader(*config_);
 
-    LOG_DEBUG("Audio task command bits", audioBits);
-    if (audioBits & CfgAudioPlayBit) {
-      audioTaskPlay();
-    } else if (audioBits & CfgAudioRecBit) {
-      audioTaskRecord();
-    }
+  // stream header in front of every packet
+  isVoiceHdr_ = config_->AudioVoiceHdr;
+  packetHeaderSize_ = isVoiceHdr_ ? VoiceHeader::CfgSize : 0;
+  rxTracker_.reset();
+
+  // opus frames are combined on send if enabled, received superframes are always split
+  isOpusSuperframe_ = opusSuperframe_.setup(config_->AudioOpusPcmLen, config_->AudioMaxPktSize) 
+    && config_->AudioCodec == CFG_AUDIO_CODEC_OPUS && config_->AudioOpusSuperframe;
+
+  // fec for fixed frame size codecs
+  if (isFecEnabled_) {
+    RateProfile profile = { config_->LoraSf, codecMode_ };
+    audioTaskSetupFec(profile);
   }
+  // streams of other codecs are decoded at the own codec rate where possible
+  decoderCache_.setup(config_, codecSampleRate_);
+  rxCodecId_ = VoiceHeader::CfgCodecNone;
+  audioTaskSelectDecoder(VoiceHeader::getCodecId(config_->AudioCodec, codecMode_));
+  isDtxEnabled_ = config_->AudioDtx;
+  isVoxEnabled_ = config_->AudioVox;
+  audioTaskSetupVad();
+  audioTaskSetupComplexity();
+  return true;
+}
 
-  delete encodedFrameBuffer_;
-  delete pcmFrameBuffer_;
-  audioCodec_->stop();
+void AudioTask::audioTaskStopCodec()
+{
+  // buffers stay in the arena till the next setup
+  captureDropBuffer_ = nullptr;
+  playbackFrameBuffer_ = nullptr;
+  captureFrameBuffer_ = nullptr;
+  encodedFrameBuffer_ = nullptr;
+  pcmFrameBuffer_ = nullptr;
+  rxCodec_.reset();
+  decoderCache_.clear();
+  // capture is stopped, frames left by vox listening are of the old codec rate
+  captureQueue_.clear();
+  preRollQueue_.clear();
+  if (audioCodec_) {
+    audioCodec_->stop();
+    audioCodec_.reset();
+  }
+}
 
-  uninstallAudio();
+bool AudioTask::audioTaskCanReconfigure() const
+{
+  // nothing is transmitted, received or still on the way to the speaker
+  return !isPttOn_ && !isVoxKeyed_ && !isCapturing_
+    && !jitterBuffer_.isActive() && !fecDecoder_.hasPending() && playbackQueue_.isEmpty();
+}
 
-  LOG_INFO("Audio task stopped");
+void AudioTask::audioTaskReconfigure()
+{
+  isReconfigPending_ = false;
+  uint32_t startUs = micros();
+  int i2sSampleRate = i2sSampleRate_;
+  int i2sFrameSize = audioTaskI2sFrameSize();
+
+  // old codec goes first, new one is built in its arena space
+  audioTaskStopCodec();
+  if (!audioTaskSetupCodec()) {
+    LOG_ERROR("Failed to switch codec");
+    audioTaskShutdown();
+    return;
+  }
+  // dma buffers are sized by the frame, driver is reinstalled only if frame or rate has changed
+  bool isI2sChanged = i2sSampleRate != i2sSampleRate_ || i2sFrameSize != audioTaskI2sFrameSize();
+  if (isI2sChanged) {
+    uninstallAudio();
+    installAudio(audioTaskI2sFrameSize());
+  }
+  radioTask_->codecChanged();
+
+  uint32_t switchUs = micros() - startUs;
+  LOG_INFO("Codec switched in", switchUs, "us, i2s reinstalled", isI2sChanged);
+  if (switchUs > CfgMaxSwitchUs) {
+    LOG_ERROR("Codec switch is over budget, us", switchUs);
+  }
+}
+
+void AudioTask::audioCaptureTask()
+{
+  LOG_INFO("Audio capture task started");
+  while (isRunning_) {
+    xTaskNotifyWait(0x00, ULONG_MAX, NULL, portMAX_DELAY);
+    if (!isPttOn_ && !isVoxKeyed_ && !isVoxListening_) continue;
+    isCapturing_ = true;
+    i2s_start(CfgAudioI2sMicId);
+    while (isRunning_ && (isPttOn_ || isVoxKeyed_ || isVoxListening_)) {
+      int16_t *pcmFrame = (int16_t*)captureQueue_.writeBegin();
+      // encoder is behind, keep dma running and drop the frame
+      bool isDropped = pcmFrame == nullptr;
+      if (isDropped) pcmFrame = captureDropBuffer_;
+      size_t bytesRead = 0;
+      int frameBytes = min((int)sizeof(int16_t) * captureSamples_, captureQueue_.getSlotSize());
+      // blocks till dma fills the frame, so it measures how far behind the encoder is
+      uint32_t startUs = micros();
+      i2s_read(CfgAudioI2sMicId, pcmFrame, frameBytes, &bytesRead, portMAX_DELAY);
+      if (isDropped) {
+        captureStats_.dropped++;
+        continue;
+      }
+      captureStats_.add(micros() - startUs);
+      captureQueue_.writeEnd(bytesRead);
+      xTaskNotify(audioTaskHandle_, CfgAudioFrameBit, eSetBits);
+    }
+    i2s_stop(CfgAudioI2sMicId);
+    isCapturing_ = false;
+    // wake up encoder, so it does not wait for the next frame
+    xTaskNotify(audioTaskHandle_, CfgAudioFrameBit, eSetBits);
+  }
+  LOG_INFO("Audio capture task stopped");
+  vTaskDelete(NULL);
+}
+
+void AudioTask::audioPlaybackTask()
+{
+  LOG_INFO("Audio playback task started");
+  while (isRunning_) {
+    PacketView pcmFrame;
+    if (!playbackQueue_.readBegin(pcmFrame)) {
+      xTaskNotifyWait(0x00, ULONG_MAX, NULL, portMAX_DELAY);
+      continue;
+    }
+    // blocks while dma buffers are full, so it measures speaker backpressure
+    size_t bytesWritten;
+    uint32_t startUs = micros();
+    i2s_write(CfgAudioI2sSpkId, pcmFrame.data, pcmFrame.size, &bytesWritten, portMAX_DELAY);
+    playbackQueue_.readEnd();
+    playbackStats_.add(micros() - startUs);
+  }
+  LOG_INFO("Audio playback task stopped");
   vTaskDelete(NULL);
 }
 
+void AudioTask::audioTaskLogStage(const char *name, AudioStageStats &stats)
+{
+  LOG_INFO(name, "frames", stats.frames, "dropped", stats.dropped, 
+    "avg us", stats.getAvgUs(), "max us", stats.maxUs);
+  stats.reset();
+}
+
+void AudioTask::audioTaskLogAllocs(const char *name, uint32_t allocCount) const
+{
+  // all tasks are counted, audio path itself is expected to make none,
+  // codec libraries call malloc directly, their internal allocations are not seen here
+  LOG_INFO(name, "operator new calls", HeapArena::getAllocCount() - allocCount, "codec malloc not counted");
+}
+
+void AudioTask::audioTaskLogComplexity()
+{
+  if (!isComplexityAdaptive_) return;
+  const ComplexityStats &stats = complexityController_.getStats();
+  LOG_INFO("Encoder complexity", stats.complexity, "raised", stats.raised, "lowered", stats.lowered,
+    "overruns", stats.overruns, "max cycles", stats.maxCycles);
+  complexityController_.resetStats();
+}
+
+void AudioTask::audioTaskLogMicDsp()
+{
+  const MicDspStats &stats = micDsp_.getStats();
+  if (stats.frames == 0) return;
+  // worst case of every stage against the frame duration
+  uint32_t frameCycles = codecSamplesPerFrame_ * (getCpuFrequencyMhz() * 1000000 / codecSampleRate_);
+  uint32_t maxCycles = 0;
+  for (int stage = 0; stage < MicDsp::CfgStageCount; stage++) {
+    LOG_INFO("Mic dsp stage", stage, "avg cycles", (uint32_t)(stats.totalCycles[stage] / stats.frames), 
+      "max cycles", stats.maxCycles[stage]);
+    maxCycles += stats.maxCycles[stage];
+  }
+  if (maxCycles > frameCycles / 100 * CfgMicDspBudgetPercent) {
+    LOG_ERROR("Mic dsp is over budget, cycles", maxCycles, "frame cycles", frameCycles);
+  }
+  micDsp_.resetStats();
+}
+
+void AudioTask::audioTaskSetupFec(const RateProfile &profile)
+{
+  fecEncoder_.setup(fecDepth_, codecBytesPerFrame_, fecPacketSize_, fecEncoderBuffer_);
+  fecDecoder_.setup(fecDepth_, codecBytesPerFrame_, fecPacketSize_, fecDecoderBuffer_);
+  // missing packet is detected if next one does not arrive in time
+  AirTimeReport report;
+  AirTime::evaluate(*config_, profile.sf, profile.codecMode, report);
+  fecFlushTimeoutMs_ = 2 * report.packetAirTimeMs + CfgFecFlushDelayMs;
+  LOG_INFO("FEC enabled, depth", fecDepth_, "flush after", fecFlushTimeoutMs_, "ms");
+}
+
+void AudioTask::audioTaskSetupPlayout()
+{
+  int frameMs = rxCodec_->getPcmFrameSize() * 1000 / rxCodec_->getSampleRate();
+  jitterBuffer_.setup(frameMs, jitterStorage_);
+  isPlayoutStarted_ = false;
+  LOG_INFO("Playout frame", frameMs, "ms");
+}
+
+bool AudioTask::audioTaskSetupResampler()
+{
+  int slotSamples = captureQueue_.getSlotSize() / sizeof(int16_t);
+  if (codecSamplesPerFrame_ > slotSamples) {
+    LOG_ERROR("Codec frame does not fit pcm queue slot", codecSamplesPerFrame_);
+    return false;
+  }
+  // unsupported ratio or too long i2s frame, run i2s at the codec rate
+  i2sSampleRate_ = config_->AudioSampleRate_;
+  bool isValid = audioTaskI2sFrameSize() <= slotSamples
+    && captureResampler_.setup(i2sSampleRate_, codecSampleRate_)
+    && playbackResampler_.setup(codecSampleRate_, i2sSampleRate_);
+  if (!isValid) {
+    LOG_ERROR("Unsupported i2s sample rate", i2sSampleRate_);
+    i2sSampleRate_ = codecSampleRate_;
+    captureResampler_.setup(i2sSampleRate_, codecSampleRate_);
+    playbackResampler_.setup(codecSampleRate_, i2sSampleRate_);
+  }
+  LOG_INFO("Sample rate, i2s", i2sSampleRate_, "codec", codecSampleRate_);
+  return true;
+}
+
+void AudioTask::audioTaskSetupComplexity()
+{
+  // encoder starts cheap and takes spare cpu time while frames stay within the deadline
+  uint32_t frameCycles = codecSamplesPerFrame_ * (getCpuFrequencyMhz() * 1000000 / codecSampleRate_);
+  complexityController_.setup(frameCycles, ComplexityController::CfgMinComplexity);
+  isComplexityAdaptive_ = audioCodec_->setComplexity(complexityController_.getComplexity());
+}
+
+void AudioTask::audioTaskSetupVad()
+{
+  int frameMs = codecSamplesPerFrame_ * 1000 / codecSampleRate_;
+  vad_.setup(frameMs, config_->AudioVoxHangMs);
+  // speech onset is detected a few frames late, that much audio is held back
+  preRollFrames_ = min((int)CfgPreRollSlots - 1, (config_->AudioVoxPreRollMs_ + frameMs - 1) / frameMs);
+}
+
+TickType_t AudioTask::audioTaskWaitTicks() const
+{
+  uint32_t now = millis();
+  int waitMs = -1;
+  if (fecDecoder_.hasPending()) {
+    waitMs = max(0, (int)(int32_t)(fecFlushAtMs_ - now));
+  }
+  // vox resumes listening when nothing is played, captured frames wake up the task
+  if (isVoxEnabled_ && !isVoxListening_) {
+    waitMs = waitMs < 0 ? CfgCaptureWaitMs : min(waitMs, CfgCaptureWaitMs);
+  }
+  // idle decoders of other codecs are freed on time
+  int evictMs = decoderCache_.getEvictWaitMs(now);
+  if (evictMs >= 0) {
+    waitMs = waitMs < 0 ? evictMs : min(waitMs, evictMs);
+  }
+  // switch waits for the speaker and the mic to go idle
+  if (isReconfigPending_) {
+    waitMs = waitMs < 0 ? CfgSwitchPollMs : min(waitMs, CfgSwitchPollMs);
+  }
+  if (jitterBuffer_.isActive()) {
+    // wake up when next frame needs to be queued, poll while buffering
+    int frameMs = jitterBuffer_.getFrameMs();
+    int playoutMs = isPlayoutStarted_ 
+      ? max(0, (int)(int32_t)(playoutNextMs_ - now) - CfgPlayoutLeadFrames * frameMs)
+      : frameMs;
+    waitMs = waitMs < 0 ? playoutMs : min(waitMs, playoutMs);
+  }
+  return waitMs < 0 ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
+}
+
+void AudioTask::audioTaskSetProfile(const RateProfile &profile)
+{
+  // adaptive rate changes codec mode only between transmissions
+  if (profile.codecMode == codecMode_) return;
+  if (fecDecoder_.hasPending()) {
+    fecDecoder_.flush();
+    audioTaskPlayFec();
+  }
+  audioTaskPlayoutFlush();
+  if (!audioCodec_->setMode(profile.codecMode)) {
+    LOG_ERROR("Failed to set codec mode", profile.codecMode);
+    return;
+  }
+  codecMode_ = profile.codecMode;
+  codecSamplesPerFrame_ = audioCodec_->getPcmFrameSize();
+  codecBytesPerFrame_ = audioCodec_->getFrameSize();
+  codecBitsPerFrame_ = audioCodec_->getFrameBits();
+  if (isFecEnabled_) audioTaskSetupFec(profile);
+  rxCodecId_ = VoiceHeader::CfgCodecNone;
+  audioTaskSelectDecoder(VoiceHeader::getCodecId(config_->AudioCodec, codecMode_));
+  audioTaskSetupVad();
+  LOG_INFO("Codec mode", codecMode_);
+}
+
+bool AudioTask::audioTaskSelectDecoder(uint8_t codecId)
+{
+  if (codecId == rxCodecId_) return true;
+  std::shared_ptr<AudioCodec> codec = codecId == VoiceHeader::getCodecId(config_->AudioCodec, codecMode_)
+    ? audioCodec_ 
+    : decoderCache_.get(codecId, millis());
+  if (!codec) return false;
+  // speaker runs at i2s rate, other codec could decode at its own rate
+  if (!playbackResampler_.setup(codec->getSampleRate(), i2sSampleRate_)) {
+    LOG_ERROR("Unsupported decoder sample rate", codec->getSampleRate());
+    if (rxCodec_) playbackResampler_.setup(rxCodec_->getSampleRate(), i2sSampleRate_);
+    return false;
+  }
+  // frames of the previous stream are played out with its own decoder
+  if (fecDecoder_.hasPending()) {
+    fecDecoder_.flush();
+    audioTaskPlayFec();
+  }
+  audioTaskPlayoutFlush();
+  rxCodec_ = codec;
+  rxCodecId_ = codecId;
+  rxBytesPerFrame_ = codec->getFrameSize();
+  rxBitsPerFrame_ = codec->getFrameBits();
+  audioTaskSetupPlayout();
+  LOG_INFO("Decoder codec", codecId);
+  return true;
+}
+
 void AudioTask::audioTaskPlay()
 {
+  // new stream if previous one has ended, vox must not pick up the speaker
+  bool isNewStream = !isPlaying_;
+  if (isNewStream) rxTracker_.reset();
+  isVoxListening_ = false;
   playTimerReset();
+  // peer announces its rate profile, within a stream codec mode followed from the header is kept
+  if (radioTask_->isRateAdaptive() && isNewStream) audioTaskSetProfile(radioTask_->getRxProfile());
 
-  size_t bytesWritten;
   LOG_DEBUG("Playing audio");
-  double vol = (double)volume_ / (double)100.0;
-  LOG_DEBUG("Volume is", vol);
-
-  // run till ptt is not pressed and radio has data
-  while (!isPttOn_ && radioTask_->hasData()) {
-    byte packetSize;
-    if (!radioTask_->readPacketSize(packetSize)) {
-      LOG_ERROR("Failed to read packet size");
-      vTaskDelay(1);
-      continue;
-    }
+
+  // run till ptt is not pressed and radio has data, frames go to the playout buffer
+  PacketView packet;
+  while (!isPttOn_ && radioTask_->readPacketBegin(packet)) {
     pmService_->lightSleepReset();
-    LOG_DEBUG("Playing packet", packetSize);
-    // split by frame, decode and play
-    for (int i = 0; i < packetSize; i++) {
-      // read byte by byte from radio task
-      byte b;
-      if (!radioTask_->readNextByte(b)) {
-        LOG_ERROR("Failed to read next byte");
-        vTaskDelay(1);
-        continue;
+    LOG_DEBUG("Playing packet", packet.size);
+    const uint8_t *data = packet.data;
+    int dataSize = packet.size;
+    bool isEot = false;
+    // duplicates and undecodable packets are dropped before they reach the codec
+    if (isVoiceHdr_) {
+      if (audioTaskPlayHeader(data, dataSize, isEot)) {
+        data += packetHeaderSize_;
+        dataSize -= packetHeaderSize_;
+      } else {
+        dataSize = 0;
       }
-      // split only if codec has fixed frame size, othewise just process complete packet
-      int subFrameSize = audioCodec_->isFixedFrameSize() ? codecBytesPerFrame_ : packetSize;
-      encodedFrameBuffer_[i % subFrameSize] = b;
-      // one encoded audio frame is read, decode and play
-      if (i % subFrameSize == subFrameSize - 1) {
-        int pcmFrameSize = audioCodec_->decode(pcmFrameBuffer_, encodedFrameBuffer_, subFrameSize);
-        // adjust volume
-        for (int j = 0; j < pcmFrameSize; j++) {
-          pcmFrameBuffer_[j] *= vol;
+    } else if (dataSize > 0 && !audioTaskSelectDecoder(DecoderCache::detectCodec(*config_, codecMode_, data, dataSize))) {
+      dataSize = 0;
+    }
+    bool isBlockReady = false;
+    if (isFecEnabled_ && rxCodec_ == audioCodec_) {
+      // frames are played when fec block is completed
+      isBlockReady = dataSize > 0 && fecDecoder_.writePacket(data, dataSize);
+      fecFlushAtMs_ = millis() + fecFlushTimeoutMs_;
+    } else if (dataSize > 0) {
+      // split by frame if codec has fixed frame size, opus packet could be a superframe
+      if (rxCodec_->isFixedFrameSize()) {
+        // bit-packed frames are byte aligned again for the jitter buffer
+        for (int i = 0; (i + 1) * rxBitsPerFrame_ <= 8 * dataSize; i++) {
+          BitPacker::read(data, i * rxBitsPerFrame_, encodedFrameBuffer_, rxBitsPerFrame_);
+          jitterBuffer_.push(encodedFrameBuffer_, rxBytesPerFrame_);
         }
-        i2s_write(CfgAudioI2sSpkId, pcmFrameBuffer_, sizeof(uint16_t) * pcmFrameSize, &bytesWritten, portMAX_DELAY);
-        vTaskDelay(1);
+      } else {
+        audioTaskPlaySuperframe(data, dataSize);
       }
+      jitterBuffer_.onArrival(millis());
     }
+    radioTask_->readPacketEnd();
+    if (isBlockReady) audioTaskPlayFec();
+    if (isEot) audioTaskPlayEnd();
   } // while rx data available
 }
 
+bool AudioTask::audioTaskPlayHeader(const uint8_t *packet, int packetSize, bool &isEot)
+{
+  uint8_t codecId, seq;
+  if (!VoiceHeader::read(packet, packetSize, codecId, seq, isEot)) {
+    rxTracker_.onUndecodable();
+    return false;
+  }
+  long lostCount = rxTracker_.getStats().lost;
+  if (!rxTracker_.onPacket(seq)) {
+    isEot = false;
+    return false;
+  }
+  // rate controller sees fading losses which never arrive as crc errors
+  lostCount = rxTracker_.getStats().lost - lostCount;
+  radioTask_->packetsLost(lostCount);
+  // fec conceals by itself what it could not recover
+  if (!isFecEnabled_) audioTaskPlayLost(lostCount);
+  if (codecId == VoiceHeader::CfgCodecNone) {
+    // sender is in a speech pause, keep the stream and fill it with comfort noise
+    if (VoiceHeader::readSid(packet, packetSize, comfortNoiseLevel_)) jitterBuffer_.onSilence();
+    return false;
+  }
+  if (codecId == VoiceHeader::getCodecId(config_->AudioCodec, codecMode_)) return audioTaskSelectDecoder(codecId);
+  // sender could switch codec2 mode, own codec follows it, so fec and rate profiles keep working,
+  // opus decoder handles any bit rate by itself
+  if (config_->AudioCodec == CFG_AUDIO_CODEC_CODEC2 && AirTime::getCodec2FrameSize(codecId) > 0) {
+    RateProfile profile = { radioTask_->getRxProfile().sf, codecId };
+    audioTaskSetProfile(profile);
+    if (codecMode_ == codecId) return audioTaskSelectDecoder(codecId);
+  }
+  // other codec family gets a decoder of its own
+  if (audioTaskSelectDecoder(codecId)) return true;
+  rxTracker_.onUndecodable();
+  return false;
+}
+
+void AudioTask::audioTaskPlayLost(long lostCount)
+{
+  if (lostCount <= 0) return;
+  // gap is filled with concealed frames, so playback keeps its timing
+  int framesPerPacket = rxCodec_->isFixedFrameSize() 
+    ? (8 * config_->AudioMaxPktSize / rxBitsPerFrame_) 
+    : (isOpusSuperframe_ ? opusSuperframe_.getMaxFrames() : 1);
+  int maxFrames = max(1, CfgMaxLostConcealMs / jitterBuffer_.getFrameMs());
+  jitterBuffer_.pushLost((int)min(lostCount * framesPerPacket, (long)maxFrames));
+}
+
+void AudioTask::audioTaskPlayEnd()
+{
+  // talker released ptt, play what is left and stop without waiting for timeout
+  if (fecDecoder_.hasPending()) {
+    fecDecoder_.flush();
+    audioTaskPlayFec();
+  }
+  jitterBuffer_.onEndOfStream();
+}
+
+void AudioTask::audioTaskPlayout()
+{
+  int frameMs = jitterBuffer_.getFrameMs();
+  while (!isPttOn_ && jitterBuffer_.isActive()) {
+    uint32_t now = millis();
+    if (isPlayoutStarted_) {
+      // speaker ran dry, i2s inserted silence, continue from now
+      if ((int32_t)(now - playoutNextMs_) > 0) playoutNextMs_ = now;
+      // enough frames are queued to i2s
+      if ((int32_t)(playoutNextMs_ - now) > CfgPlayoutLeadFrames * frameMs) return;
+    }
+    const uint8_t *frame;
+    int frameSize;
+    JitterBuffer::Frame result = jitterBuffer_.pop(now, frame, frameSize);
+    if (result == JitterBuffer::Frame::None) {
+      // next talk spurt could be buffering, poll instead of waiting for the playout deadline
+      if (!jitterBuffer_.isActive() && isPlayoutStarted_) audioTaskPlayoutEnd();
+      isPlayoutStarted_ = false;
+      return;
+    }
+    if (!isPlayoutStarted_) {
+      isPlayoutStarted_ = true;
+      playoutNextMs_ = now;
+    }
+    if (result == JitterBuffer::Frame::Audio) {
+      audioTaskPlayFrame(frame, frameSize);
+    } else if (result == JitterBuffer::Frame::Silence) {
+      audioTaskPlayComfortNoise();
+    } else {
+      audioTaskPlayConceal();
+    }
+    playoutNextMs_ += frameMs;
+  }
+}
+
+void AudioTask::audioTaskPlayoutEnd()
+{
+  const JitterBufferStats &playoutStats = jitterBuffer_.getStats();
+  LOG_INFO("Playout ended, underruns", playoutStats.underruns, "overruns", playoutStats.overruns, 
+    "concealed", playoutStats.concealed, "jitter", playoutStats.jitterMs, "delay", playoutStats.targetDelayMs);
+  if (isVoiceHdr_) {
+    const VoiceStreamStats &stats = rxTracker_.getStats();
+    LOG_INFO("Voice stream ended, received", stats.received, "lost", stats.lost, 
+      "duplicated", stats.duplicated, "undecodable", stats.undecodable);
+    audioTaskUpdateLoss(stats);
+    rxTracker_.reset();
+  }
+  audioTaskLogStage("Decode", decodeStats_);
+  audioTaskLogStage("Playback", playbackStats_);
+  audioTaskLogAllocs("Playout", playoutAllocCount_);
+  playoutAllocCount_ = HeapArena::getAllocCount();
+  playbackGain_.reset();
+  playbackResampler_.reset();
+  jitterBuffer_.reset();
+  isPlayoutStarted_ = false;
+  // next stream starts with the own codec, other decoders become idle
+  audioTaskSelectDecoder(VoiceHeader::getCodecId(config_->AudioCodec, codecMode_));
+  playTimerStop();
+}
+
+void AudioTask::audioTaskUpdateLoss(const VoiceStreamStats &stats)
+{
+  // link is assumed to be symmetric, loss heard from peers is expected for own transmission
+  long total = stats.received + stats.lost;
+  if (total == 0) return;
+  int lossPercent = (int)(100 * stats.lost / total);
+  linkLossPercent_ += (lossPercent - linkLossPercent_) >> CfgLossGainShift;
+  LOG_INFO("Link loss", lossPercent, "smoothed", linkLossPercent_);
+}
+
+void AudioTask::audioTaskPlayoutFlush()
+{
+  // buffered frames belong to the previous codec mode, play them right away
+  if (!jitterBuffer_.isActive()) return;
+  jitterBuffer_.onEndOfStream();
+  const uint8_t *frame;
+  int frameSize;
+  JitterBuffer::Frame result;
+  while ((result = jitterBuffer_.pop(millis(), frame, frameSize)) != JitterBuffer::Frame::None) {
+    if (result == JitterBuffer::Frame::Audio) {
+      audioTaskPlayFrame(frame, frameSize);
+    } else if (result == JitterBuffer::Frame::Silence) {
+      audioTaskPlayComfortNoise();
+    } else {
+      audioTaskPlayConceal();
+    }
+  }
+  jitterBuffer_.reset();
+  isPlayoutStarted_ = false;
+}
+
+void AudioTask::audioTaskPlayFrame(const uint8_t *encodedFrame, int encodedFrameSize)
+{
+  uint32_t startUs = micros();
+  int pcmFrameSize = rxCodec_->decode(pcmFrameBuffer_, encodedFrame, encodedFrameSize);
+  decodeStats_.add(micros() - startUs);
+  audioTaskPlayPcm(pcmFrameSize);
+}
+
+void AudioTask::audioTaskPlaySuperframe(const uint8_t *packet, int packetSize)
+{
+  // single frame packets go as is, combined ones are split back into frames
+  int frameCount = opusSuperframe_.readBegin(packet, packetSize);
+  if (frameCount <= 1) {
+    jitterBuffer_.push(packet, packetSize);
+    return;
+  }
+  for (int i = 0; i < frameCount; i++) {
+    int frameSize = opusSuperframe_.readFrame(i, encodedFrameBuffer_, encodedFrameBufferSize_);
+    if (frameSize > 0) jitterBuffer_.push(encodedFrameBuffer_, frameSize);
+    else jitterBuffer_.pushErased();
+  }
+}
+
+void AudioTask::audioTaskPlayConceal()
+{
+  uint32_t startUs = micros();
+  // next buffered frame could carry redundant copy of the missing one
+  const uint8_t *nextFrame;
+  int nextFrameSize;
+  int pcmFrameSize = jitterBuffer_.peek(nextFrame, nextFrameSize)
+    ? rxCodec_->recover(pcmFrameBuffer_, nextFrame, nextFrameSize)
+    : rxCodec_->conceal(pcmFrameBuffer_);
+  decodeStats_.add(micros() - startUs);
+  audioTaskPlayPcm(pcmFrameSize);
+}
+
+void AudioTask::audioTaskPlayComfortNoise()
+{
+  // uniform noise with the mean absolute level reported by the sender
+  int amplitude = 2 * comfortNoiseLevel_;
+  int pcmFrameSize = rxCodec_->getPcmFrameSize();
+  for (int i = 0; i < pcmFrameSize; i++) {
+    comfortNoiseSeed_ = comfortNoiseSeed_ * 1664525 + 1013904223;
+    pcmFrameBuffer_[i] = (int16_t)((((int32_t)(comfortNoiseSeed_ >> 16) - 32768) * amplitude) >> 15);
+  }
+  audioTaskPlayPcm(pcmFrameSize);
+}
+
+void AudioTask::audioTaskPlayPcm(int pcmFrameSize)
+{
+  if (pcmFrameSize <= 0) return;
+  // playout keeps the queue short, only flush could run ahead of the speaker
+  uint8_t *slot = playbackQueue_.writeBegin();
+  for (int i = 0; slot == nullptr && i < jitterBuffer_.getFrameMs(); i++) {
+    vTaskDelay(pdMS_TO_TICKS(1));
+    slot = playbackQueue_.writeBegin();
+  }
+  if (slot == nullptr) {
+    playbackStats_.dropped++;
+    return;
+  }
+  // speaker runs at i2s rate, limiter follows resampler, so its overshoot does not clip
+  int slotSamples = CfgPcmSlotSize / sizeof(int16_t);
+  const int16_t *pcm = pcmFrameBuffer_;
+  if (playbackResampler_.isActive()) {
+    pcmFrameSize = playbackResampler_.process(pcmFrameBuffer_, pcmFrameSize, playbackFrameBuffer_, slotSamples);
+    pcm = playbackFrameBuffer_;
+  }
+  // adjust volume while moving to the queue slot
+  pcmFrameSize = min(pcmFrameSize, slotSamples);
+  playbackGain_.setVolume(volume_);
+  playbackGain_.process(pcm, (int16_t*)slot, pcmFrameSize);
+  playbackQueue_.writeEnd(sizeof(int16_t) * pcmFrameSize);
+  xTaskNotify(playbackTaskHandle_, 0, eNoAction);
+}
+
+void AudioTask::audioTaskPlayFec()
+{
+  const uint8_t *frame;
+  bool isErased;
+  bool hasFrames = false;
+  while (fecDecoder_.readFrame(frame, isErased)) {
+    // erased frames are concealed by the codec on playout
+    if (isErased) {
+      jitterBuffer_.pushErased();
+    } else {
+      jitterBuffer_.push(frame, codecBytesPerFrame_);
+    }
+    hasFrames = true;
+  }
+  if (hasFrames) jitterBuffer_.onArrival(millis());
+}
+
+void AudioTask::audioTaskCaptureStart()
+{
+  // drop frames left from the previous transmission and start capture
+  captureQueue_.clear();
+  preRollQueue_.clear();
+  captureSamples_ = audioTaskI2sFrameSize();
+  captureResampler_.reset();
+  micDsp_.reset();
+  vad_.reset();
+  xTaskNotify(captureTaskHandle_, 0, eNoAction);
+}
+
+int16_t *AudioTask::audioTaskCaptureFrame(const PacketView &pcmFrame, int &sampleCount)
+{
+  sampleCount = pcmFrame.size / sizeof(int16_t);
+  if (!captureResampler_.isActive()) return (int16_t*)pcmFrame.data;
+  sampleCount = captureResampler_.process((const int16_t*)pcmFrame.data, sampleCount, 
+    captureFrameBuffer_, CfgPcmSlotSize / sizeof(int16_t));
+  return captureFrameBuffer_;
+}
+
+void AudioTask::audioTaskVox()
+{
+  // listen only while nothing is received, so the speaker does not key the transmitter
+  // pending codec switch needs the capture to be stopped
+  if (!isVoxEnabled_ || isReconfigPending_ || isPttOn_ || isPlaying_ || jitterBuffer_.isActive()) {
+    isVoxListening_ = false;
+    return;
+  }
+  if (!isVoxListening_) {
+    LOG_DEBUG("VOX listening");
+    audioTaskSetProfile(radioTask_->getTxProfile());
+    isVoxListening_ = true;
+    audioTaskCaptureStart();
+  }
+  // capture runs all the time, device must not go to sleep
+  pmService_->lightSleepReset();
+  PacketView pcmFrame;
+  while (captureQueue_.readBegin(pcmFrame)) {
+    int sampleCount;
+    int16_t *pcm = audioTaskCaptureFrame(pcmFrame, sampleCount);
+    micDsp_.process(pcm, sampleCount);
+    bool isVoice = vad_.process(pcm, sampleCount);
+    // last frames are kept, they are sent in front of the detected speech
+    preRollQueue_.push((uint8_t*)pcm, sizeof(int16_t) * sampleCount);
+    captureQueue_.readEnd();
+    if (isVoice) {
+      LOG_INFO("VOX start");
+      voiceFrames_ = preRollFrames_ + 1;
+      isVoxKeyed_ = true;
+      radioTask_->startTransmit();
+      audioTaskRecord();
+      return;
+    }
+    if (preRollQueue_.size() > preRollFrames_ && preRollQueue_.readBegin(pcmFrame)) {
+      preRollQueue_.readEnd();
+    }
+  }
+}
+
 void AudioTask::audioTaskRecord()
 {      
-  size_t bytesRead;
   LOG_DEBUG("Recording audio");
-  int packetSize = 0;
-  i2s_start(CfgAudioI2sMicId);
-  // record while ptt button is pressed
-  while (isPttOn_) {
-    // send packet if enough audio encoded frames are aggregated for fixed frame codec
-    // .. or send immediately for variable size frame codec
-    if ((!audioCodec_->isFixedFrameSize() && packetSize > 0) || 
-         (audioCodec_->isFixedFrameSize() && packetSize + codecBytesPerFrame_ > config_->AudioMaxPktSize)) {
-      LOG_DEBUG("Recorded packet", packetSize);
-      if (!radioTask_->writePacketSize(packetSize)) {
-        LOG_ERROR("Failed to write packet size");
-        vTaskDelay(1);
-        continue;
-      }
-      radioTask_->transmit();
-      pmService_->lightSleepReset();
-      packetSize = 0;
+  uint32_t allocCount = HeapArena::getAllocCount();
+  // own transmission interrupts playback
+  if (jitterBuffer_.isActive()) {
+    jitterBuffer_.reset();
+    isPlayoutStarted_ = false;
+  }
+  // vox has started capture already and holds the speech onset
+  if (!isVoxKeyed_) {
+    audioTaskSetProfile(radioTask_->getTxProfile());
+    audioTaskCaptureStart();
+  }
+  audioCodec_->setPacketLoss(linkLossPercent_);
+  isVoxListening_ = false;
+  txPacket_ = nullptr;
+  txPacketSize_ = 0;
+  isTalkSpurt_ = true;
+  // speech is detected only if dtx or vox needs it, frames are delayed to keep its onset
+  bool isVadEnabled = isDtxEnabled_ || isVoxEnabled_;
+  int delayFrames = isVadEnabled ? preRollFrames_ : 0;
+  if (!isVoxKeyed_) voiceFrames_ = delayFrames + 1;
+  while (preRollQueue_.size() > delayFrames) {
+    audioTaskRecordDelayed(true);
+  }
+  // record while ptt button is pressed or vox hears speech, frames captured before release are encoded too
+  PacketView pcmFrame;
+  while (isPttOn_ || isVoxKeyed_ || !captureQueue_.isEmpty()) {
+    if (!captureQueue_.readBegin(pcmFrame)) {
+      xTaskNotifyWait(0x00, CfgAudioFrameBit, NULL, pdMS_TO_TICKS(CfgCaptureWaitMs));
+      continue;
     }
-    // read and encode one sample
-    if (!isPttOn_) break;
-    size_t bytesRead;
-    i2s_read(CfgAudioI2sMicId, pcmFrameBuffer_, sizeof(uint16_t) * codecSamplesPerFrame_, &bytesRead, portMAX_DELAY);
-    if (!isPttOn_) break;
-    int encodedFrameSize = audioCodec_->encode(encodedFrameBuffer_, pcmFrameBuffer_);
-    if (!isPttOn_) break;
-    // transfer data to the radio packet queue
-    for (int i = 0; i < encodedFrameSize; i++) {
-      radioTask_->writeNextByte(encodedFrameBuffer_[i]);
+    int sampleCount;
+    int16_t *pcm = audioTaskCaptureFrame(pcmFrame, sampleCount);
+    micDsp_.process(pcm, sampleCount);
+    bool isVoice = !isVadEnabled || vad_.process(pcm, sampleCount);
+    voiceFrames_ = isVoice ? delayFrames + 1 : max(0, voiceFrames_ - 1);
+    // vox transmission ends when delayed frames have no speech left
+    if (isVoxKeyed_ && !isPttOn_ && voiceFrames_ == 0) {
+      LOG_INFO("VOX end");
+      captureQueue_.readEnd();
+      while (preRollQueue_.readBegin(pcmFrame)) preRollQueue_.readEnd();
+      isVoxKeyed_ = false;
+      break;
+    }
+    if (delayFrames == 0) {
+      audioTaskRecordFrame(pcm, voiceFrames_ > 0 || !isDtxEnabled_);
+      captureQueue_.readEnd();
+      continue;
     }
-    packetSize += encodedFrameSize;
-    vTaskDelay(1);
+    preRollQueue_.push((uint8_t*)pcm, sizeof(int16_t) * sampleCount);
+    captureQueue_.readEnd();
+    audioTaskRecordDelayed(voiceFrames_ > 0 || !isDtxEnabled_);
   } // while ptt pressed
-  // send remaining tail audio encoded samples
-  if (packetSize > 0) {
-      LOG_DEBUG("Recorded packet tail", packetSize);
-      if (radioTask_->writePacketSize(packetSize)) {
-        radioTask_->transmit();
-        pmService_->lightSleepReset();
-      } else {
-        LOG_ERROR("Failed to write byte");
-      }
-      packetSize = 0;
+  // frames held back at release, the ones within speech hang are still sent
+  while (!preRollQueue_.isEmpty()) {
+    voiceFrames_ = max(0, voiceFrames_ - 1);
+    audioTaskRecordDelayed(voiceFrames_ > 0 || !isDtxEnabled_);
   }
-  vTaskDelay(1);
-  i2s_stop(CfgAudioI2sMicId);
+  audioTaskRecordFlush(true);
   radioTask_->startReceive();
+  audioTaskLogStage("Capture", captureStats_);
+  audioTaskLogStage("Encode", encodeStats_);
+  audioTaskLogAllocs("Record", allocCount);
+  audioTaskLogMicDsp();
+  audioTaskLogComplexity();
+}
+
+void AudioTask::audioTaskRecordDelayed(bool isVoice)
+{
+  PacketView pcmFrame;
+  if (!preRollQueue_.readBegin(pcmFrame)) return;
+  audioTaskRecordFrame((int16_t*)pcmFrame.data, isVoice);
+  preRollQueue_.readEnd();
+}
+
+void AudioTask::audioTaskRecordFrame(int16_t *pcmFrame, bool isVoice)
+{
+  if (!isVoice) {
+    audioTaskRecordPause();
+    return;
+  }
+  uint32_t startUs = micros();
+  uint32_t startCycles = ESP.getCycleCount();
+  int encodedFrameSize = audioCodec_->encode(encodedFrameBuffer_, pcmFrame);
+  uint32_t cycles = ESP.getCycleCount() - startCycles;
+  encodeStats_.add(micros() - startUs);
+  if (isComplexityAdaptive_ && complexityController_.update(cycles)) {
+    audioCodec_->setComplexity(complexityController_.getComplexity());
+  }
+  // codec dtx found no speech in the frame, same as a pause detected by vad
+  if (encodedFrameSize == 0 && isDtxEnabled_) {
+    audioTaskRecordPause();
+    return;
+  }
+  if (encodedFrameSize <= 0) return;
+  isTalkSpurt_ = true;
+  // fec interleaves frames over multiple packets, sent when block is full
+  if (isFecEnabled_) {
+    if (fecEncoder_.writeFrame(encodedFrameBuffer_)) audioTaskRecordFec(false);
+    return;
+  }
+  // opus superframe is sent when the next frame would not fit or it holds maximum duration
+  if (isOpusSuperframe_) {
+    if (!opusSuperframe_.canAppend(encodedFrameBuffer_, encodedFrameSize) && audioTaskRecordSuperframe()) {
+      audioTaskRecordSend();
+    }
+    if (!opusSuperframe_.append(encodedFrameBuffer_, encodedFrameSize)) {
+      LOG_ERROR("Failed to combine opus frame", encodedFrameSize);
+      return;
+    }
+    if (opusSuperframe_.isFull() && audioTaskRecordSuperframe()) audioTaskRecordSend();
+    return;
+  }
+  // transfer data to the radio packet queue slot
+  if (!audioTaskRecordBegin() || txPacketSize_ + encodedFrameSize > RadioTask::getMaxPacketSize()) {
+    LOG_ERROR("Failed to write frame, radio queue is full");
+    return;
+  }
+  // send immediately for variable size frame codec
+  if (!audioCodec_->isFixedFrameSize()) {
+    memcpy(txPacket_ + txPacketSize_, encodedFrameBuffer_, encodedFrameSize);
+    txPacketSize_ += encodedFrameSize;
+    audioTaskRecordSend();
+    return;
+  }
+  // send packet if enough audio encoded frames are aggregated for fixed frame codec
+  audioTaskRecordPackFrame();
+  if (BitPacker::getSize((audioTaskRecordFrameCount() + 1) * codecBitsPerFrame_) > config_->AudioMaxPktSize) {
+    audioTaskRecordSend();
+  }
+}
+
+void AudioTask::audioTaskRecordPackFrame()
+{
+  // frames are appended at bit position, so codec2 frames need no padding
+  int frameCount = audioTaskRecordFrameCount();
+  BitPacker::write(txPacket_ + packetHeaderSize_, frameCount * codecBitsPerFrame_, 
+    encodedFrameBuffer_, codecBitsPerFrame_);
+  txPacketSize_ = packetHeaderSize_ + BitPacker::getSize((frameCount + 1) * codecBitsPerFrame_);
+}
+
+bool AudioTask::audioTaskRecordBegin()
+{
+  if (txPacket_ == nullptr) {
+    txPacket_ = radioTask_->writePacketBegin();
+    if (txPacket_ != nullptr && isVoiceHdr_) {
+      VoiceHeader::write(txPacket_, VoiceHeader::getCodecId(config_->AudioCodec, codecMode_), txSeq_, false);
+      txPacketSize_ = packetHeaderSize_;
+    }
+  }
+  return txPacket_ != nullptr;
+}
+
+bool AudioTask::audioTaskRecordSuperframe()
+{
+  if (!opusSuperframe_.hasFrames()) return false;
+  if (!audioTaskRecordBegin()) {
+    LOG_ERROR("Failed to write superframe, radio queue is full");
+    opusSuperframe_.reset();
+    return false;
+  }
+  int packetSize = opusSuperframe_.write(txPacket_ + txPacketSize_, RadioTask::getMaxPacketSize() - txPacketSize_);
+  if (packetSize == 0) {
+    LOG_ERROR("Failed to write superframe");
+    return false;
+  }
+  txPacketSize_ += packetSize;
+  return true;
+}
+
+void AudioTask::audioTaskRecordPause()
+{
+  // talk spurt is over, send what is encoded, then only silence descriptors
+  if (isTalkSpurt_) {
+    LOG_DEBUG("Speech pause");
+    audioTaskRecordFlush(false);
+    isTalkSpurt_ = false;
+    lastSidMs_ = millis() - CfgSidIntervalMs;
+  }
+  if (isVoiceHdr_ && (int32_t)(millis() - lastSidMs_) >= CfgSidIntervalMs) {
+    audioTaskRecordSid();
+    lastSidMs_ = millis();
+  }
+}
+
+void AudioTask::audioTaskRecordSend()
+{
+  LOG_DEBUG("Recorded packet", txPacketSize_);
+  radioTask_->writePacketEnd(txPacketSize_);
+  txSeq_++;
+  radioTask_->transmit();
+  pmService_->lightSleepReset();
+  txPacket_ = nullptr;
+  txPacketSize_ = 0;
+}
+
+void AudioTask::audioTaskRecordFlush(bool isEot)
+{
+  // combined opus frames go into the last packet, so it could carry end of transmission
+  if (isOpusSuperframe_) {
+    audioTaskRecordSuperframe();
+  }
+  if (isFixedPacketSize_) {
+    audioTaskRecordPad();
+  }
+  // send remaining tail audio encoded samples, last packet marks end of transmission
+  bool isEotSent = false;
+  if (txPacketSize_ > packetHeaderSize_) {
+    if (isEot && isVoiceHdr_) VoiceHeader::setEot(txPacket_);
+    audioTaskRecordSend();
+    isEotSent = true;
+  }
+  if (isFecEnabled_ && fecEncoder_.hasFrames()) {
+    LOG_DEBUG("Recorded fec block tail");
+    audioTaskRecordFec(isEot);
+    isEotSent = true;
+  }
+  if (isEot && isVoiceHdr_ && !isEotSent) {
+    audioTaskRecordEot();
+  }
+}
+
+void AudioTask::audioTaskRecordPad()
+{
+  if (txPacketSize_ <= packetHeaderSize_ && !(isFecEnabled_ && fecEncoder_.hasFrames())) return;
+  // fill the tail up to the complete superframe with encoded silence
+  memset(pcmFrameBuffer_, 0, sizeof(int16_t) * codecSamplesPerFrame_);
+  int encodedFrameSize = audioCodec_->encode(encodedFrameBuffer_, pcmFrameBuffer_);
+  if (encodedFrameSize != codecBytesPerFrame_) return;
+  if (isFecEnabled_) {
+    // full block is sent as the tail
+    while (!fecEncoder_.writeFrame(encodedFrameBuffer_));
+  } else {
+    while (BitPacker::getSize((audioTaskRecordFrameCount() + 1) * codecBitsPerFrame_) <= config_->AudioMaxPktSize) {
+      audioTaskRecordPackFrame();
+    }
+  }
+}
+
+void AudioTask::audioTaskRecordEot()
+{
+  // no audio left for the last packet, send header only
+  byte *packet = txPacket_ != nullptr ? txPacket_ : radioTask_->writePacketBegin();
+  txPacket_ = nullptr;
+  txPacketSize_ = 0;
+  if (packet == nullptr) {
+    LOG_ERROR("Failed to write end of transmission, radio queue is full");
+    return;
+  }
+  VoiceHeader::write(packet, VoiceHeader::CfgCodecNone, txSeq_++, true);
+  radioTask_->writePacketEnd(packetHeaderSize_);
+  radioTask_->transmit();
+}
+
+void AudioTask::audioTaskRecordSid()
+{
+  // keeps receiver stream alive in the pause, tells it the comfort noise level
+  byte *packet = txPacket_ != nullptr ? txPacket_ : radioTask_->writePacketBegin();
+  txPacket_ = nullptr;
+  txPacketSize_ = 0;
+  if (packet == nullptr) {
+    LOG_ERROR("Failed to write silence descriptor, radio queue is full");
+    return;
+  }
+  VoiceHeader::writeSid(packet, txSeq_++, vad_.getNoiseLevel());
+  radioTask_->writePacketEnd(VoiceHeader::CfgSidSize);
+  radioTask_->transmit();
+}
+
+void AudioTask::audioTaskRecordFec(bool isEot)
+{
+  int packetCount = fecEncoder_.getPacketCount();
+  uint8_t codecId = VoiceHeader::getCodecId(config_->AudioCodec, codecMode_);
+  for (int i = 0; i < packetCount; i++) {
+    byte *packet = radioTask_->writePacketBegin();
+    if (packet == nullptr) {
+      LOG_ERROR("Failed to write fec packet, radio queue is full");
+      break;
+    }
+    if (isVoiceHdr_) {
+      VoiceHeader::write(packet, codecId, txSeq_++, isEot && i == packetCount - 1);
+    }
+    radioTask_->writePacketEnd(packetHeaderSize_ + fecEncoder_.readPacket(i, packet + packetHeaderSize_));
+  }
+  fecEncoder_.nextBlock();
+  radioTask_->transmit();
+  pmService_->lightSleepReset();
 }
 
 } // LoraDv
\ No newline at end of file
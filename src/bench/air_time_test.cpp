@@ -0,0 +1,94 @@
+// Time on air checks against the Semtech LoRa calculator (SX1276 formula of AN1200.13)
+// and the fsk packet length of RadioLib defaults. Low data rate optimization is expected
+// for symbols of 16 ms and longer, as the calculator and RadioLib enable it.
+
+#include <stdio.h>
+#include <math.h>
+
+#include "bench.h"
+#include "air_time.h"
+#include "loradv_config.h"
+
+namespace LoraDv {
+
+static const float CfgToleranceMs = 0.01f;
+
+struct LoraAirTimeCase {
+  int payloadSize;
+  int sf;
+  long bw;
+  int cr;                   // 5..8 for 4/5..4/8
+  int preambleLen;
+  bool isImplicitHeader;
+  bool isCrcOn;
+  bool isLdro;              // low data rate optimization expected
+  float timeOnAirMs;        // calculator value
+};
+
+struct FskAirTimeCase {
+  int payloadSize;
+  float bitRateKbps;
+  float timeOnAirMs;
+};
+
+static const LoraAirTimeCase LoraCases[] = {
+  {  10,  7, 125000, 5,  8, false, true,  false,   41.216f },
+  {  51,  7, 125000, 5,  8, false, true,  false,  102.656f },
+  {  10, 11, 125000, 5,  8, false, true,  true,   577.536f },
+  {  10, 12, 125000, 5,  8, false, true,  true,   991.232f },
+  {  48,  7,  31250, 5,  8, false, true,  false,  390.144f },
+  {  48,  9,  31250, 5,  8, false, true,  true,  1478.656f },
+  {  20, 10,  62500, 8,  8, false, false, true,   987.136f },
+  {  42,  6, 125000, 5,  8, true,  true,  false,   46.208f },
+  {   3,  7, 125000, 5,  6, true,  false, false,   23.808f },
+  {   8, 12, 500000, 6, 12, false, true,  false,  296.960f },
+  { 255,  8, 250000, 5,  8, false, true,  false,  353.536f },
+};
+
+static const FskAirTimeCase FskCases[] = {
+  {  48,  4.8f,  91.667f },
+  {   8,  1.2f, 100.000f },
+  { 255, 50.0f,  41.920f },
+};
+
+bool runAirTimeTest()
+{
+  bool isValid = true;
+  for (const LoraAirTimeCase &test : LoraCases) {
+    float timeOnAirMs = AirTime::getLoraTimeOnAirMs(test.payloadSize, test.sf, test.bw, test.cr,
+      test.preambleLen, test.isImplicitHeader, test.isCrcOn);
+    bool isLdro = AirTime::isLoraLowDataRateOptimize(test.sf, test.bw);
+    bool isMatching = fabsf(timeOnAirMs - test.timeOnAirMs) < CfgToleranceMs && isLdro == test.isLdro;
+    printf("{\"stage\":\"airtime\",\"modulation\":\"lora\",\"payload\":%d,\"sf\":%d,\"bw\":%ld,\"cr\":%d,"
+      "\"preamble\":%d,\"implicit\":%d,\"crc\":%d,\"ldro\":%d,\"ms\":%.3f,\"expected_ms\":%.3f,\"check\":\"%s\"}\n",
+      test.payloadSize, test.sf, test.bw, test.cr, test.preambleLen, test.isImplicitHeader, test.isCrcOn,
+      isLdro, timeOnAirMs, test.timeOnAirMs, isMatching ? "ok" : "mismatch");
+    isValid = isValid && isMatching;
+  }
+  for (const FskAirTimeCase &test : FskCases) {
+    float timeOnAirMs = AirTime::getFskTimeOnAirMs(test.payloadSize, test.bitRateKbps);
+    bool isMatching = fabsf(timeOnAirMs - test.timeOnAirMs) < CfgToleranceMs;
+    printf("{\"stage\":\"airtime\",\"modulation\":\"fsk\",\"payload\":%d,\"kbps\":%.1f,\"ms\":%.3f,"
+      "\"expected_ms\":%.3f,\"check\":\"%s\"}\n",
+      test.payloadSize, test.bitRateKbps, timeOnAirMs, test.timeOnAirMs, isMatching ? "ok" : "mismatch");
+    isValid = isValid && isMatching;
+  }
+
+  // report of the default configuration follows the formula for its superframe packet
+  Config config;
+  AirTimeReport report;
+  AirTime::evaluate(config, report);
+  float packetMs = AirTime::getLoraTimeOnAirMs(report.payloadSize, config.LoraSf, config.LoraBw,
+    config.LoraCodingRate, config.LoraPreambleLen_, AirTime::isLoraImplicitHeader(config), config.LoraCrc_ != 0);
+  bool isMatching = fabsf(report.packetAirTimeMs - packetMs) < CfgToleranceMs
+    && fabsf(report.dutyCycle - report.packetAirTimeMs / report.packetAudioMs) < 0.001f
+    && report.isRealTime == (report.dutyCycle < 0.9f);
+  printf("{\"stage\":\"airtime\",\"config\":\"default\",\"payload\":%d,\"frames\":%d,\"packet_ms\":%.3f,"
+    "\"duty_cycle\":%.3f,\"latency_ms\":%.1f,\"real_time\":%d,\"check\":\"%s\"}\n",
+    report.payloadSize, report.framesPerPacket, report.packetAirTimeMs, report.dutyCycle, report.latencyMs,
+    report.isRealTime, isMatching ? "ok" : "mismatch");
+  fflush(stdout);
+  return isValid && isMatching;
+}
+
+} // LoraDv
@@ -0,0 +1,48 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace LoraDv {
+
+// Host checks and benchmarks of firmware components, built with the codec
+// benchmark by the native_bench environment. Every run prints one json
+// object per case and returns false if a check has failed.
+
+// cpu time stamp counter on x86, nanoseconds on other hosts
+inline uint64_t benchCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline double benchNs(std::chrono::steady_clock::time_point startTime)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool runQueueBench();
+bool runAirTimeTest();
+bool runFecTest();
+bool runPipelineBench();
+bool runRateTest();
+bool runCipherBench();
+bool runJitterTest();
+bool runGainBench();
+bool runMicDspTest();
+bool runNoiseBench();
+bool runVadTest();
+bool runResamplerCycleBench();
+bool runDetectTest();
+
+} // LoraDv
+
+#endif // BENCH_H
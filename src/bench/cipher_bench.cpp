@@ -0,0 +1,98 @@
+// Radio privacy cipher benchmark. Transmit cost with keystream precomputed while the radio
+// is idle against keystream generated at transmit time, precompute and receive cost.
+// Every packet is decrypted and compared, tampered payload and header must fail authentication.
+// Keystream is precomputed for the default packet with voice header as on the device, larger
+// payload takes the inline path on encrypt and must still round trip.
+//  - bytes_per_cycle, cycles_per_byte: payload bytes per cpu cycle of one call
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "radio_cipher.h"
+
+namespace LoraDv {
+
+static const int CfgCipherPackets = 20000;
+static const int CfgCipherHeaderSize = 1;         // adaptive rate descriptor
+static const int CfgCipherStreamSize = 50;        // default packet and voice header
+static const int CipherPayloadSizes[] = { 48, 200 };
+
+static void printCipherResult(const char *stage, int payloadSize, uint64_t cycles)
+{
+  double bytes = (double)payloadSize * CfgCipherPackets;
+  printf("{\"stage\":\"cipher\",\"path\":\"%s\",\"payload_bytes\":%d,\"bytes_per_cycle\":%.4f,"
+    "\"cycles_per_byte\":%.2f}\n", stage, payloadSize, bytes / cycles, cycles / bytes);
+}
+
+static bool runCipherSize(int payloadSize)
+{
+  static const uint8_t key[32] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32
+  };
+  RadioCipher tx, txInline, rx;
+  tx.setKey(key, sizeof(key));
+  txInline.setKey(key, sizeof(key));
+  rx.setKey(key, sizeof(key));
+  tx.setSalt(0x5A17u);
+  tx.setStreamSize(CfgCipherStreamSize);
+  txInline.setSalt(0x5A18u);
+
+  uint8_t payload[RadioCipher::CfgMaxPayload];
+  uint8_t packet[CfgCipherHeaderSize + RadioCipher::CfgOverhead + RadioCipher::CfgMaxPayload];
+  uint64_t precomputeCycles = 0, encryptCycles = 0, inlineCycles = 0, decryptCycles = 0;
+  bool isValid = true;
+  for (int p = 0; p < CfgCipherPackets; p++) {
+    for (int i = 0; i < payloadSize; i++) payload[i] = (uint8_t)(p + i);
+    packet[0] = (uint8_t)p;
+
+    // second transmitter never precomputes, as when sending faster than idle time allows
+    uint64_t startCycles = benchCycles();
+    txInline.encrypt(packet, CfgCipherHeaderSize, payload, payloadSize);
+    inlineCycles += benchCycles() - startCycles;
+
+    // steady state generates one keystream per packet while radio is idle
+    startCycles = benchCycles();
+    tx.precompute();
+    precomputeCycles += benchCycles() - startCycles;
+    startCycles = benchCycles();
+    int packetSize = tx.encrypt(packet, CfgCipherHeaderSize, payload, payloadSize);
+    encryptCycles += benchCycles() - startCycles;
+
+    startCycles = benchCycles();
+    int rxSize = rx.decrypt(packet, CfgCipherHeaderSize, packetSize);
+    decryptCycles += benchCycles() - startCycles;
+    isValid = isValid && rxSize == payloadSize
+      && memcmp(packet + CfgCipherHeaderSize + RadioCipher::CfgNonceLen, payload, payloadSize) == 0;
+  }
+  printCipherResult("precompute", payloadSize, precomputeCycles);
+  printCipherResult("encrypt_precomputed", payloadSize, encryptCycles);
+  printCipherResult("encrypt_inline", payloadSize, inlineCycles);
+  printCipherResult("decrypt", payloadSize, decryptCycles);
+
+  // authenticated header and ciphertext, single bit flips must be rejected
+  long authFailCount = rx.getAuthFailCount();
+  const int offsets[] = { 0, CfgCipherHeaderSize + RadioCipher::CfgNonceLen + payloadSize / 2 };
+  for (int offset : offsets) {
+    int packetSize = tx.encrypt(packet, CfgCipherHeaderSize, payload, payloadSize);
+    packet[offset] ^= 0x10;
+    isValid = isValid && rx.decrypt(packet, CfgCipherHeaderSize, packetSize) < 0;
+  }
+  isValid = isValid && rx.getAuthFailCount() == authFailCount + 2;
+  printf("{\"stage\":\"cipher\",\"payload_bytes\":%d,\"stream_bytes\":%d,\"packets\":%d,\"roundtrip\":\"%s\"}\n",
+    payloadSize, CfgCipherStreamSize, CfgCipherPackets, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runCipherBench()
+{
+  bool isValid = true;
+  for (int payloadSize : CipherPayloadSizes) {
+    isValid = runCipherSize(payloadSize) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
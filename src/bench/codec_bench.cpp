@@ -0,0 +1,598 @@
+// Host benchmark of AudioCodec implementations, built by the native_bench environment.
+//
+// Every wav file of the corpus (16 bit pcm, channels are mixed down) is resampled
+// to the codec rate, then encoded and decoded with every codec2 mode and a grid of
+// opus bit rates, frame lengths and sample rates. One json object is printed per
+// file and configuration:
+//  - encode_us, decode_us: average time per frame, encode_max_us: worst frame
+//  - peak_heap: largest heap use from codec start to stop in bytes
+//  - bytes_per_s: codec payload, packet_bytes_per_s: with firmware packing and voice header,
+//    opus frames are combined into superframes
+//  - lsd_db: log spectral distance to the input over active frames, lower is better
+// Resampler between i2s and codec rates is measured on the same audio in ns per input sample.
+// Bit-packed codec2 superframes are round-trip checked against byte aligned frames for every mode.
+// Without files host checks and benchmarks of other firmware components are run instead,
+// exit status is 1 if any of them has failed.
+//
+// usage: codec_bench [-c codec2|opus|resampler] file.wav ...
+//        codec_bench [-c queue|airtime|fec|pipeline|rate|cipher|jitter|gain|micdsp|noise|vad|resampler|detect]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "loradv_config.h"
+#include "audio_codec_codec2.h"
+#include "audio_codec_opus.h"
+#include "resampler.h"
+#include "voice_header.h"
+#include "opus_superframe.h"
+#include "bit_packer.h"
+#include "bench.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+// codec libraries allocate with malloc, wrappers are interposed for the whole process
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static size_t heapUsed = 0;
+static size_t heapPeak = 0;
+
+static void heapAdd(void *ptr)
+{
+  if (ptr == NULL) return;
+  heapUsed += malloc_usable_size(ptr);
+  if (heapUsed > heapPeak) heapPeak = heapUsed;
+}
+
+static void heapRemove(void *ptr)
+{
+  if (ptr != NULL) heapUsed -= malloc_usable_size(ptr);
+}
+
+extern "C" void *malloc(size_t size)
+{
+  void *ptr = __libc_malloc(size);
+  heapAdd(ptr);
+  return ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  void *ptr = __libc_calloc(count, size);
+  heapAdd(ptr);
+  return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  heapRemove(ptr);
+  void *newPtr = __libc_realloc(ptr, size);
+  // failed realloc keeps the old block
+  heapAdd(newPtr != NULL || size == 0 ? newPtr : ptr);
+  return newPtr;
+}
+
+extern "C" void free(void *ptr)
+{
+  heapRemove(ptr);
+  __libc_free(ptr);
+}
+
+static void heapResetPeak() { heapPeak = heapUsed; }
+static long heapGetPeak(size_t base) { return (long)(heapPeak - base); }
+static size_t heapGetUsed() { return heapUsed; }
+#else
+static void heapResetPeak() {}
+static long heapGetPeak(size_t base) { return -1; }
+static size_t heapGetUsed() { return 0; }
+#endif
+
+namespace LoraDv {
+
+static const int CfgSpectrumSize = 256;           // quality analysis frame, hop is half of it
+static const float CfgActiveRangeDb = 40.0f;      // frames quieter than loudest by more are skipped
+static const float CfgSpectrumFloorDb = -100.0f;  // power floor, so silent bins do not dominate
+static const int CfgMaxDelayMs = 200;             // codec delay search range
+static const int CfgMaxEncodedSize = 4096;        // encoded frame buffer
+static const int CfgMaxPcmSize = 48000;           // decoded frame buffer, ten 120 ms frames at 16 kHz fit
+
+struct BenchConfig {
+  const char *codecName;
+  int codecType;
+  int mode;             // codec2 mode or opus bit rate
+  int bitRate;
+  float frameMs;        // opus only
+  int sampleRate;       // opus only, codec2 is always 8 kHz
+};
+
+struct BenchResult {
+  int frames;
+  float frameMs;
+  int frameBytes;       // largest encoded frame
+  double encodeUs;
+  double decodeUs;
+  double encodeMaxUs;
+  long peakHeap;
+  double bytesPerSecond;
+  double packetBytesPerSecond;
+  double lsdDb;
+};
+
+static const int Codec2Modes[] = {
+  CODEC2_MODE_3200, CODEC2_MODE_2400, CODEC2_MODE_1600, CODEC2_MODE_1400,
+  CODEC2_MODE_1300, CODEC2_MODE_1200, CODEC2_MODE_700C
+};
+static const int Codec2ModeRates[] = { 3200, 2400, 1600, 1400, 1300, 1200, 700 };
+static const int OpusRates[] = { 2400, 3200, 4800, 6400, 8000, 9600, 12000, 16000 };
+static const float OpusFrameLengths[] = { 20, 40, 60, 120 };
+static const int OpusSampleRates[] = { 8000, 16000 };
+static const int I2sSampleRates[] = { 16000, 48000 };
+
+struct HostBench {
+  const char *name;
+  bool (*run)();
+};
+
+static const HostBench HostBenches[] = {
+  { "queue", runQueueBench },
+  { "airtime", runAirTimeTest },
+  { "fec", runFecTest },
+  { "pipeline", runPipelineBench },
+  { "rate", runRateTest },
+  { "cipher", runCipherBench },
+  { "jitter", runJitterTest },
+  { "gain", runGainBench },
+  { "micdsp", runMicDspTest },
+  { "noise", runNoiseBench },
+  { "vad", runVadTest },
+  { "resampler", runResamplerCycleBench },
+  { "detect", runDetectTest },
+};
+
+static bool readWav(const char *fileName, std::vector<int16_t> &pcm, int &sampleRate)
+{
+  FILE *file = fopen(fileName, "rb");
+  if (file == NULL) return false;
+  uint8_t header[12];
+  bool isValid = fread(header, 1, 12, file) == 12 && memcmp(header, "RIFF", 4) == 0
+    && memcmp(header + 8, "WAVE", 4) == 0;
+  int channels = 0;
+  int bits = 0;
+  sampleRate = 0;
+  // walk chunks till data, format chunk comes before it
+  while (isValid) {
+    uint8_t chunk[8];
+    if (fread(chunk, 1, 8, file) != 8) {
+      isValid = false;
+      break;
+    }
+    uint32_t chunkSize = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+      uint8_t fmt[16];
+      isValid = fread(fmt, 1, 16, file) == 16 && (fmt[0] | (fmt[1] << 8)) == 1;
+      channels = fmt[2] | (fmt[3] << 8);
+      sampleRate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+      bits = fmt[14] | (fmt[15] << 8);
+      fseek(file, chunkSize - 16 + (chunkSize & 1), SEEK_CUR);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      isValid = channels > 0 && bits == 16;
+      if (!isValid) break;
+      std::vector<int16_t> frames(chunkSize / sizeof(int16_t));
+      size_t count = fread(frames.data(), sizeof(int16_t), frames.size(), file);
+      pcm.clear();
+      for (size_t i = 0; i + channels <= count; i += channels) {
+        int32_t sum = 0;
+        for (int c = 0; c < channels; c++) sum += frames[i + c];
+        pcm.push_back((int16_t)(sum / channels));
+      }
+      break;
+    } else {
+      fseek(file, chunkSize + (chunkSize & 1), SEEK_CUR);
+    }
+  }
+  fclose(file);
+  return isValid && !pcm.empty();
+}
+
+static bool resample(const std::vector<int16_t> &in, int inRate, std::vector<int16_t> &out, int outRate)
+{
+  Resampler resampler;
+  if (!resampler.setup(inRate, outRate)) return false;
+  if (!resampler.isActive()) {
+    out = in;
+    return true;
+  }
+  out.resize(in.size() * outRate / inRate + 8);
+  int outCount = resampler.process(in.data(), (int)in.size(), out.data(), (int)out.size());
+  out.resize(outCount);
+  return true;
+}
+
+static void fft(float *re, float *im, int n)
+{
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    float angle = -2.0f * (float)M_PI / len;
+    for (int i = 0; i < n; i += len) {
+      for (int k = 0; k < len / 2; k++) {
+        float wr = cosf(angle * k);
+        float wi = sinf(angle * k);
+        int a = i + k;
+        int b = i + k + len / 2;
+        float xr = re[b] * wr - im[b] * wi;
+        float xi = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - xr; im[b] = im[a] - xi;
+        re[a] += xr; im[a] += xi;
+      }
+    }
+  }
+}
+
+static void powerSpectrum(const int16_t *pcm, float *powerDb)
+{
+  float re[CfgSpectrumSize];
+  float im[CfgSpectrumSize];
+  for (int i = 0; i < CfgSpectrumSize; i++) {
+    float window = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / CfgSpectrumSize);
+    re[i] = pcm[i] / 32768.0f * window;
+    im[i] = 0;
+  }
+  fft(re, im, CfgSpectrumSize);
+  for (int k = 0; k <= CfgSpectrumSize / 2; k++) {
+    float power = re[k] * re[k] + im[k] * im[k];
+    powerDb[k] = power > 0 ? fmaxf(10.0f * log10f(power), CfgSpectrumFloorDb) : CfgSpectrumFloorDb;
+  }
+}
+
+static int findDelay(const std::vector<int16_t> &ref, const std::vector<int16_t> &out, int sampleRate)
+{
+  // codec delay from 1 ms envelope correlation, vocoders do not keep the waveform
+  int block = sampleRate / 1000;
+  int blocks = (int)std::min(ref.size(), out.size()) / block;
+  std::vector<float> refEnv(blocks), outEnv(blocks);
+  for (int b = 0; b < blocks; b++) {
+    for (int i = 0; i < block; i++) {
+      refEnv[b] += fabsf(ref[b * block + i]);
+      outEnv[b] += fabsf(out[b * block + i]);
+    }
+  }
+  int bestDelay = 0;
+  double bestScore = -1;
+  for (int delay = 0; delay < CfgMaxDelayMs && delay < blocks; delay++) {
+    double score = 0;
+    for (int b = 0; b + delay < blocks; b++) score += refEnv[b] * outEnv[b + delay];
+    score /= blocks - delay;
+    if (score > bestScore) {
+      bestScore = score;
+      bestDelay = delay;
+    }
+  }
+  return bestDelay * block;
+}
+
+static double logSpectralDistance(const std::vector<int16_t> &ref, const std::vector<int16_t> &out, int sampleRate)
+{
+  int delay = findDelay(ref, out, sampleRate);
+  int hop = CfgSpectrumSize / 2;
+  int bins = CfgSpectrumSize / 2 + 1;
+  int length = (int)std::min(ref.size(), out.size() - delay);
+  // frame levels first, only active speech is compared
+  std::vector<float> levels;
+  float maxLevel = CfgSpectrumFloorDb;
+  for (int pos = 0; pos + CfgSpectrumSize <= length; pos += hop) {
+    double energy = 0;
+    for (int i = 0; i < CfgSpectrumSize; i++) energy += (double)ref[pos + i] * ref[pos + i];
+    float level = energy > 0 ? 10.0f * log10f((float)(energy / CfgSpectrumSize)) : CfgSpectrumFloorDb;
+    levels.push_back(level);
+    maxLevel = fmaxf(maxLevel, level);
+  }
+  float refDb[CfgSpectrumSize / 2 + 1];
+  float outDb[CfgSpectrumSize / 2 + 1];
+  double sum = 0;
+  int count = 0;
+  for (size_t f = 0; f < levels.size(); f++) {
+    if (levels[f] < maxLevel - CfgActiveRangeDb) continue;
+    int pos = (int)f * hop;
+    powerSpectrum(&ref[pos], refDb);
+    powerSpectrum(&out[pos + delay], outDb);
+    double distance = 0;
+    for (int k = 1; k < bins; k++) {
+      double diff = refDb[k] - outDb[k];
+      distance += diff * diff;
+    }
+    sum += sqrt(distance / (bins - 1));
+    count++;
+  }
+  return count > 0 ? sum / count : -1;
+}
+
+static bool runBench(const BenchConfig &bench, const std::vector<int16_t> &pcm, int pcmRate, BenchResult &result)
+{
+  std::shared_ptr<Config> config = std::make_shared<Config>();
+  config->AudioCodec = bench.codecType;
+  config->AudioCodec2Mode = bench.mode;
+  config->AudioOpusRate = bench.mode;
+  config->AudioOpusPcmLen = bench.frameMs;
+  config->AudioOpusSampleRate_ = bench.sampleRate;
+  config->AudioOpusSuperframe = true;
+
+  std::vector<int16_t> input;
+  int codecRate = bench.codecType == CFG_AUDIO_CODEC_OPUS ? bench.sampleRate : 8000;
+  if (!resample(pcm, pcmRate, input, codecRate)) return false;
+
+  // bench buffers are allocated up front, so peak heap is what the codec uses
+  std::vector<uint8_t> encoded(CfgMaxEncodedSize);
+  std::vector<int16_t> decoded(CfgMaxPcmSize);
+  std::vector<int16_t> output;
+  output.reserve(input.size() + decoded.size());
+  std::vector<uint8_t> packet(OpusSuperframe::CfgBufferSize);
+  OpusSuperframe superframe;
+  if (!superframe.setup(config->AudioOpusPcmLen, config->AudioMaxPktSize)) return false;
+
+  size_t heapBase = heapGetUsed();
+  heapResetPeak();
+  std::shared_ptr<AudioCodec> codec;
+  if (bench.codecType == CFG_AUDIO_CODEC_OPUS)
+    codec.reset(new AudioCodecOpus());
+  else
+    codec.reset(new AudioCodecCodec2());
+  if (!codec->start(config) || codec->getFrameBufferSize() > (int)encoded.size() 
+      || codec->getPcmFrameBufferSize() > (int)decoded.size()) {
+    codec->stop();
+    return false;
+  }
+  int pcmFrameSize = codec->getPcmFrameSize();
+  long encodedBytes = 0;
+  long packetBytes = 0;
+  long packets = 0;
+  int packetSize = 0;
+  memset(&result, 0, sizeof(result));
+  for (size_t pos = 0; pos + pcmFrameSize <= input.size(); pos += pcmFrameSize) {
+    auto startTime = std::chrono::steady_clock::now();
+    int encodedSize = codec->encode(encoded.data(), &input[pos]);
+    auto encodeTime = std::chrono::steady_clock::now();
+    int decodedSize = encodedSize > 0 ? codec->decode(decoded.data(), encoded.data(), encodedSize) : 0;
+    auto decodeTime = std::chrono::steady_clock::now();
+    if (encodedSize <= 0 || decodedSize <= 0) {
+      codec->stop();
+      return false;
+    }
+    double encodeUs = std::chrono::duration<double, std::micro>(encodeTime - startTime).count();
+    result.encodeUs += encodeUs;
+    result.decodeUs += std::chrono::duration<double, std::micro>(decodeTime - encodeTime).count();
+    if (encodeUs > result.encodeMaxUs) result.encodeMaxUs = encodeUs;
+    if (encodedSize > result.frameBytes) result.frameBytes = encodedSize;
+    output.insert(output.end(), decoded.begin(), decoded.begin() + decodedSize);
+    encodedBytes += encodedSize;
+    result.frames++;
+    // packing as on air, fixed size frames are aggregated, opus frames are combined
+    if (!codec->isFixedFrameSize()) {
+      if (!superframe.canAppend(encoded.data(), encodedSize)) {
+        packetBytes += superframe.write(packet.data(), packet.size());
+        packets++;
+      }
+      superframe.append(encoded.data(), encodedSize);
+      if (superframe.isFull()) {
+        packetBytes += superframe.write(packet.data(), packet.size());
+        packets++;
+      }
+      continue;
+    }
+    if (packetSize + encodedSize > config->AudioMaxPktSize) {
+      packets++;
+      packetSize = 0;
+    }
+    packetSize += encodedSize;
+    packetBytes += encodedSize;
+  }
+  if (packetSize > 0) packets++;
+  if (superframe.hasFrames()) {
+    packetBytes += superframe.write(packet.data(), packet.size());
+    packets++;
+  }
+  codec->stop();
+  codec.reset();
+  result.peakHeap = heapGetPeak(heapBase);
+  if (result.frames == 0) return false;
+
+  double seconds = (double)result.frames * pcmFrameSize / codecRate;
+  result.frameMs = 1000.0f * pcmFrameSize / codecRate;
+  result.encodeUs /= result.frames;
+  result.decodeUs /= result.frames;
+  result.bytesPerSecond = encodedBytes / seconds;
+  result.packetBytesPerSecond = (packetBytes + packets * VoiceHeader::CfgSize) / seconds;
+  result.lsdDb = logSpectralDistance(input, output, codecRate);
+  return true;
+}
+
+static void printResult(const char *fileName, const BenchConfig &bench, const BenchResult &result)
+{
+  int sampleRate = bench.codecType == CFG_AUDIO_CODEC_OPUS ? bench.sampleRate : 8000;
+  printf("{\"file\":\"%s\",\"codec\":\"%s\",\"bit_rate\":%d,\"sample_rate\":%d,\"frame_ms\":%g,\"frame_bytes\":%d,"
+    "\"frames\":%d,\"encode_us\":%.2f,\"decode_us\":%.2f,\"encode_max_us\":%.1f,\"peak_heap\":%ld,"
+    "\"bytes_per_s\":%.1f,\"packet_bytes_per_s\":%.1f,\"lsd_db\":%.2f}\n",
+    fileName, bench.codecName, bench.bitRate, sampleRate, result.frameMs, result.frameBytes,
+    result.frames, result.encodeUs, result.decodeUs, result.encodeMaxUs, result.peakHeap,
+    result.bytesPerSecond, result.packetBytesPerSecond, result.lsdDb);
+  fflush(stdout);
+}
+
+static void runResamplerBench(const char *fileName, const std::vector<int16_t> &pcm, int pcmRate)
+{
+  for (int i2sRate : I2sSampleRates) {
+    for (int codecRate : OpusSampleRates) {
+      if (i2sRate == codecRate) continue;
+      // capture direction, then playback direction on the produced audio
+      std::vector<int16_t> i2sPcm, codecPcm, playbackPcm;
+      if (!resample(pcm, pcmRate, i2sPcm, i2sRate)) continue;
+      auto startTime = std::chrono::steady_clock::now();
+      resample(i2sPcm, i2sRate, codecPcm, codecRate);
+      auto captureTime = std::chrono::steady_clock::now();
+      resample(codecPcm, codecRate, playbackPcm, i2sRate);
+      auto playbackTime = std::chrono::steady_clock::now();
+      printf("{\"file\":\"%s\",\"stage\":\"resampler\",\"in_rate\":%d,\"out_rate\":%d,\"ns_per_sample\":%.2f}\n",
+        fileName, i2sRate, codecRate, 
+        std::chrono::duration<double, std::nano>(captureTime - startTime).count() / i2sPcm.size());
+      printf("{\"file\":\"%s\",\"stage\":\"resampler\",\"in_rate\":%d,\"out_rate\":%d,\"ns_per_sample\":%.2f}\n",
+        fileName, codecRate, i2sRate, 
+        std::chrono::duration<double, std::nano>(playbackTime - captureTime).count() / codecPcm.size());
+    }
+  }
+  fflush(stdout);
+}
+
+static bool runBitPackCheck(const char *fileName, int modeIndex, const std::vector<int16_t> &pcm)
+{
+  // same audio through byte aligned frames and through bit-packed superframes must decode the same,
+  // superframes are packed and split frame by frame as the audio task does it
+  std::shared_ptr<Config> byteConfig = std::make_shared<Config>();
+  std::shared_ptr<Config> bitConfig = std::make_shared<Config>();
+  byteConfig->AudioCodec2Mode = bitConfig->AudioCodec2Mode = Codec2Modes[modeIndex];
+  byteConfig->AudioCodec2BitPack = false;
+  bitConfig->AudioCodec2BitPack = true;
+  AudioCodecCodec2 byteCodec, bitCodec;
+  if (!byteCodec.start(byteConfig) || !bitCodec.start(bitConfig)) return false;
+
+  int samples = byteCodec.getPcmFrameSize();
+  int bytes = byteCodec.getFrameSize();
+  int bits = bitCodec.getFrameBits();
+  int byteFrames = std::max(byteConfig->AudioMaxPktSize / bytes, 1);
+  int bitFrames = std::max(8 * bitConfig->AudioMaxPktSize / bits, 1);
+  std::vector<uint8_t> superframe(CfgMaxEncodedSize), frame(CfgMaxEncodedSize), bitFrame(CfgMaxEncodedSize),
+    unpacked(CfgMaxEncodedSize);
+  std::vector<int16_t> bytePcm(bitFrames * samples), bitPcm(bitFrames * samples);
+  bool isMatching = true;
+  long frames = 0;
+  for (size_t pos = 0; isMatching && pos + bitFrames * samples <= pcm.size(); pos += bitFrames * samples) {
+    int16_t *pcmIn = const_cast<int16_t*>(&pcm[pos]);
+    for (int i = 0; i < bitFrames; i++) {
+      isMatching = isMatching && bitCodec.encode(bitFrame.data(), pcmIn + i * samples) == bytes;
+      BitPacker::write(superframe.data(), i * bits, bitFrame.data(), bits);
+    }
+    for (int i = 0; isMatching && i < bitFrames; i++) {
+      byteCodec.encode(frame.data(), pcmIn + i * samples);
+      byteCodec.decode(&bytePcm[i * samples], frame.data(), bytes);
+      BitPacker::read(superframe.data(), i * bits, unpacked.data(), bits);
+      bitCodec.decode(&bitPcm[i * samples], unpacked.data(), bytes);
+      isMatching = memcmp(frame.data(), unpacked.data(), bytes) == 0;
+    }
+    isMatching = isMatching && bytePcm == bitPcm;
+    frames += bitFrames;
+  }
+  byteCodec.stop();
+  bitCodec.stop();
+  printf("{\"file\":\"%s\",\"stage\":\"bitpack\",\"bit_rate\":%d,\"frame_bits\":%d,\"frames\":%ld,"
+    "\"byte_superframe\":[%d,%d],\"bit_superframe\":[%d,%d],\"roundtrip\":\"%s\"}\n",
+    fileName, Codec2ModeRates[modeIndex], bits, frames, byteFrames, byteFrames * bytes, 
+    bitFrames, BitPacker::getSize(bitFrames * bits), isMatching ? "ok" : "mismatch");
+  fflush(stdout);
+  return isMatching;
+}
+
+static void runFile(const char *fileName, const char *codecFilter)
+{
+  std::vector<int16_t> pcm;
+  int sampleRate;
+  if (!readWav(fileName, pcm, sampleRate)) {
+    fprintf(stderr, "%s: not a 16 bit pcm wav file\n", fileName);
+    return;
+  }
+  std::vector<BenchConfig> benches;
+  if (codecFilter == NULL || strcmp(codecFilter, "codec2") == 0) {
+    for (size_t i = 0; i < sizeof(Codec2Modes) / sizeof(Codec2Modes[0]); i++) {
+      BenchConfig bench = { "codec2", CFG_AUDIO_CODEC_CODEC2, Codec2Modes[i], Codec2ModeRates[i], 0, 8000 };
+      benches.push_back(bench);
+    }
+  }
+  if (codecFilter == NULL || strcmp(codecFilter, "opus") == 0) {
+    for (int rate : OpusSampleRates) {
+      for (float frameMs : OpusFrameLengths) {
+        for (int bitRate : OpusRates) {
+          BenchConfig bench = { "opus", CFG_AUDIO_CODEC_OPUS, bitRate, bitRate, frameMs, rate };
+          benches.push_back(bench);
+        }
+      }
+    }
+  }
+  if (codecFilter == NULL || strcmp(codecFilter, "resampler") == 0) {
+    runResamplerBench(fileName, pcm, sampleRate);
+  }
+  std::vector<int16_t> codec2Pcm;
+  if ((codecFilter == NULL || strcmp(codecFilter, "codec2") == 0) && resample(pcm, sampleRate, codec2Pcm, 8000)) {
+    for (size_t i = 0; i < sizeof(Codec2Modes) / sizeof(Codec2Modes[0]); i++) {
+      if (!runBitPackCheck(fileName, i, codec2Pcm)) {
+        fprintf(stderr, "%s: codec2 %d bps bit packing round trip failed\n", fileName, Codec2ModeRates[i]);
+      }
+    }
+  }
+  for (const BenchConfig &bench : benches) {
+    BenchResult result;
+    if (!runBench(bench, pcm, sampleRate, result)) {
+      fprintf(stderr, "%s: %s %d bps failed\n", fileName, bench.codecName, bench.bitRate);
+      continue;
+    }
+    printResult(fileName, bench, result);
+  }
+}
+
+static bool runHostBenches(const char *nameFilter)
+{
+  bool isValid = true;
+  bool isFound = false;
+  for (const HostBench &bench : HostBenches) {
+    if (nameFilter != NULL && strcmp(nameFilter, bench.name) != 0) continue;
+    isFound = true;
+    if (!bench.run()) {
+      fprintf(stderr, "%s: check failed\n", bench.name);
+      isValid = false;
+    }
+  }
+  if (!isFound) {
+    fprintf(stderr, "usage: codec_bench [-c codec2|opus|resampler] file.wav ...\n");
+    const char *separator = "       codec_bench [-c ";
+    for (const HostBench &bench : HostBenches) {
+      fprintf(stderr, "%s%s", separator, bench.name);
+      separator = "|";
+    }
+    fprintf(stderr, "]\n");
+  }
+  return isValid && isFound;
+}
+
+} // LoraDv
+
+int main(int argc, char **argv)
+{
+  LOG_SET_LEVEL(DebugLogLevel::LVL_NONE);
+  const char *codecFilter = NULL;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0) {
+    codecFilter = argv[arg + 1];
+    arg += 2;
+  }
+  if (arg >= argc) {
+    return LoraDv::runHostBenches(codecFilter) ? 0 : 1;
+  }
+  for (; arg < argc; arg++) {
+    LoraDv::runFile(argv[arg], codecFilter);
+  }
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Codec detection check on packets without voice header. Streams are built as the own and
+// the other codec station sends them, codec2 frames are random bytes, opus packets come from
+// the opus encoder at several bit rates.
+//  - raw codec2 and opus packets go to their codec, own opus keeps codec2 packets the opus parser
+//    accepts, so that direction is not checked with random frames
+//  - fec data and parity packets and implicit header packets padded to fixed size stay with
+//    the own codec2, opus_like counts those the opus parser would also accept
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <opus.h>
+
+#include "bench.h"
+#include "air_time.h"
+#include "decoder_cache.h"
+#include "loradv_config.h"
+#include "opus_superframe.h"
+#include "voice_fec.h"
+#include "voice_header.h"
+
+namespace LoraDv {
+
+static const int CfgDetectPackets = 200;
+static const int CfgDetectMaxPacketSize = 48;     // default packet size
+static const int CfgDetectFecDepth = 3;
+static const int CfgDetectOpusRate = 8000;
+static const int CfgDetectOpusFrameSize = 160;    // 20 ms
+static const int DetectOpusBitRates[] = { 6000, 9600, 16000 };
+
+enum DetectStream {
+  DetectCodec2Raw,
+  DetectCodec2Fec,
+  DetectCodec2Padded,
+  DetectOpusRaw
+};
+
+struct DetectCase {
+  const char *name;
+  int ownCodec;
+  int codec2Mode;
+  DetectStream stream;
+  int fecDepth;
+  bool isImplicit;
+  bool isBitPacked;
+};
+
+static const DetectCase DetectCases[] = {
+  { "codec2_own",      CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1600, DetectCodec2Raw,    0,                 false, false },
+  { "codec2_bitpack",  CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1300, DetectCodec2Raw,    0,                 false, true  },
+  { "codec2_fec",      CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1600, DetectCodec2Fec,    CfgDetectFecDepth, false, false },
+  { "codec2_fec",      CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_700C, DetectCodec2Fec,    CfgDetectFecDepth, false, false },
+  { "codec2_padded",   CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1400, DetectCodec2Padded, 0,                 true,  false },
+  { "codec2_padded",   CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1400, DetectCodec2Fec,    CfgDetectFecDepth, true,  false },
+  { "opus_from_codec2", CFG_AUDIO_CODEC_CODEC2, CODEC2_MODE_1600, DetectOpusRaw,     0,                 false, false },
+  { "opus_own",        CFG_AUDIO_CODEC_OPUS,   CODEC2_MODE_1600, DetectOpusRaw,      0,                 false, false },
+};
+
+class DetectRandom {
+public:
+  DetectRandom() : state_(0x27D4EB2Fu) {}
+
+  uint8_t next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_ >> 24;
+  }
+
+private:
+  uint32_t state_;
+};
+
+// raw codec2 packets with whole frames, every fifth one is a shorter tail
+static void makeCodec2Packets(int frameSize, std::vector<std::vector<uint8_t>> &packets)
+{
+  DetectRandom random;
+  int framesPerPacket = CfgDetectMaxPacketSize / frameSize;
+  for (int p = 0; p < CfgDetectPackets; p++) {
+    int frameCount = p % 5 == 4 ? 1 + p % framesPerPacket : framesPerPacket;
+    std::vector<uint8_t> packet(frameCount * frameSize);
+    for (uint8_t &value : packet) value = random.next();
+    packets.push_back(packet);
+  }
+}
+
+// data and parity packets of fec blocks, zero padded to the fixed size for implicit header
+static void makeFecPackets(int frameSize, bool isPadded, std::vector<std::vector<uint8_t>> &packets)
+{
+  DetectRandom random;
+  VoiceFecEncoder encoder;
+  std::vector<uint8_t> buffer(VoiceFecEncoder::getBufferSize(CfgDetectFecDepth, CfgDetectMaxPacketSize));
+  encoder.setup(CfgDetectFecDepth, frameSize, CfgDetectMaxPacketSize, buffer.data());
+  std::vector<uint8_t> frame(frameSize);
+  uint8_t packet[VoiceFec::CfgMaxPacketSize];
+  while ((int)packets.size() < CfgDetectPackets) {
+    for (uint8_t &value : frame) value = random.next();
+    if (!encoder.writeFrame(frame.data())) continue;
+    for (int i = 0; i < encoder.getPacketCount(); i++) {
+      int packetSize = encoder.readPacket(i, packet);
+      if (isPadded) {
+        memset(packet + packetSize, 0, CfgDetectMaxPacketSize - packetSize);
+        packetSize = CfgDetectMaxPacketSize;
+      }
+      packets.push_back(std::vector<uint8_t>(packet, packet + packetSize));
+    }
+    encoder.nextBlock();
+  }
+}
+
+// codec2 packets of the last frame count zero padded to the fixed size
+static void makePaddedPackets(int frameSize, std::vector<std::vector<uint8_t>> &packets)
+{
+  makeCodec2Packets(frameSize, packets);
+  for (std::vector<uint8_t> &packet : packets) packet.resize(CfgDetectMaxPacketSize, 0);
+}
+
+static bool makeOpusPackets(std::vector<std::vector<uint8_t>> &packets)
+{
+  int error;
+  OpusEncoder *encoder = opus_encoder_create(CfgDetectOpusRate, 1, OPUS_APPLICATION_VOIP, &error);
+  if (error != OPUS_OK) return false;
+  int16_t pcm[CfgDetectOpusFrameSize];
+  uint8_t packet[CfgDetectMaxPacketSize];
+  long sampleIndex = 0;
+  for (int p = 0; p < CfgDetectPackets; p++) {
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(DetectOpusBitRates[p % 3]));
+    for (int i = 0; i < CfgDetectOpusFrameSize; i++, sampleIndex++) {
+      float t = (float)sampleIndex / CfgDetectOpusRate;
+      pcm[i] = (int16_t)(8000 * (0.5f + 0.5f * sinf(2 * M_PI * 3 * t)) * sinf(2 * M_PI * 180 * t));
+    }
+    int packetSize = opus_encode(encoder, pcm, CfgDetectOpusFrameSize, packet, sizeof(packet));
+    if (packetSize <= 0) break;
+    packets.push_back(std::vector<uint8_t>(packet, packet + packetSize));
+  }
+  opus_encoder_destroy(encoder);
+  return (int)packets.size() == CfgDetectPackets;
+}
+
+static bool runDetectCase(const DetectCase &test)
+{
+  Config config;
+  config.AudioCodec = test.ownCodec;
+  config.AudioCodec2Mode = test.codec2Mode;
+  config.AudioFecDepth = test.fecDepth;
+  config.AudioCodec2BitPack = test.isBitPacked;
+  config.ModType = CFG_MOD_TYPE_LORA;
+  config.LoraImplicit = test.isImplicit;
+  int codecMode = test.ownCodec == CFG_AUDIO_CODEC_OPUS ? config.AudioOpusRate : test.codec2Mode;
+
+  std::vector<std::vector<uint8_t>> packets;
+  int frameSize = AirTime::getCodec2FrameSize(test.codec2Mode);
+  uint8_t expectedCodecId = test.codec2Mode;
+  switch (test.stream) {
+    case DetectCodec2Raw:
+      makeCodec2Packets(frameSize, packets);
+      break;
+    case DetectCodec2Fec:
+      makeFecPackets(frameSize, test.isImplicit, packets);
+      break;
+    case DetectCodec2Padded:
+      makePaddedPackets(frameSize, packets);
+      break;
+    case DetectOpusRaw:
+      if (!makeOpusPackets(packets)) {
+        printf("{\"stage\":\"detect\",\"case\":\"%s\",\"check\":\"no_opus\"}\n", test.name);
+        return false;
+      }
+      expectedCodecId = VoiceHeader::CfgCodecOpus;
+      break;
+  }
+
+  int misroutedCount = 0, opusLikeCount = 0;
+  for (const std::vector<uint8_t> &packet : packets) {
+    int packetSize = packet.size();
+    if (DecoderCache::detectCodec(config, codecMode, packet.data(), packetSize) != expectedCodecId) misroutedCount++;
+    if (expectedCodecId != VoiceHeader::CfgCodecOpus && packetSize % frameSize != 0
+      && OpusSuperframe::isValidPacket(packet.data(), packetSize)) opusLikeCount++;
+  }
+  bool isValid = misroutedCount == 0;
+  printf("{\"stage\":\"detect\",\"case\":\"%s\",\"codec2_mode\":%d,\"fec_depth\":%d,\"implicit\":%d,\"packets\":%d,"
+    "\"opus_like\":%d,\"misrouted\":%d,\"check\":\"%s\"}\n", test.name, test.codec2Mode, test.fecDepth,
+    test.isImplicit, (int)packets.size(), opusLikeCount, misroutedCount, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runDetectTest()
+{
+  bool isValid = true;
+  for (const DetectCase &test : DetectCases) {
+    isValid = runDetectCase(test) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
@@ -0,0 +1,232 @@
+// Voice forward error correction check under packet loss. Frames carry their index and
+// a checksum, stream is sent through random and burst (Gilbert-Elliott) loss channels,
+// optionally zero padded to fixed size as implicit header packets are. Every loss case runs
+// for several frame sizes, depths and packet sizes, up to blocks at the one byte frame count.
+//  - every block with at most one lost packet must be played completely
+//  - every played frame must be valid and in order, padding must not be played
+//  - residual_loss is the share of frames erased after recovery, overhead is the share of
+//    sent bytes which are not codec frames, parity, headers and padding included
+//  - partial last block with lost parity is checked separately
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "voice_fec.h"
+
+namespace LoraDv {
+
+static const int CfgStreamFrames = 30007;         // ends with a partial block
+
+struct FecLayout {
+  int frameSize;
+  int depth;              // data packets per block
+  int maxPacketSize;
+};
+
+static const FecLayout FecLayouts[] = {
+  { 8, 3,  48 },          // codec2 1600 at the default packet size
+  { 4, 5, 240 },          // codec2 700C, block would exceed the one byte frame count
+  { 6, 7, 240 },          // codec2 1200 at the largest depth
+  { 4, 7, 240 },
+};
+
+enum FecLossModel {
+  FecLossNone,
+  FecLossRandom,
+  FecLossBurst
+};
+
+struct FecCase {
+  const char *name;
+  FecLossModel model;
+  float lossRate;         // random loss or loss in bad state
+  float goodToBad;        // burst model transitions per packet
+  float badToGood;
+  bool isPadded;
+};
+
+static const FecCase FecCases[] = {
+  { "none",   FecLossNone,   0.0f,  0.0f,  0.0f, false },
+  { "random", FecLossRandom, 0.05f, 0.0f,  0.0f, false },
+  { "random", FecLossRandom, 0.2f,  0.0f,  0.0f, true  },
+  { "burst",  FecLossBurst,  1.0f,  0.05f, 0.5f, false },
+  { "burst",  FecLossBurst,  1.0f,  0.05f, 0.5f, true  },
+};
+
+class FecChannel {
+public:
+  explicit FecChannel(const FecCase &test) : test_(test), state_(0x9E3779B9u), isBad_(false) {}
+
+  bool isLost() {
+    switch (test_.model) {
+      case FecLossRandom:
+        return getRandom() < test_.lossRate;
+      case FecLossBurst:
+        isBad_ = isBad_ ? getRandom() >= test_.badToGood : getRandom() < test_.goodToBad;
+        return isBad_ && getRandom() < test_.lossRate;
+      default:
+        return false;
+    }
+  }
+
+private:
+  float getRandom() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return (float)(state_ >> 8) / (float)(1 << 24);
+  }
+
+  const FecCase &test_;
+  uint32_t state_;
+  bool isBad_;
+};
+
+// 24 bit frame index and its hash bytes, which are never zero, so padding is not a frame
+static void makeFrame(uint32_t index, uint8_t *frame, int frameSize)
+{
+  uint32_t hash = (index + 1) * 2654435761u;
+  for (int i = 0; i < 3; i++) frame[i] = index >> (8 * i);
+  for (int i = 3; i < frameSize; i++) frame[i] = (hash >> (8 * (i % 4))) | 1;
+}
+
+static bool checkFrame(const uint8_t *frame, int frameSize, uint32_t &index)
+{
+  uint8_t expected[VoiceFec::CfgMaxPacketSize];
+  index = frame[0] | frame[1] << 8 | frame[2] << 16;
+  makeFrame(index, expected, frameSize);
+  return memcmp(frame, expected, frameSize) == 0;
+}
+
+struct FecResult {
+  int playedCount;
+  int erasedCount;
+  int invalidCount;
+  int recoveredCount;
+  std::vector<bool> isPlayed;
+  int64_t lastIndex;
+  long sentBytes;
+  long frameBytes;
+};
+
+static void readFrames(VoiceFecDecoder &decoder, int frameSize, FecResult &result)
+{
+  const uint8_t *frame;
+  bool isErased;
+  while (decoder.readFrame(frame, isErased)) {
+    uint32_t index;
+    if (isErased) {
+      result.erasedCount++;
+    } else if (checkFrame(frame, frameSize, index) && index < result.isPlayed.size() && (int64_t)index > result.lastIndex) {
+      result.isPlayed[index] = true;
+      result.lastIndex = index;
+      result.playedCount++;
+    } else {
+      result.invalidCount++;
+    }
+  }
+}
+
+// sends frameCount frames, frames of blocks with at most one lost packet are marked as recoverable
+static void runFecStream(const FecCase &test, const FecLayout &layout, int frameCount, bool isLastParityLost,
+  FecResult &result, std::vector<bool> &isRecoverable)
+{
+  VoiceFecEncoder encoder;
+  VoiceFecDecoder decoder;
+  std::vector<uint8_t> encoderBuffer(VoiceFecEncoder::getBufferSize(layout.depth, layout.maxPacketSize));
+  std::vector<uint8_t> decoderBuffer(VoiceFecDecoder::getBufferSize(layout.depth, layout.maxPacketSize));
+  encoder.setup(layout.depth, layout.frameSize, layout.maxPacketSize, encoderBuffer.data());
+  decoder.setup(layout.depth, layout.frameSize, layout.maxPacketSize, decoderBuffer.data());
+  FecChannel channel(test);
+  result.playedCount = result.erasedCount = result.invalidCount = 0;
+  result.isPlayed.assign(frameCount, false);
+  result.lastIndex = -1;
+  result.sentBytes = 0;
+  result.frameBytes = (long)frameCount * layout.frameSize;
+  isRecoverable.assign(frameCount, false);
+
+  uint8_t frame[VoiceFec::CfgMaxPacketSize];
+  uint8_t packet[VoiceFec::CfgMaxPacketSize];
+  int blockStart = 0;
+  for (int f = 0; f < frameCount; f++) {
+    makeFrame(f, frame, layout.frameSize);
+    bool isLast = f == frameCount - 1;
+    if (!encoder.writeFrame(frame) && !isLast) continue;
+    int packetCount = encoder.getPacketCount();
+    int lostCount = 0;
+    for (int i = 0; i < packetCount; i++) {
+      int packetSize = encoder.readPacket(i, packet);
+      if (test.isPadded) {
+        memset(packet + packetSize, 0, layout.maxPacketSize - packetSize);
+        packetSize = layout.maxPacketSize;
+      }
+      result.sentBytes += packetSize;
+      bool isParity = i == packetCount - 1;
+      if (channel.isLost() || (isLast && isParity && isLastParityLost)) {
+        lostCount++;
+        continue;
+      }
+      decoder.writePacket(packet, packetSize);
+      readFrames(decoder, layout.frameSize, result);
+    }
+    encoder.nextBlock();
+    for (int i = blockStart; i <= f; i++) isRecoverable[i] = lostCount <= 1;
+    blockStart = f + 1;
+  }
+  decoder.flush();
+  readFrames(decoder, layout.frameSize, result);
+  result.recoveredCount = decoder.getRecoveredCount();
+}
+
+static bool checkFecResult(const FecResult &result, const std::vector<bool> &isRecoverable, int &missingCount)
+{
+  missingCount = 0;
+  for (size_t i = 0; i < isRecoverable.size(); i++) {
+    if (isRecoverable[i] && !result.isPlayed[i]) missingCount++;
+  }
+  return missingCount == 0 && result.invalidCount == 0;
+}
+
+bool runFecTest()
+{
+  bool isValid = true;
+  FecResult result;
+  std::vector<bool> isRecoverable;
+  for (const FecLayout &layout : FecLayouts) {
+    for (const FecCase &test : FecCases) {
+      runFecStream(test, layout, CfgStreamFrames, false, result, isRecoverable);
+      int missingCount;
+      bool isMatching = checkFecResult(result, isRecoverable, missingCount);
+      printf("{\"stage\":\"fec\",\"frame_size\":%d,\"depth\":%d,\"packet_size\":%d,\"loss\":\"%s\",\"rate\":%.2f,"
+        "\"padded\":%d,\"frames\":%d,\"played\":%d,\"recovered_packets\":%d,\"erased\":%d,\"missing\":%d,"
+        "\"invalid\":%d,\"residual_loss\":%.4f,\"overhead\":%.3f,\"check\":\"%s\"}\n",
+        layout.frameSize, layout.depth, layout.maxPacketSize, test.name, test.lossRate, test.isPadded,
+        CfgStreamFrames, result.playedCount, result.recoveredCount, result.erasedCount, missingCount,
+        result.invalidCount, (double)(CfgStreamFrames - result.playedCount) / CfgStreamFrames,
+        (double)(result.sentBytes - result.frameBytes) / result.sentBytes, isMatching ? "ok" : "mismatch");
+      isValid = isValid && isMatching;
+    }
+  }
+
+  // short block without parity, frame count is guessed from data packets which could be padded
+  const FecLayout &layout = FecLayouts[0];
+  for (int frameCount = 1; frameCount < 2 * layout.depth; frameCount++) {
+    for (int isPadded = 0; isPadded < 2; isPadded++) {
+      FecCase test = { "parity", FecLossNone, 0.0f, 0.0f, 0.0f, isPadded != 0 };
+      runFecStream(test, layout, frameCount, true, result, isRecoverable);
+      int missingCount;
+      bool isMatching = checkFecResult(result, isRecoverable, missingCount)
+        && result.playedCount == frameCount && result.erasedCount == 0;
+      printf("{\"stage\":\"fec\",\"loss\":\"%s\",\"padded\":%d,\"frames\":%d,\"played\":%d,\"erased\":%d,"
+        "\"invalid\":%d,\"check\":\"%s\"}\n", test.name, test.isPadded, frameCount, result.playedCount,
+        result.erasedCount, result.invalidCount, isMatching ? "ok" : "mismatch");
+      isValid = isValid && isMatching;
+    }
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
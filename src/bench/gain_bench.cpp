@@ -0,0 +1,114 @@
+// Playback gain benchmark. Q3.12 gain with limiter and soft clipper against the previous
+// double precision volume, which scaled every sample in place and wrapped on overflow.
+// Host has a double fpu while the esp32 emulates double in software, so host cycles tell
+// nothing about the speedup on the device, it is not measured here.
+//  - cycles_per_sample: one call per decoded frame, host loop cost only
+//  - wrapped: output samples with the sign flipped against the input, must be 0 for Q3.12
+//  - max_error: largest difference to the ideal unclipped gain below the limiter level,
+//    Q3.12 must stay within a few lsb when the limiter does not engage
+//  - peak: loudest output sample, soft knee saturates at full scale
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "audio_gain.h"
+
+namespace LoraDv {
+
+static const int CfgGainFrameSize = 320;          // codec2 40 ms frame at 8 kHz
+static const int CfgGainFrames = 2000;
+static const int CfgGainSampleRate = 8000;
+static const int CfgGainPeak = 12000;             // decoded speech level, below limiter at 100%
+static const int CfgGainMaxError = 2;             // Q3.12 truncation
+static const int GainVolumes[] = { 50, 100, 300, 500 };
+
+// previous playback path, double product is converted back as the 16 bit sample wraps
+static void applyDoubleVolume(int16_t *pcm, int sampleCount, int volume)
+{
+  double vol = volume / 100.0;
+  for (int i = 0; i < sampleCount; i++) {
+    pcm[i] = (int16_t)(int32_t)(pcm[i] * vol);
+  }
+}
+
+struct GainResult {
+  uint64_t cycles;
+  long wrappedCount;
+  int maxError;
+  int peak;
+};
+
+static void checkGainFrame(const int16_t *in, const int16_t *out, int volume, GainResult &result)
+{
+  for (int i = 0; i < CfgGainFrameSize; i++) {
+    if ((in[i] > 0 && out[i] < 0) || (in[i] < 0 && out[i] > 0)) result.wrappedCount++;
+    int level = out[i] < 0 ? -out[i] : out[i];
+    if (level > result.peak) result.peak = level;
+    int ideal = in[i] * volume / 100;
+    if (ideal > -CfgGainPeak && ideal < CfgGainPeak) {
+      int error = abs(ideal - out[i]);
+      if (error > result.maxError) result.maxError = error;
+    }
+  }
+}
+
+static bool runGainVolume(const std::vector<int16_t> &pcm, int volume)
+{
+  GainResult fixedResult = {}, doubleResult = {};
+  AudioGain gain;
+  gain.setVolume(volume);
+  gain.reset();
+  int16_t frame[CfgGainFrameSize];
+  for (int f = 0; f < CfgGainFrames; f++) {
+    const int16_t *in = pcm.data() + f * CfgGainFrameSize;
+
+    uint64_t startCycles = benchCycles();
+    gain.process(in, frame, CfgGainFrameSize);
+    fixedResult.cycles += benchCycles() - startCycles;
+    checkGainFrame(in, frame, volume, fixedResult);
+
+    memcpy(frame, in, sizeof(frame));
+    startCycles = benchCycles();
+    applyDoubleVolume(frame, CfgGainFrameSize, volume);
+    doubleResult.cycles += benchCycles() - startCycles;
+    checkGainFrame(in, frame, volume, doubleResult);
+  }
+
+  // limiter engages above 100%, so ideal gain is compared only where it does not
+  bool isValid = fixedResult.wrappedCount == 0 && (volume > 100 || fixedResult.maxError <= CfgGainMaxError);
+  double sampleCount = (double)CfgGainFrames * CfgGainFrameSize;
+  const GainResult *results[] = { &fixedResult, &doubleResult };
+  const char *paths[] = { "q3_12", "double" };
+  for (int i = 0; i < 2; i++) {
+    printf("{\"stage\":\"gain\",\"path\":\"%s\",\"volume\":%d,\"cycles_per_sample\":%.2f,\"wrapped\":%ld,"
+      "\"peak\":%d,\"max_error\":%d}\n", paths[i], volume, results[i]->cycles / sampleCount,
+      results[i]->wrappedCount, results[i]->peak, results[i]->maxError);
+  }
+  printf("{\"stage\":\"gain\",\"volume\":%d,\"check\":\"%s\"}\n", volume, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runGainBench()
+{
+  // voiced speech like harmonics with syllable envelope
+  std::vector<int16_t> pcm(CfgGainFrames * CfgGainFrameSize);
+  for (size_t i = 0; i < pcm.size(); i++) {
+    float t = (float)i / CfgGainSampleRate;
+    float envelope = 0.5f + 0.5f * sinf(2 * M_PI * 4 * t);
+    float sample = 0.6f * sinf(2 * M_PI * 150 * t) + 0.3f * sinf(2 * M_PI * 450 * t)
+      + 0.1f * sinf(2 * M_PI * 1350 * t);
+    pcm[i] = (int16_t)(CfgGainPeak * envelope * sample);
+  }
+  bool isValid = true;
+  for (int volume : GainVolumes) {
+    isValid = runGainVolume(pcm, volume) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
@@ -0,0 +1,147 @@
+// Jitter buffer playout depth check on packet arrival traces. Packets of six 40 ms frames
+// arrive with the trace timing, one frame is popped every frame period as the playout does.
+//  - every pushed frame is either played in order or dropped as overrun, stream ends by itself
+//  - steady arrivals keep the minimum delay without underruns or overruns
+//  - jittery arrivals raise the target delay, so underruns stay rare
+//  - late packet is concealed, sender backlog is dropped to keep latency bounded
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "jitter_buffer.h"
+
+namespace LoraDv {
+
+static const int CfgJitterFrameMs = 40;           // codec2 frame
+static const int CfgJitterPacketFrames = 6;       // frames per radio packet
+static const int CfgJitterPackets = 100;
+static const int CfgJitterFrameSize = 8;
+static const int CfgJitterStartMs = 100;          // first packet, above largest negative deviation
+
+enum JitterTrace {
+  JitterTraceSteady,    // packet every packet duration
+  JitterTraceJitter,    // random deviation of every arrival
+  JitterTraceLate,      // one packet late, next ones catch up
+  JitterTraceBacklog    // sender queue flushed faster than real time
+};
+
+struct JitterCase {
+  const char *name;
+  JitterTrace trace;
+  int deviationMs;
+};
+
+static const JitterCase JitterCases[] = {
+  { "steady",  JitterTraceSteady,    0 },
+  { "jitter",  JitterTraceJitter,   80 },
+  { "late",    JitterTraceLate,    600 },
+  { "backlog", JitterTraceBacklog,   0 },
+};
+
+static void makeJitterTrace(const JitterCase &test, std::vector<uint32_t> &arrivals)
+{
+  int packetMs = CfgJitterPacketFrames * CfgJitterFrameMs;
+  uint32_t state = 0x6C078965u;
+  arrivals.resize(CfgJitterPackets);
+  for (int p = 0; p < CfgJitterPackets; p++) {
+    int arrivalMs = CfgJitterStartMs + p * packetMs;
+    switch (test.trace) {
+      case JitterTraceJitter:
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        arrivalMs += (int)(state % (2 * test.deviationMs + 1)) - test.deviationMs;
+        break;
+      case JitterTraceLate:
+        if (p == CfgJitterPackets / 2) arrivalMs += test.deviationMs;
+        break;
+      case JitterTraceBacklog:
+        arrivalMs = CfgJitterStartMs + p * packetMs / 2;
+        break;
+      default:
+        break;
+    }
+    // packets are not reordered by the radio, the ones behind a late packet come with it
+    if (p > 0 && arrivalMs < (int)arrivals[p - 1]) arrivalMs = arrivals[p - 1];
+    arrivals[p] = arrivalMs;
+  }
+}
+
+static bool runJitterCase(const JitterCase &test)
+{
+  std::vector<uint32_t> arrivals;
+  makeJitterTrace(test, arrivals);
+  JitterBuffer jitterBuffer;
+  std::vector<uint8_t> storage(JitterBuffer::CfgBufferSize);
+  jitterBuffer.setup(CfgJitterFrameMs, storage.data());
+
+  int pushedCount = 0, playedCount = 0, maxTargetMs = 0, maxLatencyMs = 0;
+  int64_t lastIndex = -1;
+  bool isOrdered = true;
+  uint32_t endMs = arrivals.back() + 4000;
+  int packet = 0;
+  for (uint32_t nowMs = 0; nowMs < endMs; nowMs += CfgJitterFrameMs) {
+    while (packet < CfgJitterPackets && arrivals[packet] <= nowMs) {
+      for (int f = 0; f < CfgJitterPacketFrames; f++) {
+        uint8_t frame[CfgJitterFrameSize] = { 0 };
+        uint32_t index = packet * CfgJitterPacketFrames + f;
+        memcpy(frame, &index, sizeof(index));
+        jitterBuffer.push(frame, sizeof(frame));
+        pushedCount++;
+      }
+      jitterBuffer.onArrival(arrivals[packet]);
+      if (++packet == CfgJitterPackets) jitterBuffer.onEndOfStream();
+    }
+    const uint8_t *frame;
+    int frameSize;
+    if (jitterBuffer.pop(nowMs, frame, frameSize) == JitterBuffer::Frame::Audio) {
+      uint32_t index;
+      memcpy(&index, frame, sizeof(index));
+      isOrdered = isOrdered && (int64_t)index > lastIndex;
+      lastIndex = index;
+      playedCount++;
+      int latencyMs = nowMs - arrivals[index / CfgJitterPacketFrames];
+      if (latencyMs > maxLatencyMs) maxLatencyMs = latencyMs;
+    }
+    if (jitterBuffer.getStats().targetDelayMs > maxTargetMs) maxTargetMs = jitterBuffer.getStats().targetDelayMs;
+  }
+
+  const JitterBufferStats &stats = jitterBuffer.getStats();
+  int frameCount = CfgJitterPackets * CfgJitterPacketFrames;
+  bool isValid = isOrdered && pushedCount == frameCount && playedCount + stats.overruns == frameCount
+    && !jitterBuffer.isActive();
+  switch (test.trace) {
+    case JitterTraceSteady:
+      isValid = isValid && stats.underruns == 0 && stats.overruns == 0 && maxTargetMs == CfgJitterFrameMs;
+      break;
+    case JitterTraceJitter:
+      isValid = isValid && stats.targetDelayMs > CfgJitterFrameMs && stats.underruns <= frameCount / 50;
+      break;
+    case JitterTraceLate:
+      isValid = isValid && stats.underruns > 0 && stats.underruns * CfgJitterFrameMs <= test.deviationMs;
+      break;
+    case JitterTraceBacklog:
+      // buffered audio stays within a few packets
+      isValid = isValid && stats.overruns > 0 && maxLatencyMs <= 4 * CfgJitterPacketFrames * CfgJitterFrameMs;
+      break;
+  }
+  printf("{\"stage\":\"jitter\",\"trace\":\"%s\",\"frames\":%d,\"played\":%d,\"underruns\":%ld,\"overruns\":%ld,"
+    "\"jitter_ms\":%d,\"target_ms\":%d,\"max_target_ms\":%d,\"max_latency_ms\":%d,\"check\":\"%s\"}\n",
+    test.name, frameCount, playedCount, stats.underruns, stats.overruns, stats.jitterMs, stats.targetDelayMs,
+    maxTargetMs, maxLatencyMs, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runJitterTest()
+{
+  bool isValid = true;
+  for (const JitterCase &test : JitterCases) {
+    isValid = runJitterCase(test) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
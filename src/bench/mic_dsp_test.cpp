@@ -0,0 +1,187 @@
+// Mic dsp chain check on synthetic mic pcm at the codec rates. Every stage runs alone on the signal it
+// is meant for, then the whole chain runs on loud speech with dc offset as the mic delivers it.
+//  - high-pass removes dc and attenuates rumble, keeps speech band tone
+//  - gate passes speech and attenuates background after the hold time
+//  - agc brings quiet and loud speech towards the target level within its gain range
+//  - compressor reduces peaks above the threshold by its ratio
+//  - chain does not saturate
+// Levels are measured over the last second of every case, after stages settle. Noise stage has
+// its own benchmark, so cases run without an arena.
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "mic_dsp.h"
+
+namespace LoraDv {
+
+static const int CfgMicFrameMs = 40;              // codec2 frame
+static const int CfgMicSeconds = 4;
+
+enum MicDspCheck {
+  MicDspCheckHighPass,
+  MicDspCheckGate,
+  MicDspCheckAgc,
+  MicDspCheckCompressor,
+  MicDspCheckChain
+};
+
+struct MicDspCase {
+  const char *name;
+  MicDspCheck check;
+  uint32_t stageMask;
+  int sampleRate;
+  float speechPeak;       // harmonic speech like signal
+  float noiseLevel;       // uniform background noise amplitude
+  float dcOffset;
+  float rumblePeak;       // 30 Hz
+  float tonePeak;         // 1 kHz
+};
+
+static const uint32_t MicStageChain = MicDsp::CfgStageAll & ~(1 << MicDsp::CfgStageNoise);
+
+static const MicDspCase MicDspCases[] = {
+  { "highpass",     MicDspCheckHighPass,   1 << MicDsp::CfgStageHighPass,    8000,     0.0f,   0.0f, 1000.0f, 3000.0f,  4000.0f },
+  { "highpass_16k", MicDspCheckHighPass,   1 << MicDsp::CfgStageHighPass,   16000,     0.0f,   0.0f, 1000.0f, 3000.0f,  4000.0f },
+  { "highpass_48k", MicDspCheckHighPass,   1 << MicDsp::CfgStageHighPass,   48000,     0.0f,   0.0f, 1000.0f, 3000.0f,  4000.0f },
+  { "gate",         MicDspCheckGate,       1 << MicDsp::CfgStageGate,        8000,  6000.0f, 100.0f,    0.0f,    0.0f,     0.0f },
+  { "agc_quiet",    MicDspCheckAgc,        1 << MicDsp::CfgStageAgc,         8000,  1500.0f,   0.0f,    0.0f,    0.0f,     0.0f },
+  { "agc_loud",     MicDspCheckAgc,        1 << MicDsp::CfgStageAgc,         8000, 24000.0f,   0.0f,    0.0f,    0.0f,     0.0f },
+  { "compressor",   MicDspCheckCompressor, 1 << MicDsp::CfgStageCompressor,  8000,     0.0f,   0.0f,    0.0f,    0.0f, 30000.0f },
+  { "chain",        MicDspCheckChain,      MicStageChain,                    8000, 30000.0f, 100.0f, 1500.0f,    0.0f,     0.0f },
+  { "chain_16k",    MicDspCheckChain,      MicStageChain,                   16000, 30000.0f, 100.0f, 1500.0f,    0.0f,     0.0f },
+};
+
+// gate case alternates one second of speech and one of background
+static bool isMicSpeech(const MicDspCase &test, int index)
+{
+  return test.check != MicDspCheckGate || (index / test.sampleRate) % 2 == 0;
+}
+
+static void makeMicSignal(const MicDspCase &test, std::vector<int16_t> &pcm)
+{
+  uint32_t state = 0x1B873593u;
+  pcm.resize(CfgMicSeconds * test.sampleRate);
+  for (size_t i = 0; i < pcm.size(); i++) {
+    float t = (float)i / test.sampleRate;
+    float sample = test.dcOffset + test.rumblePeak * sinf(2 * M_PI * 30 * t) + test.tonePeak * sinf(2 * M_PI * 1000 * t);
+    if (isMicSpeech(test, i)) {
+      // syllable envelope does not reach zero, so agc sees continuous speech
+      float envelope = 0.6f + 0.4f * sinf(2 * M_PI * 4 * t);
+      sample += test.speechPeak * envelope * (0.6f * sinf(2 * M_PI * 150 * t) + 0.3f * sinf(2 * M_PI * 450 * t)
+        + 0.1f * sinf(2 * M_PI * 1350 * t));
+    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    sample += test.noiseLevel * ((float)(state >> 8) / (float)(1 << 23) - 1.0f);
+    if (sample > 32767) sample = 32767;
+    if (sample < -32768) sample = -32768;
+    pcm[i] = (int16_t)sample;
+  }
+}
+
+// mean absolute level and sine amplitude at frequency over a range
+static float getMicLevel(const std::vector<int16_t> &pcm, int start, int count)
+{
+  double sum = 0;
+  for (int i = start; i < start + count; i++) sum += fabs((double)pcm[i]);
+  return sum / count;
+}
+
+static float getMicTone(const std::vector<int16_t> &pcm, int start, int count, float frequency, int sampleRate)
+{
+  double re = 0, im = 0;
+  for (int i = start; i < start + count; i++) {
+    double phase = 2 * M_PI * frequency * i / sampleRate;
+    re += pcm[i] * cos(phase);
+    im += pcm[i] * sin(phase);
+  }
+  return 2 * sqrt(re * re + im * im) / count;
+}
+
+static float getMicMean(const std::vector<int16_t> &pcm, int start, int count)
+{
+  double sum = 0;
+  for (int i = start; i < start + count; i++) sum += pcm[i];
+  return sum / count;
+}
+
+static bool runMicDspCase(const MicDspCase &test)
+{
+  std::vector<int16_t> in, out;
+  makeMicSignal(test, in);
+  out = in;
+  MicDsp micDsp;
+  micDsp.setup(test.sampleRate, test.stageMask, nullptr);
+  int frameSize = test.sampleRate * CfgMicFrameMs / 1000;
+  for (size_t i = 0; i + frameSize <= out.size(); i += frameSize) {
+    micDsp.process(out.data() + i, frameSize);
+  }
+
+  int start = (CfgMicSeconds - 1) * test.sampleRate;
+  int count = test.sampleRate;
+  float inLevel = getMicLevel(in, start, count);
+  float outLevel = getMicLevel(out, start, count);
+  int saturatedCount = 0;
+  for (int16_t sample : out) {
+    if (sample == 32767 || sample == -32768) saturatedCount++;
+  }
+  bool isValid = false;
+  switch (test.check) {
+    case MicDspCheckHighPass: {
+      float dc = getMicMean(out, start, count);
+      float toneGain = getMicTone(out, start, count, 1000, test.sampleRate) / test.tonePeak;
+      float rumbleGain = getMicTone(out, start, count, 30, test.sampleRate) / test.rumblePeak;
+      isValid = fabsf(dc) < 20 && toneGain > 0.9f && rumbleGain < 0.5f;
+      printf("{\"stage\":\"mic_dsp\",\"case\":\"%s\",\"dc\":%.1f,\"tone_gain\":%.3f,\"rumble_gain\":%.3f,"
+        "\"check\":\"%s\"}\n", test.name, dc, toneGain, rumbleGain, isValid ? "ok" : "mismatch");
+      return isValid;
+    }
+    case MicDspCheckGate: {
+      // last second is background, the one before is speech, hold time and first frame are skipped
+      int speechStart = start - count + frameSize;
+      float speechGain = getMicLevel(out, speechStart, count / 2) / getMicLevel(in, speechStart, count / 2);
+      int noiseStart = start + count / 2;
+      float noiseGain = getMicLevel(out, noiseStart, count / 2) / getMicLevel(in, noiseStart, count / 2);
+      isValid = speechGain > 0.95f && noiseGain < 0.15f;
+      printf("{\"stage\":\"mic_dsp\",\"case\":\"%s\",\"speech_gain\":%.3f,\"noise_gain\":%.3f,\"check\":\"%s\"}\n",
+        test.name, speechGain, noiseGain, isValid ? "ok" : "mismatch");
+      return isValid;
+    }
+    case MicDspCheckAgc: {
+      // target is reached unless gain range limits it, fast attack on syllable peaks keeps it lower
+      const float targetLevel = 3000, minGain = 0.5f, maxGain = 8.0f;
+      float expectedLevel = fminf(fmaxf(targetLevel, inLevel * minGain), inLevel * maxGain);
+      isValid = outLevel > 0.7f * expectedLevel && outLevel < 1.2f * expectedLevel;
+      break;
+    }
+    case MicDspCheckCompressor: {
+      const float threshold = 16384;
+      float expectedPeak = threshold + (test.tonePeak - threshold) / 4;
+      float outPeak = getMicTone(out, start, count, 1000, test.sampleRate);
+      isValid = outPeak > 0.95f * expectedPeak && outPeak < 1.05f * expectedPeak;
+      break;
+    }
+    case MicDspCheckChain:
+      isValid = saturatedCount == 0 && outLevel > 0;
+      break;
+  }
+  printf("{\"stage\":\"mic_dsp\",\"case\":\"%s\",\"in_level\":%.0f,\"out_level\":%.0f,\"saturated\":%d,"
+    "\"check\":\"%s\"}\n", test.name, inLevel, outLevel, saturatedCount, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runMicDspTest()
+{
+  bool isValid = true;
+  for (const MicDspCase &test : MicDspCases) {
+    isValid = runMicDspCase(test) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
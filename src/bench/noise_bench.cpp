@@ -0,0 +1,194 @@
+// Noise suppressor benchmark on synthetic noisy speech at 8 and 16 kHz. Speech like harmonics with
+// syllables and pauses are mixed with white or low frequency vehicle like noise at several snrs,
+// then suppressed in 40 ms frames as the mic dsp does it, the block length follows the rate.
+//  - cycles_per_frame: suppressor cost of one frame, frame_percent is its share of frame time
+//    on the host, esp32 cost is logged by the firmware mic dsp stats
+//  - seg_snr_in, seg_snr_out: segmental snr of speech frames against the clean speech, output
+//    is aligned by the suppressor delay, must improve
+//  - noise_db: attenuation of speech pauses, must reach a few dB
+//  - restart_noise_db: same for the first half second of the next transmission after reset,
+//    noise estimate is kept between transmissions, so it must be attenuated right away
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "bench.h"
+#include "heap_arena.h"
+#include "noise_suppressor.h"
+
+namespace LoraDv {
+
+static const int CfgNoiseFrameMs = 40;            // codec2 frame
+static const int CfgNoiseSeconds = 8;
+static const int CfgNoiseSegmentMs = 32;          // segmental snr block
+static const int CfgNoiseSpeechPeak = 8000;
+static const float CfgNoiseMinAttenDb = 6.0f;
+
+enum NoiseType {
+  NoiseWhite,
+  NoiseVehicle          // integrated white noise, most power below a few hundred Hz
+};
+
+struct NoiseCase {
+  const char *name;
+  NoiseType type;
+  float snrDb;
+  int sampleRate;
+};
+
+static const NoiseCase NoiseCases[] = {
+  { "white",    NoiseWhite,    0.0f,  8000 },
+  { "white",    NoiseWhite,    5.0f,  8000 },
+  { "white",    NoiseWhite,   10.0f,  8000 },
+  { "vehicle",  NoiseVehicle,  0.0f,  8000 },
+  { "vehicle",  NoiseVehicle, 10.0f,  8000 },
+  { "white",    NoiseWhite,    5.0f, 16000 },
+  { "vehicle",  NoiseVehicle,  0.0f, 16000 },
+};
+
+// speech with pauses between syllable groups, minimum statistics find the noise there
+static void makeNoiseSpeech(std::vector<float> &speech, int sampleCount, int sampleRate)
+{
+  speech.resize(sampleCount);
+  for (int i = 0; i < sampleCount; i++) {
+    float t = (float)i / sampleRate;
+    float envelope = sinf(2 * M_PI * 1.5f * t);
+    envelope = envelope > 0 ? envelope : 0;
+    float pitch = 140 + 20 * sinf(2 * M_PI * 0.7f * t);
+    float phase = 2 * M_PI * pitch * t;
+    speech[i] = CfgNoiseSpeechPeak * envelope * (0.5f * sinf(phase) + 0.3f * sinf(3 * phase)
+      + 0.15f * sinf(7 * phase) + 0.05f * sinf(15 * phase));
+  }
+}
+
+static void makeNoise(NoiseType type, std::vector<float> &noise, int sampleCount)
+{
+  uint32_t state = 0x85EBCA6Bu;
+  float lowPass = 0;
+  noise.resize(sampleCount);
+  for (int i = 0; i < sampleCount; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    float white = (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+    lowPass = 0.97f * lowPass + 0.03f * white;
+    noise[i] = type == NoiseWhite ? white : lowPass;
+  }
+}
+
+static double getNoisePower(const float *pcm, int count)
+{
+  double sum = 0;
+  for (int i = 0; i < count; i++) sum += (double)pcm[i] * pcm[i];
+  return sum / count;
+}
+
+struct NoiseResult {
+  double segSnrIn;
+  double segSnrOut;
+  double noiseDb;
+  int speechSegments;
+};
+
+// output sample i + delay is the processed input sample i
+static void measureNoise(const std::vector<float> &speech, const std::vector<float> &noisy,
+  const std::vector<int16_t> &out, int start, int end, int delay, int segmentSize, NoiseResult &result)
+{
+  result = NoiseResult();
+  double pauseIn = 0, pauseOut = 0;
+  for (int s = start; s + segmentSize + delay <= end; s += segmentSize) {
+    double speechPower = getNoisePower(&speech[s], segmentSize);
+    double errorIn = 0, errorOut = 0, powerIn = 0, powerOut = 0;
+    for (int i = s; i < s + segmentSize; i++) {
+      errorIn += (noisy[i] - speech[i]) * (noisy[i] - speech[i]);
+      errorOut += (out[i + delay] - speech[i]) * (out[i + delay] - speech[i]);
+      powerIn += (double)noisy[i] * noisy[i];
+      powerOut += (double)out[i + delay] * out[i + delay];
+    }
+    if (speechPower == 0) {
+      pauseIn += powerIn;
+      pauseOut += powerOut;
+    } else if (speechPower > 0.01 * CfgNoiseSpeechPeak * CfgNoiseSpeechPeak) {
+      // segment snr is limited to the usual range, so silent or perfect segments do not dominate
+      double snrIn = 10 * log10(speechPower * segmentSize / (errorIn + 1));
+      double snrOut = 10 * log10(speechPower * segmentSize / (errorOut + 1));
+      result.segSnrIn += fmin(fmax(snrIn, -10.0), 35.0);
+      result.segSnrOut += fmin(fmax(snrOut, -10.0), 35.0);
+      result.speechSegments++;
+    }
+  }
+  if (result.speechSegments > 0) {
+    result.segSnrIn /= result.speechSegments;
+    result.segSnrOut /= result.speechSegments;
+  }
+  result.noiseDb = pauseOut > 0 ? 10 * log10(pauseIn / pauseOut) : 0;
+}
+
+static bool runNoiseCase(const NoiseCase &test)
+{
+  int sampleCount = CfgNoiseSeconds * test.sampleRate;
+  int frameSize = test.sampleRate * CfgNoiseFrameMs / 1000;
+  int segmentSize = test.sampleRate * CfgNoiseSegmentMs / 1000;
+  std::vector<float> speech, noise;
+  makeNoiseSpeech(speech, sampleCount, test.sampleRate);
+  makeNoise(test.type, noise, sampleCount);
+  double noiseGain = sqrt(getNoisePower(speech.data(), sampleCount) / getNoisePower(noise.data(), sampleCount)
+    / pow(10.0, test.snrDb / 10));
+  std::vector<float> noisy(sampleCount);
+  std::vector<int16_t> pcm(sampleCount);
+  for (int i = 0; i < sampleCount; i++) {
+    noisy[i] = fmax(fmin(speech[i] + noiseGain * noise[i], 32767.0), -32768.0);
+    pcm[i] = (int16_t)noisy[i];
+    noisy[i] = pcm[i];
+  }
+
+  // second half is the next transmission after reset, as on ptt
+  HeapArena arena("Noise");
+  NoiseSuppressor noiseSuppressor;
+  if (!arena.reserve(NoiseSuppressor::getArenaSize(test.sampleRate))
+    || !noiseSuppressor.setup(test.sampleRate, &arena)) {
+    printf("{\"stage\":\"noise\",\"sample_rate\":%d,\"check\":\"no_memory\"}\n", test.sampleRate);
+    return false;
+  }
+  int restart = sampleCount / 2 / frameSize * frameSize;
+  uint64_t cycles = 0;
+  int frameCount = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  for (int i = 0; i + frameSize <= sampleCount; i += frameSize) {
+    if (i == restart) noiseSuppressor.reset();
+    uint64_t startCycles = benchCycles();
+    noiseSuppressor.process(&pcm[i], frameSize);
+    cycles += benchCycles() - startCycles;
+    frameCount++;
+  }
+  double hostNs = benchNs(startTime);
+
+  // first transmission after the estimate has settled, next one from its start
+  const int delay = noiseSuppressor.getFftSize();
+  NoiseResult settled, restarted;
+  measureNoise(speech, noisy, pcm, 2 * test.sampleRate, restart, delay, segmentSize, settled);
+  measureNoise(speech, noisy, pcm, restart, restart + test.sampleRate / 2 + delay, delay, segmentSize, restarted);
+  bool isValid = settled.segSnrOut > settled.segSnrIn && settled.noiseDb >= CfgNoiseMinAttenDb
+    && restarted.noiseDb >= CfgNoiseMinAttenDb;
+  printf("{\"stage\":\"noise\",\"noise\":\"%s\",\"snr_db\":%.0f,\"sample_rate\":%d,\"fft_size\":%d,"
+    "\"cycles_per_frame\":%.0f,\"frame_percent\":%.3f,"
+    "\"seg_snr_in\":%.2f,\"seg_snr_out\":%.2f,\"noise_db\":%.1f,\"restart_noise_db\":%.1f,\"check\":\"%s\"}\n",
+    test.name, test.snrDb, test.sampleRate, delay, (double)cycles / frameCount,
+    100 * hostNs / 1e6 / frameCount / CfgNoiseFrameMs,
+    settled.segSnrIn, settled.segSnrOut, settled.noiseDb, restarted.noiseDb, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runNoiseBench()
+{
+  bool isValid = true;
+  for (const NoiseCase &test : NoiseCases) {
+    isValid = runNoiseCase(test) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
@@ -0,0 +1,178 @@
+// Transmit to receive pipeline benchmark over the simulated radio channel. Default codec2
+// configuration encodes superframes, packets with voice header go from one simulated device
+// to another, received packets are decoded and sequence gaps are concealed.
+//  - ideal channel without air time: packets_per_s is pipeline throughput on the host
+//  - lossy channel with air time: tx_to_rx_ms is transmit start to decoded audio latency
+// Every sent packet must either be delivered or counted as lost by the channel, every
+// delivered packet must be decoded unless it was corrupted and failed crc.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "loradv_config.h"
+#include "audio_codec_codec2.h"
+#include "bit_packer.h"
+#include "radio_device_sim.h"
+#include "voice_header.h"
+
+namespace LoraDv {
+
+static const int CfgPipelineTimeoutMs = 5000;     // wait for transmit done or delivery
+static const int CfgPacketBufferSize = 256;       // radio packet buffer length
+
+struct PipelineCase {
+  const char *name;
+  int packetCount;
+  float lossRate;
+  float bitErrorRate;
+  int latencyMs;
+  bool isAirTimeEnabled;
+  long bw;                // faster modulation keeps air time run short
+  int sf;
+};
+
+static const PipelineCase PipelineCases[] = {
+  { "ideal", 2000, 0.0f,  0.0f,    0, false, 125000, 7 },
+  { "lossy",   20, 0.1f,  0.0001f, 5, true,  250000, 7 },
+};
+
+// simulated devices signal the bench as interrupts would signal the radio task
+static std::atomic<int> pipelineTxDoneCount(0);
+static std::atomic<int> pipelineRxCount(0);
+
+static void pipelineTxIsr() { pipelineTxDoneCount++; }
+static void pipelineRxIsr() { pipelineRxCount++; }
+
+static bool waitCount(std::atomic<int> &counter, int count)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  while (counter.load() < count) {
+    if (benchNs(startTime) > 1e6 * CfgPipelineTimeoutMs) return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+static bool waitChannel(std::shared_ptr<RadioChannelSim> channel, long packetCount)
+{
+  auto startTime = std::chrono::steady_clock::now();
+  for (;;) {
+    RadioChannelStats stats = channel->getStats();
+    if (stats.delivered + stats.lost >= packetCount) return true;
+    if (benchNs(startTime) > 1e6 * CfgPipelineTimeoutMs) return false;
+    std::this_thread::yield();
+  }
+}
+
+static bool runPipelineCase(const PipelineCase &test)
+{
+  std::shared_ptr<Config> config = std::make_shared<Config>();
+  AudioCodecCodec2 txCodec, rxCodec;
+  if (!txCodec.start(config) || !rxCodec.start(config)) {
+    printf("{\"stage\":\"pipeline\",\"channel\":\"%s\",\"check\":\"codec_start_failed\"}\n", test.name);
+    return false;
+  }
+  int frameBits = txCodec.getFrameBits();
+  int framesPerPacket = 8 * (config->AudioMaxPktSize - VoiceHeader::CfgSize) / frameBits;
+  int pcmFrameSize = txCodec.getPcmFrameSize();
+  uint8_t codecId = VoiceHeader::getCodecId(config->AudioCodec, config->AudioCodec2Mode);
+
+  RadioChannelParams params = { test.lossRate, test.bitErrorRate, test.latencyMs, -90.0f, 5.0f, 2.0f,
+    test.isAirTimeEnabled };
+  std::shared_ptr<RadioChannelSim> channel = std::make_shared<RadioChannelSim>(params);
+  std::shared_ptr<RadioDeviceSim> tx = channel->createDevice();
+  std::shared_ptr<RadioDeviceSim> rx = channel->createDevice();
+  for (std::shared_ptr<RadioDeviceSim> device : { tx, rx }) {
+    device->beginLora(config->LoraFreqRx, test.bw, test.sf, config->LoraCodingRate, config->LoraPower,
+      config->LoraSync_, config->LoraCrc_, config->LoraPreambleLen_);
+  }
+  pipelineTxDoneCount = pipelineRxCount = 0;
+  tx->setIsr(pipelineTxIsr);
+  rx->setIsr(pipelineRxIsr);
+  rx->startReceive();
+
+  // tone with harmonics, so codec has something to model
+  std::vector<int16_t> pcm(framesPerPacket * pcmFrameSize);
+  for (size_t i = 0; i < pcm.size(); i++) {
+    float t = (float)i / txCodec.getSampleRate();
+    pcm[i] = (int16_t)(6000 * sinf(2 * M_PI * 200 * t) + 3000 * sinf(2 * M_PI * 600 * t));
+  }
+  std::vector<int16_t> pcmOut(framesPerPacket * pcmFrameSize);
+  uint8_t packet[CfgPacketBufferSize];
+  uint8_t frame[CfgPacketBufferSize];
+  VoiceStreamTracker tracker;
+  long decodedCount = 0, concealedCount = 0, rejectedCount = 0;
+  double latencyMs = 0;
+  bool isValid = true;
+
+  auto startTime = std::chrono::steady_clock::now();
+  for (int p = 0; p < test.packetCount && isValid; p++) {
+    auto txTime = std::chrono::steady_clock::now();
+    VoiceHeader::write(packet, codecId, (uint8_t)p, p == test.packetCount - 1);
+    // frames are packed one by one at bit position as the audio task does it
+    for (int i = 0; i < framesPerPacket; i++) {
+      txCodec.encode(frame, &pcm[i * pcmFrameSize]);
+      BitPacker::write(packet + VoiceHeader::CfgSize, i * frameBits, frame, frameBits);
+    }
+    int packetSize = VoiceHeader::CfgSize + BitPacker::getSize(framesPerPacket * frameBits);
+    isValid = tx->startTransmit(packet, packetSize) == RadioDevice::CfgErrNone
+      && waitCount(pipelineTxDoneCount, p + 1) && tx->finishTransmit() == RadioDevice::CfgErrNone
+      && waitChannel(channel, p + 1);
+    if (!isValid || pipelineRxCount.load() == 0) continue;
+    pipelineRxCount--;
+
+    // receive side as radio and audio tasks do it
+    uint8_t rxPacket[CfgPacketBufferSize];
+    int rxSize = rx->getPacketLength();
+    uint8_t rxCodecId, seq;
+    bool isEot;
+    if (rx->readData(rxPacket, rxSize) != RadioDevice::CfgErrNone
+      || !VoiceHeader::read(rxPacket, rxSize, rxCodecId, seq, isEot) || rxCodecId != codecId) {
+      rejectedCount++;
+      continue;
+    }
+    long lostBefore = tracker.getStats().lost;
+    if (!tracker.onPacket(seq)) continue;
+    for (long i = 0; i < (tracker.getStats().lost - lostBefore) * framesPerPacket; i++) {
+      rxCodec.conceal(pcmOut.data());
+      concealedCount++;
+    }
+    for (int i = 0; i < framesPerPacket; i++) {
+      BitPacker::read(rxPacket + VoiceHeader::CfgSize, i * frameBits, frame, frameBits);
+      rxCodec.decode(&pcmOut[i * pcmFrameSize], frame, rxCodec.getFrameSize());
+    }
+    decodedCount++;
+    latencyMs += benchNs(txTime) / 1e6;
+  }
+  double totalNs = benchNs(startTime);
+  txCodec.stop();
+  rxCodec.stop();
+
+  // corrupted packets fail crc on receive and are seen as lost by the voice stream
+  RadioChannelStats stats = channel->getStats();
+  isValid = isValid && stats.sent == test.packetCount && stats.delivered + stats.lost == stats.sent
+    && decodedCount + rejectedCount == stats.delivered && rejectedCount == stats.corrupted;
+  printf("{\"stage\":\"pipeline\",\"channel\":\"%s\",\"packets\":%d,\"delivered\":%ld,\"lost\":%ld,"
+    "\"corrupted\":%ld,\"decoded\":%ld,\"concealed_frames\":%ld,\"packets_per_s\":%.1f,\"tx_to_rx_ms\":%.2f,"
+    "\"check\":\"%s\"}\n", test.name, test.packetCount, stats.delivered, stats.lost, stats.corrupted, decodedCount,
+    concealedCount, 1e9 * test.packetCount / totalNs, decodedCount > 0 ? latencyMs / decodedCount : 0.0,
+    isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runPipelineBench()
+{
+  bool isValid = true;
+  for (const PipelineCase &test : PipelineCases) {
+    isValid = runPipelineCase(test) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
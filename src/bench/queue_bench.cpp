@@ -0,0 +1,168 @@
+// Radio packet queue benchmark, lock-free packet slots against the byte circular buffers
+// with a separate packet size queue which were used before. Also checks packet order and
+// content with producer and consumer on separate threads.
+// Codec switch while vox is listening leaves frames in the capture and pre-roll queues,
+// they are moved to the new arena slots only after the queues are cleared.
+//  - cycles_per_packet, ns_per_packet: one packet written and read back
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <CircularBuffer.h>
+
+#include "bench.h"
+#include "packet_queue.h"
+
+namespace LoraDv {
+
+static const int CfgQueueSlots = 8;               // radio task queue slots
+static const int CfgSlotSize = 256;               // radio packet buffer length
+static const int CfgByteQueueLen = 512;           // previous byte queue length
+static const int CfgBenchPackets = 200000;
+static const int CfgThreadPackets = 1000000;
+static const int PacketSizes[] = { 8, 48, 200 };
+static const int CfgCaptureSlots = 8;             // audio task capture queue slots
+static const int CfgPreRollSlots = 4;             // audio task pre-roll queue slots
+static const int CfgPreRollFrames = 3;            // default pre-roll frames
+static const int CfgVoxFrames = 10;               // frames heard before the codec switch
+
+static void printQueueResult(const char *name, int packetSize, uint64_t cycles, double ns)
+{
+  printf("{\"stage\":\"queue\",\"queue\":\"%s\",\"packet_bytes\":%d,\"cycles_per_packet\":%.1f,"
+    "\"ns_per_packet\":%.1f}\n", name, packetSize, (double)cycles / CfgBenchPackets, ns / CfgBenchPackets);
+}
+
+static uint32_t runByteQueue(int packetSize, uint8_t *packet)
+{
+  // same calls as the audio and radio tasks made, one per byte
+  static CircularBuffer<uint8_t, CfgByteQueueLen> queue;
+  static CircularBuffer<uint8_t, CfgByteQueueLen> queueIndex;
+  uint32_t checksum = 0;
+  for (int p = 0; p < CfgBenchPackets; p++) {
+    packet[0] = (uint8_t)p;
+    for (int i = 0; i < packetSize; i++) queue.push(packet[i]);
+    queueIndex.push(packetSize);
+    int size = queueIndex.shift();
+    for (int i = 0; i < size; i++) checksum += queue.shift();
+  }
+  return checksum;
+}
+
+static uint32_t runPacketQueue(int packetSize, uint8_t *packet)
+{
+  static PacketQueue<CfgQueueSlots, CfgSlotSize> queue;
+  uint32_t checksum = 0;
+  for (int p = 0; p < CfgBenchPackets; p++) {
+    packet[0] = (uint8_t)p;
+    uint8_t *slot = queue.writeBegin();
+    memcpy(slot, packet, packetSize);
+    queue.writeEnd(packetSize);
+    PacketView view;
+    if (!queue.readBegin(view)) return 0;
+    for (int i = 0; i < view.size; i++) checksum += view.data[i];
+    queue.readEnd();
+  }
+  return checksum;
+}
+
+static bool runQueueThreads()
+{
+  // sequence number and size are derived from the packet index, consumer checks both
+  static PacketQueue<CfgQueueSlots, CfgSlotSize> queue;
+  std::thread producer([]() {
+    for (uint32_t p = 0; p < (uint32_t)CfgThreadPackets; p++) {
+      uint8_t *slot;
+      while ((slot = queue.writeBegin()) == nullptr) std::this_thread::yield();
+      int size = 4 + p % (CfgSlotSize - 4);
+      memcpy(slot, &p, sizeof(p));
+      memset(slot + sizeof(p), (uint8_t)p, size - sizeof(p));
+      queue.writeEnd(size);
+    }
+  });
+  // all packets are read even after a mismatch, so producer does not block on the full queue
+  bool isValid = true;
+  for (uint32_t p = 0; p < (uint32_t)CfgThreadPackets; p++) {
+    PacketView view;
+    while (!queue.readBegin(view)) std::this_thread::yield();
+    uint32_t seq;
+    memcpy(&seq, view.data, sizeof(seq));
+    isValid = isValid && seq == p && view.size == (int)(4 + p % (CfgSlotSize - 4));
+    for (int i = sizeof(seq); isValid && i < view.size; i++) isValid = view.data[i] == (uint8_t)p;
+    queue.readEnd();
+  }
+  producer.join();
+  printf("{\"stage\":\"queue\",\"threads\":2,\"packets\":%d,\"order\":\"%s\"}\n",
+    CfgThreadPackets, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+// same steps as the audio task, vox listening, pending switch, stop codec and setup
+static bool runQueueReconfigure()
+{
+  static uint8_t storage[2 * (CfgCaptureSlots + CfgPreRollSlots) * CfgSlotSize];
+  PacketQueue<CfgCaptureSlots> captureQueue;
+  PacketQueue<CfgPreRollSlots> preRollQueue;
+  int oldSlotSize = CfgSlotSize / 2;
+  uint8_t *oldStorage = storage;
+  bool isValid = captureQueue.setup(oldStorage, oldSlotSize)
+    && preRollQueue.setup(oldStorage + captureQueue.getStorageSize(oldSlotSize), oldSlotSize);
+
+  uint8_t frame[CfgSlotSize];
+  PacketView view;
+  for (int f = 0; f < CfgVoxFrames; f++) {
+    memset(frame, f, oldSlotSize);
+    captureQueue.push(frame, oldSlotSize);
+    if (!captureQueue.readBegin(view)) break;
+    preRollQueue.push(view.data, view.size);
+    captureQueue.readEnd();
+    if (preRollQueue.size() > CfgPreRollFrames && preRollQueue.readBegin(view)) preRollQueue.readEnd();
+  }
+  // capture wrote one more frame before it stopped on the pending switch
+  captureQueue.push(frame, oldSlotSize);
+  int captureLeft = captureQueue.size();
+  int preRollLeft = preRollQueue.size();
+
+  // without clear the switch fails and the audio task shuts down
+  uint8_t *newStorage = storage + (CfgCaptureSlots + CfgPreRollSlots) * CfgSlotSize;
+  bool isRefused = !captureQueue.setup(newStorage, CfgSlotSize);
+  captureQueue.clear();
+  preRollQueue.clear();
+  isValid = isValid && isRefused && captureQueue.setup(newStorage, CfgSlotSize)
+    && preRollQueue.setup(newStorage + captureQueue.getStorageSize(CfgSlotSize), CfgSlotSize);
+
+  // queues work on the new slots
+  memset(frame, 0x5A, CfgSlotSize);
+  isValid = isValid && captureQueue.push(frame, CfgSlotSize) && captureQueue.readBegin(view)
+    && view.size == CfgSlotSize && view.data >= newStorage
+    && view.data < newStorage + captureQueue.getStorageSize(CfgSlotSize) && memcmp(view.data, frame, CfgSlotSize) == 0;
+  captureQueue.readEnd();
+  isValid = isValid && captureQueue.isEmpty() && preRollQueue.isEmpty();
+  printf("{\"stage\":\"queue\",\"case\":\"vox_reconfigure\",\"capture_left\":%d,\"preroll_left\":%d,"
+    "\"check\":\"%s\"}\n", captureLeft, preRollLeft, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runQueueBench()
+{
+  uint8_t packet[CfgSlotSize];
+  for (int i = 0; i < CfgSlotSize; i++) packet[i] = (uint8_t)(i * 7);
+  bool isValid = true;
+  for (int packetSize : PacketSizes) {
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t startCycles = benchCycles();
+    uint32_t byteChecksum = runByteQueue(packetSize, packet);
+    printQueueResult("byte", packetSize, benchCycles() - startCycles, benchNs(startTime));
+
+    startTime = std::chrono::steady_clock::now();
+    startCycles = benchCycles();
+    uint32_t packetChecksum = runPacketQueue(packetSize, packet);
+    printQueueResult("packet", packetSize, benchCycles() - startCycles, benchNs(startTime));
+    isValid = isValid && byteChecksum == packetChecksum;
+  }
+  isValid = runQueueThreads() && isValid;
+  isValid = runQueueReconfigure() && isValid;
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
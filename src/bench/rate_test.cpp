@@ -0,0 +1,127 @@
+// Rate controller decisions on a simulated link trace. Packets are lost when the trace snr
+// is below the demodulator limit of the recommended spreading factor or by random loss, so
+// controller runs in a closed loop as it does between two peers.
+//  - after every segment with steady snr the recommended profile must be the one which snr
+//    margin and hysteresis lead to from the profile the segment started with
+//  - heavy packet loss with good snr must move to a more robust profile
+//  - profile must not change more often than every few packets, alternating snr must not flap
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "air_time.h"
+#include "loradv_config.h"
+#include "rate_controller.h"
+
+namespace LoraDv {
+
+static const int CfgRateMinPacketsPerStep = 4;        // controller step interval
+static const float CfgRateSnrMarginDb = 3.0f;         // controller margin and hysteresis
+static const float CfgRateSnrHysteresisDb = 2.0f;
+
+enum RateExpect {
+  RateExpectSnr,        // settled on snr margin
+  RateExpectRobust,     // more robust than snr alone requires
+  RateExpectStable      // at most one change
+};
+
+struct RateSegment {
+  const char *name;
+  int packetCount;
+  float snr;
+  float snrSwing;       // snr alternates by +-swing every packet
+  float lossRate;
+  RateExpect expect;
+};
+
+static const RateSegment RateSegments[] = {
+  { "strong",  60,  10.0f, 0.0f, 0.0f, RateExpectSnr    },
+  { "fade",    80,  -8.0f, 0.0f, 0.0f, RateExpectSnr    },
+  { "deep",    80, -16.0f, 0.0f, 0.0f, RateExpectSnr    },
+  { "recover", 80,   4.0f, 0.0f, 0.0f, RateExpectSnr    },
+  { "loss",    60,  10.0f, 0.0f, 0.3f, RateExpectRobust },
+  { "clear",  120,  10.0f, 0.0f, 0.0f, RateExpectSnr    },
+  { "edge",   120,  -4.5f, 1.0f, 0.0f, RateExpectStable },
+};
+
+static int getSnrIndex(const RateController &controller, float snr, int index)
+{
+  // step to robust below margin, step to dense above margin and hysteresis
+  int count = controller.getProfileCount();
+  while (index + 1 < count && snr - AirTime::getLoraRequiredSnr(controller.getProfile(index).sf) < CfgRateSnrMarginDb)
+    index++;
+  while (index > 0 && snr - AirTime::getLoraRequiredSnr(controller.getProfile(index - 1).sf)
+    >= CfgRateSnrMarginDb + CfgRateSnrHysteresisDb)
+    index--;
+  return index;
+}
+
+bool runRateTest()
+{
+  Config config;
+  config.LoraBw = 250000;
+  config.LoraSf = 9;
+  RateController controller;
+  controller.setup(config);
+
+  // ladder goes from dense to robust
+  bool isValid = controller.getProfileCount() > 2 && controller.getRecommended() == controller.getBaseIndex();
+  for (int i = 0; i < controller.getProfileCount(); i++) {
+    const RateProfile &profile = controller.getProfile(i);
+    isValid = isValid && (i == 0 || profile.sf > controller.getProfile(i - 1).sf);
+    printf("{\"stage\":\"rate\",\"profile\":%d,\"sf\":%d,\"mode\":%d,\"base\":%d}\n",
+      i, profile.sf, profile.codecMode, i == controller.getBaseIndex());
+  }
+
+  uint32_t state = 0x2545F491u;
+  int packet = 0, lastStepPacket = -CfgRateMinPacketsPerStep;
+  for (const RateSegment &segment : RateSegments) {
+    int startIndex = controller.getRecommended();
+    int changeCount = 0, deliveredCount = 0;
+    bool isStepValid = true;
+    for (int p = 0; p < segment.packetCount; p++, packet++) {
+      float snr = segment.snr + ((p & 1) ? -segment.snrSwing : segment.snrSwing);
+      int index = controller.getRecommended();
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      bool isLost = snr < AirTime::getLoraRequiredSnr(controller.getProfile(index).sf)
+        || (float)(state >> 8) / (float)(1 << 24) < segment.lossRate;
+      if (isLost) {
+        controller.onPacketLost(1);
+      } else {
+        controller.onPacketReceived(snr);
+        deliveredCount++;
+      }
+      if (controller.getRecommended() != index) {
+        isStepValid = isStepValid && packet - lastStepPacket >= CfgRateMinPacketsPerStep;
+        lastStepPacket = packet;
+        changeCount++;
+      }
+    }
+    int index = controller.getRecommended();
+    int snrIndex = getSnrIndex(controller, segment.snr, startIndex);
+    bool isMatching = isStepValid;
+    switch (segment.expect) {
+      case RateExpectSnr:
+        isMatching = isMatching && index == snrIndex;
+        break;
+      case RateExpectRobust:
+        isMatching = isMatching && index > snrIndex;
+        break;
+      case RateExpectStable:
+        isMatching = isMatching && changeCount <= 1;
+        break;
+    }
+    printf("{\"stage\":\"rate\",\"segment\":\"%s\",\"snr\":%.1f,\"loss\":%.2f,\"packets\":%d,\"delivered\":%d,"
+      "\"profile\":%d,\"expected\":%d,\"sf\":%d,\"mode\":%d,\"changes\":%d,\"check\":\"%s\"}\n",
+      segment.name, segment.snr, segment.lossRate, segment.packetCount, deliveredCount, index, snrIndex,
+      controller.getProfile(index).sf, controller.getProfile(index).codecMode, changeCount,
+      isMatching ? "ok" : "mismatch");
+    isValid = isValid && isMatching;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
@@ -0,0 +1,89 @@
+// Resampler benchmark between i2s and codec rates in both directions. A 1 kHz tone is processed
+// in 20 ms frames as capture and playback do it, so state is carried between calls.
+//  - cycles_per_in_sample, cycles_per_out_sample: cost of one sample of the call input and output
+//  - every frame must produce the exact output count and the tone must pass with unity gain
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "resampler.h"
+
+namespace LoraDv {
+
+static const int CfgResamplerFrameMs = 20;
+static const int CfgResamplerFrames = 2000;
+static const int CfgResamplerSettleFrames = 10;   // filter delay line fills up
+static const float CfgResamplerTonePeak = 16000.0f;
+static const float CfgResamplerMaxGainDb = 0.5f;
+static const int ResamplerI2sRates[] = { 16000, 48000 };
+static const int ResamplerCodecRates[] = { 8000, 12000, 16000, 24000, 48000 };
+
+static bool isResamplerI2sRate(int rate)
+{
+  for (int i2sRate : ResamplerI2sRates) {
+    if (rate == i2sRate) return true;
+  }
+  return false;
+}
+
+static float getResamplerTone(const std::vector<int16_t> &pcm, int start, int rate)
+{
+  double re = 0, im = 0;
+  for (size_t i = start; i < pcm.size(); i++) {
+    double phase = 2 * M_PI * 1000 * i / rate;
+    re += pcm[i] * cos(phase);
+    im += pcm[i] * sin(phase);
+  }
+  return 2 * sqrt(re * re + im * im) / (pcm.size() - start);
+}
+
+static bool runResamplerRates(int inRate, int outRate)
+{
+  Resampler resampler;
+  if (!resampler.setup(inRate, outRate)) {
+    printf("{\"stage\":\"resampler\",\"in_rate\":%d,\"out_rate\":%d,\"check\":\"unsupported\"}\n", inRate, outRate);
+    return false;
+  }
+  int inFrameSize = inRate * CfgResamplerFrameMs / 1000;
+  int outFrameSize = outRate * CfgResamplerFrameMs / 1000;
+  std::vector<int16_t> in(inFrameSize * CfgResamplerFrames);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = (int16_t)(CfgResamplerTonePeak * sin(2 * M_PI * 1000 * i / inRate));
+  }
+  std::vector<int16_t> out(outFrameSize * CfgResamplerFrames);
+  uint64_t cycles = 0;
+  bool isExact = true;
+  for (int f = 0; f < CfgResamplerFrames; f++) {
+    uint64_t startCycles = benchCycles();
+    int outCount = resampler.process(&in[f * inFrameSize], inFrameSize, &out[f * outFrameSize], outFrameSize);
+    cycles += benchCycles() - startCycles;
+    isExact = isExact && outCount == outFrameSize;
+  }
+
+  float gainDb = 20 * log10f(getResamplerTone(out, CfgResamplerSettleFrames * outFrameSize, outRate)
+    / CfgResamplerTonePeak);
+  bool isValid = isExact && fabsf(gainDb) <= CfgResamplerMaxGainDb;
+  printf("{\"stage\":\"resampler\",\"in_rate\":%d,\"out_rate\":%d,\"cycles_per_in_sample\":%.2f,"
+    "\"cycles_per_out_sample\":%.2f,\"tone_gain_db\":%.2f,\"check\":\"%s\"}\n", inRate, outRate,
+    (double)cycles / in.size(), (double)cycles / out.size(), gainDb, isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runResamplerCycleBench()
+{
+  bool isValid = true;
+  for (int i2sRate : ResamplerI2sRates) {
+    for (int codecRate : ResamplerCodecRates) {
+      // pairs of two i2s rates run once, from the lower one
+      if (codecRate == i2sRate || (codecRate < i2sRate && isResamplerI2sRate(codecRate))) continue;
+      isValid = runResamplerRates(i2sRate, codecRate) && isValid;
+      isValid = runResamplerRates(codecRate, i2sRate) && isValid;
+    }
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
@@ -0,0 +1,27 @@
+#ifndef BENCH_ARDUINO_H
+#define BENCH_ARDUINO_H
+
+// Minimal host replacement of the Arduino core for the native benchmark build,
+// only what configuration and codec sources need.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+
+#define SS                          5           // esp32 default spi chip select
+
+using std::min;
+using std::max;
+
+// host heap is not reported
+#define MALLOC_CAP_8BIT             (1 << 2)
+
+inline uint32_t esp_get_free_heap_size() { return 0; }
+inline uint32_t esp_get_minimum_free_heap_size() { return 0; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 0; }
+
+#endif // BENCH_ARDUINO_H
@@ -0,0 +1,27 @@
+#ifndef BENCH_PREFERENCES_H
+#define BENCH_PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Host replacement of the ESP32 preferences storage, nothing is persisted,
+// so configuration always keeps its defaults.
+class Preferences {
+
+public:
+  bool begin(const char *name, bool isReadOnly = false) { return true; }
+  void end() {}
+  bool isKey(const char *key) { return false; }
+
+  int32_t getInt(const char *key, int32_t defaultValue = 0) { return defaultValue; }
+  long getLong(const char *key, long defaultValue = 0) { return defaultValue; }
+  float getFloat(const char *key, float defaultValue = 0) { return defaultValue; }
+  bool getBool(const char *key, bool defaultValue = false) { return defaultValue; }
+
+  size_t putInt(const char *key, int32_t value) { return 0; }
+  size_t putLong(const char *key, long value) { return 0; }
+  size_t putFloat(const char *key, float value) { return 0; }
+  size_t putBool(const char *key, bool value) { return 0; }
+};
+
+#endif // BENCH_PREFERENCES_H
@@ -0,0 +1,9 @@
+#ifndef BENCH_RADIOLIB_H
+#define BENCH_RADIOLIB_H
+
+// Host replacement of the radio library, only constants used by default configuration.
+
+#define RADIOLIB_NC                 (0xFF)
+#define RADIOLIB_SHAPING_NONE       (0x00)
+
+#endif // BENCH_RADIOLIB_H
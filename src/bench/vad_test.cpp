@@ -0,0 +1,144 @@
+// Voice activity detector check on labelled synthetic clips. Every clip is a sequence of speech,
+// silence and click segments over background noise, frames are 40 ms as codec2 captures them
+// and the detector uses the default vox hang time and pre-roll.
+//  - speech onset is detected within the pre-roll, so the first syllable is sent
+//  - detection does not drop within speech or in word gaps shorter than the hang time
+//  - silence is not detected after the hang time, single clicks do not start speech
+//  - slowly rising background noise is followed by the floor without detection
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "config.h"
+#include "voice_activity.h"
+
+namespace LoraDv {
+
+static const int CfgVadSampleRate = 8000;
+static const int CfgVadFrameMs = 40;
+static const int CfgVadFrameSize = CfgVadSampleRate * CfgVadFrameMs / 1000;
+static const int CfgVadHangFrames = (CFG_AUDIO_VOX_HANG_MS + CfgVadFrameMs - 1) / CfgVadFrameMs;
+static const int CfgVadPreRollFrames = (CFG_AUDIO_VOX_PREROLL_MS + CfgVadFrameMs - 1) / CfgVadFrameMs;
+
+enum VadLabel {
+  VadSilence,
+  VadSpeech,
+  VadClick                // one loud frame, labelled as silence
+};
+
+struct VadSegment {
+  VadLabel label;
+  int durationMs;
+};
+
+struct VadClip {
+  const char *name;
+  float speechPeak;
+  float noiseStart;       // background amplitude, changes linearly over the clip
+  float noiseEnd;
+  const VadSegment *segments;
+  int segmentCount;
+};
+
+static const VadSegment VadConversation[] = {
+  { VadSilence, 2000 }, { VadSpeech, 1480 }, { VadSilence, 320 }, { VadSpeech, 1200 },
+  { VadSilence, 2000 }, { VadClick, 40 }, { VadSilence, 1500 }, { VadSpeech, 800 }, { VadSilence, 1500 },
+};
+
+static const VadSegment VadRamp[] = {
+  { VadSilence, 8000 }, { VadSpeech, 1200 }, { VadSilence, 1500 },
+};
+
+static const VadClip VadClips[] = {
+  { "quiet",  6000.0f,   40.0f,   40.0f, VadConversation, sizeof(VadConversation) / sizeof(VadSegment) },
+  { "soft",   1200.0f,   40.0f,   40.0f, VadConversation, sizeof(VadConversation) / sizeof(VadSegment) },
+  { "noisy", 12000.0f,  800.0f,  800.0f, VadConversation, sizeof(VadConversation) / sizeof(VadSegment) },
+  { "ramp",   8000.0f,   40.0f,  400.0f, VadRamp,         sizeof(VadRamp) / sizeof(VadSegment) },
+};
+
+static void makeVadClip(const VadClip &clip, std::vector<int16_t> &pcm, std::vector<VadLabel> &labels)
+{
+  int frameCount = 0;
+  for (int s = 0; s < clip.segmentCount; s++) frameCount += clip.segments[s].durationMs / CfgVadFrameMs;
+  pcm.resize(frameCount * CfgVadFrameSize);
+  labels.clear();
+  uint32_t state = 0xC2B2AE35u;
+  int i = 0;
+  for (int s = 0; s < clip.segmentCount; s++) {
+    const VadSegment &segment = clip.segments[s];
+    int segmentSize = segment.durationMs / CfgVadFrameMs * CfgVadFrameSize;
+    for (int j = 0; j < segmentSize; j++, i++) {
+      if (j % CfgVadFrameSize == 0) labels.push_back(segment.label);
+      float t = (float)j / CfgVadSampleRate;
+      float noiseLevel = clip.noiseStart + (clip.noiseEnd - clip.noiseStart) * i / pcm.size();
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      float sample = noiseLevel * ((float)(state >> 8) / (float)(1 << 23) - 1.0f);
+      if (segment.label == VadSpeech) {
+        // syllables within the segment, soft consonants between them are still above the floor
+        float envelope = 0.55f + 0.45f * sinf(2 * M_PI * 4 * t - M_PI / 2);
+        float phase = 2 * M_PI * 130 * t;
+        sample += clip.speechPeak * envelope * (0.6f * sinf(phase) + 0.3f * sinf(3 * phase) + 0.1f * sinf(9 * phase));
+      } else if (segment.label == VadClick) {
+        sample += (j / 4) % 2 ? 20000 : -20000;
+      }
+      pcm[i] = (int16_t)fmaxf(fminf(sample, 32767), -32768);
+    }
+  }
+}
+
+static bool runVadClip(const VadClip &clip)
+{
+  std::vector<int16_t> pcm;
+  std::vector<VadLabel> labels;
+  makeVadClip(clip, pcm, labels);
+  VoiceActivityDetector vad;
+  vad.setup(CfgVadFrameMs, CFG_AUDIO_VOX_HANG_MS);
+
+  int speechFrames = 0, silenceFrames = 0, missedFrames = 0, cutFrames = 0, falseFrames = 0;
+  int onsetFrames = 0, maxOnsetFrames = 0, sinceSpeechFrames = CfgVadHangFrames + 1;
+  bool isDetected = false;
+  for (size_t f = 0; f < labels.size(); f++) {
+    bool isActive = vad.process(&pcm[f * CfgVadFrameSize], CfgVadFrameSize);
+    if (labels[f] == VadSpeech) {
+      // frames before detection are sent from the pre-roll, after it detection must hold
+      if (f == 0 || labels[f - 1] != VadSpeech) {
+        isDetected = false;
+        onsetFrames = 0;
+      }
+      if (!isDetected && isActive) isDetected = true;
+      else if (!isDetected) onsetFrames++;
+      else if (!isActive) missedFrames++;
+      if (onsetFrames > maxOnsetFrames) maxOnsetFrames = onsetFrames;
+      speechFrames++;
+      sinceSpeechFrames = 0;
+    } else if (++sinceSpeechFrames > CfgVadHangFrames) {
+      silenceFrames++;
+      if (isActive) falseFrames++;
+    } else if (!isActive && sinceSpeechFrames <= CfgVadHangFrames / 2) {
+      // speech level frames could end before the segment, so only the first half of the hang is checked
+      cutFrames++;
+    }
+  }
+  bool isValid = maxOnsetFrames <= CfgVadPreRollFrames && missedFrames == 0 && cutFrames == 0 && falseFrames == 0;
+  printf("{\"stage\":\"vad\",\"clip\":\"%s\",\"speech_frames\":%d,\"silence_frames\":%d,\"missed\":%d,"
+    "\"cut\":%d,\"false\":%d,\"max_onset_frames\":%d,\"preroll_frames\":%d,\"noise_level\":%d,\"check\":\"%s\"}\n",
+    clip.name, speechFrames, silenceFrames, missedFrames, cutFrames, falseFrames, maxOnsetFrames,
+    CfgVadPreRollFrames, (int)vad.getNoiseLevel(), isValid ? "ok" : "mismatch");
+  return isValid;
+}
+
+bool runVadTest()
+{
+  bool isValid = true;
+  for (const VadClip &clip : VadClips) {
+    isValid = runVadClip(clip) && isValid;
+  }
+  fflush(stdout);
+  return isValid;
+}
+
+} // LoraDv
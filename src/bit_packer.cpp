@@ -0,0 +1,38 @@
+#include <string.h>
+
+#include "bit_packer.h"
+
+namespace LoraDv {
+
+void BitPacker::write(uint8_t *data, int bitPos, const uint8_t *frame, int bitCount)
+{
+  if ((bitPos & 7) == 0 && (bitCount & 7) == 0) {
+    memcpy(data + (bitPos >> 3), frame, bitCount >> 3);
+    return;
+  }
+  for (int i = 0; i < bitCount; i++) {
+    int pos = bitPos + i;
+    uint8_t mask = 0x80 >> (pos & 7);
+    if (frame[i >> 3] & (0x80 >> (i & 7))) 
+      data[pos >> 3] |= mask;
+    else
+      data[pos >> 3] &= ~mask;
+  }
+  int endPos = bitPos + bitCount;
+  if (endPos & 7) data[endPos >> 3] &= (uint8_t)(0xFF << (8 - (endPos & 7)));
+}
+
+void BitPacker::read(const uint8_t *data, int bitPos, uint8_t *frame, int bitCount)
+{
+  if ((bitPos & 7) == 0 && (bitCount & 7) == 0) {
+    memcpy(frame, data + (bitPos >> 3), bitCount >> 3);
+    return;
+  }
+  memset(frame, 0, getSize(bitCount));
+  for (int i = 0; i < bitCount; i++) {
+    int pos = bitPos + i;
+    if (data[pos >> 3] & (0x80 >> (pos & 7))) frame[i >> 3] |= 0x80 >> (i & 7);
+  }
+}
+
+} // LoraDv
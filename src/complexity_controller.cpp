@@ -0,0 +1,72 @@
+#include "complexity_controller.h"
+
+namespace LoraDv {
+
+ComplexityController::ComplexityController()
+  : frameCycles_(0)
+  , budgetCycles_(0)
+  , peakCycles_(0)
+  , complexity_(CfgMinComplexity)
+  , calmFrames_(0)
+  , raiseFrames_(CfgRaiseFrames)
+  , stats_()
+{
+}
+
+void ComplexityController::setup(uint32_t frameCycles, int complexity)
+{
+  frameCycles_ = frameCycles;
+  budgetCycles_ = frameCycles / 100 * CfgBudgetPercent;
+  if (complexity < CfgMinComplexity) complexity = CfgMinComplexity;
+  if (complexity > CfgMaxComplexity) complexity = CfgMaxComplexity;
+  complexity_ = complexity;
+  reset();
+}
+
+void ComplexityController::reset()
+{
+  peakCycles_ = 0;
+  calmFrames_ = 0;
+  raiseFrames_ = CfgRaiseFrames;
+  resetStats();
+}
+
+void ComplexityController::resetStats()
+{
+  stats_ = ComplexityStats();
+  stats_.complexity = complexity_;
+}
+
+bool ComplexityController::update(uint32_t cycles)
+{
+  stats_.frames++;
+  if (cycles > stats_.maxCycles) stats_.maxCycles = cycles;
+  if (cycles > frameCycles_) stats_.overruns++;
+
+  // peak jumps up with slow frames and decays slowly, so rare spikes are remembered
+  peakCycles_ -= peakCycles_ >> CfgPeakDecayShift;
+  if (cycles > peakCycles_) peakCycles_ = cycles;
+
+  if (cycles > budgetCycles_) {
+    calmFrames_ = 0;
+    if (complexity_ == CfgMinComplexity) return false;
+    // far over the budget drops faster, real time must be kept
+    complexity_ -= cycles > frameCycles_ && complexity_ > CfgMinComplexity + 1 ? 2 : 1;
+    if (raiseFrames_ < CfgMaxRaiseFrames) raiseFrames_ *= 2;
+    stats_.lowered++;
+    stats_.complexity = complexity_;
+    return true;
+  }
+  if (peakCycles_ > budgetCycles_ / 100 * CfgRaisePercent || complexity_ == CfgMaxComplexity) {
+    calmFrames_ = 0;
+    return false;
+  }
+  if (++calmFrames_ < raiseFrames_) return false;
+  calmFrames_ = 0;
+  complexity_++;
+  stats_.raised++;
+  stats_.complexity = complexity_;
+  return true;
+}
+
+} // LoraDv
@@ -0,0 +1,124 @@
+#include "decoder_cache.h"
+
+#include "audio_codec_codec2.h"
+#include "audio_codec_opus.h"
+#include "air_time.h"
+#include "opus_superframe.h"
+#include "voice_header.h"
+
+namespace LoraDv {
+
+DecoderCache::DecoderCache()
+  : config_(nullptr)
+  , sampleRate_(0)
+  , entries_()
+{
+}
+
+DecoderCache::~DecoderCache()
+{
+  clear();
+}
+
+void DecoderCache::setup(std::shared_ptr<const Config> config, int sampleRate)
+{
+  clear();
+  config_ = config;
+  sampleRate_ = sampleRate;
+}
+
+void DecoderCache::clear()
+{
+  for (int i = 0; i < CfgMaxDecoders; i++) {
+    if (entries_[i].codec) release(entries_[i]);
+  }
+}
+
+std::shared_ptr<AudioCodec> DecoderCache::get(uint8_t codecId, uint32_t now)
+{
+  // free slot or the least recently used one
+  Entry *slot = &entries_[0];
+  for (int i = 0; i < CfgMaxDecoders; i++) {
+    Entry &entry = entries_[i];
+    if (entry.codec && entry.codecId == codecId) {
+      entry.lastUsedMs = now;
+      return entry.codec;
+    }
+    if (!slot->codec) continue;
+    if (!entry.codec || (int32_t)(entry.lastUsedMs - slot->lastUsedMs) < 0) slot = &entry;
+  }
+  std::shared_ptr<AudioCodec> codec = create(codecId);
+  if (!codec) return codec;
+  if (!codec->startDecoder(config_, codecId, sampleRate_)) {
+    codec->stop();
+    return nullptr;
+  }
+  if (slot->codec) release(*slot);
+  slot->codec = codec;
+  slot->codecId = codecId;
+  slot->lastUsedMs = now;
+  LOG_INFO("Decoder created, codec", codecId);
+  return codec;
+}
+
+void DecoderCache::evict(uint32_t now)
+{
+  for (int i = 0; i < CfgMaxDecoders; i++) {
+    Entry &entry = entries_[i];
+    if (entry.codec && now - entry.lastUsedMs >= CfgIdleMs) release(entry);
+  }
+}
+
+int DecoderCache::getEvictWaitMs(uint32_t now) const
+{
+  int waitMs = -1;
+  for (int i = 0; i < CfgMaxDecoders; i++) {
+    const Entry &entry = entries_[i];
+    if (!entry.codec) continue;
+    uint32_t idleMs = now - entry.lastUsedMs;
+    int entryWaitMs = idleMs >= CfgIdleMs ? 0 : (int)(CfgIdleMs - idleMs);
+    if (waitMs < 0 || entryWaitMs < waitMs) waitMs = entryWaitMs;
+  }
+  return waitMs;
+}
+
+uint8_t DecoderCache::detectCodec(const Config &config, int codecMode, const uint8_t *packet, int packetSize)
+{
+  // raw packets as codec2_talkie sends them, other codec is assumed only if the own one could not produce the packet
+  uint8_t codecId = VoiceHeader::getCodecId(config.AudioCodec, codecMode);
+  // fec parity packets and implicit header padding do not follow codec framing, so these are always own
+  bool isFec = config.AudioCodec == CFG_AUDIO_CODEC_CODEC2 && config.AudioFecDepth > 0;
+  if (isFec || AirTime::isLoraImplicitHeader(config)) return codecId;
+  if (config.AudioCodec == CFG_AUDIO_CODEC_CODEC2) {
+    // whole frames, padded bit-packed superframes have any size
+    int bytesPerFrame = AirTime::getCodec2FrameSize(codecMode);
+    int bitsPerFrame = config.AudioCodec2BitPack ? AirTime::getCodec2FrameBits(codecMode) : 8 * bytesPerFrame;
+    bool isOwn = bytesPerFrame == 0 || bitsPerFrame < 8 * bytesPerFrame || packetSize % bytesPerFrame == 0;
+    if (!isOwn && OpusSuperframe::isValidPacket(packet, packetSize)) return VoiceHeader::CfgCodecOpus;
+  } else if (!OpusSuperframe::isValidPacket(packet, packetSize)) {
+    // codec2 station is expected to use the configured mode
+    int frameSize = AirTime::getCodec2FrameSize(config.AudioCodec2Mode);
+    if (frameSize > 0 && packetSize % frameSize == 0) return config.AudioCodec2Mode;
+  }
+  return codecId;
+}
+
+std::shared_ptr<AudioCodec> DecoderCache::create(uint8_t codecId)
+{
+  // codec id is the codec2 mode for codec2 streams
+  if (codecId == VoiceHeader::CfgCodecOpus) 
+    return std::shared_ptr<AudioCodec>(new AudioCodecOpus());
+  if (AirTime::getCodec2FrameSize(codecId) > 0) 
+    return std::shared_ptr<AudioCodec>(new AudioCodecCodec2());
+  return nullptr;
+}
+
+void DecoderCache::release(Entry &entry)
+{
+  // caller must not hold the decoder any more, codecs are freed by stop
+  LOG_INFO("Decoder freed, codec", entry.codecId);
+  entry.codec->stop();
+  entry.codec.reset();
+}
+
+} // LoraDv
@@ -0,0 +1,147 @@
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#include "heap_arena.h"
+#include "loradv_config.h"
+
+namespace {
+
+// operator new calls since boot, constant initialized, so it counts before static constructors too
+std::atomic<uint32_t> allocCount_(0);
+
+} // namespace
+
+void *operator new(size_t size)
+{
+  allocCount_.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = malloc(size);
+  if (ptr == nullptr) abort();
+  return ptr;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  free(ptr);
+}
+
+// library nothrow versions call malloc directly, so they are replaced to be counted too
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  allocCount_.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+  free(ptr);
+}
+
+// sized versions are used with c++14 sized deallocation, memory is freed the same way
+void operator delete(void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+namespace LoraDv {
+
+HeapArena::HeapArena(const char *name)
+  : name_(name)
+  , block_(nullptr)
+  , size_(0)
+  , used_(0)
+  , peak_(0)
+{
+}
+
+HeapArena::~HeapArena()
+{
+  release();
+}
+
+bool HeapArena::reserve(size_t size)
+{
+  used_ = 0;
+  if (size <= size_) return true;
+  // never reallocated after start, heap could be too fragmented by then
+  if (block_ != nullptr) {
+    LOG_ERROR("Heap arena is too small", name_, size_, size);
+    return false;
+  }
+  block_ = (uint8_t*)malloc(size);
+  if (block_ == nullptr) {
+    LOG_ERROR("Failed to reserve heap arena", name_, size);
+    return false;
+  }
+  size_ = size;
+  return true;
+}
+
+void HeapArena::reset()
+{
+  used_ = 0;
+}
+
+void HeapArena::release()
+{
+  free(block_);
+  block_ = nullptr;
+  size_ = 0;
+  used_ = 0;
+}
+
+void *HeapArena::allocate(size_t size)
+{
+  size_t blockSize = getBlockSize(size);
+  if (used_ + blockSize > size_) {
+    LOG_ERROR("Heap arena is exhausted", name_, used_, size);
+    return nullptr;
+  }
+  void *ptr = block_ + used_;
+  used_ += blockSize;
+  if (used_ > peak_) peak_ = used_;
+  return ptr;
+}
+
+void HeapArena::logReport() const
+{
+  LOG_INFO("Heap arena", name_, "size", size_, "used", used_, "peak", peak_);
+}
+
+uint32_t HeapArena::getAllocCount()
+{
+  return allocCount_.load(std::memory_order_relaxed);
+}
+
+void HeapArena::logHeap()
+{
+  LOG_INFO("Heap free", esp_get_free_heap_size(), "min free", esp_get_minimum_free_heap_size(),
+    "largest block", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT), "allocations", getAllocCount());
+}
+
+} // LoraDv
@@ -0,0 +1,222 @@
+#include <string.h>
+
+#include "jitter_buffer.h"
+
+namespace LoraDv {
+
+JitterBuffer::JitterBuffer()
+  : frameMs_(0)
+  , storage_(nullptr)
+  , head_(0)
+  , frameCount_(0)
+  , writePos_(0)
+  , usedBytes_(0)
+  , isPlaying_(false)
+  , isEndOfStream_(false)
+  , isSilence_(false)
+  , silenceInRow_(0)
+  , firstFrameMs_(0)
+  , concealedInRow_(0)
+  , hasArrival_(false)
+  , lastArrivalMs_(0)
+  , lastBurstMs_(0)
+  , maxBurstMs_(0)
+  , burstFrames_(0)
+  , jitterMs16_(0)
+  , stats_()
+{
+}
+
+void JitterBuffer::setup(int frameMs, uint8_t *storage)
+{
+  frameMs_ = frameMs;
+  storage_ = storage;
+  jitterMs16_ = 0;
+  reset();
+}
+
+void JitterBuffer::reset()
+{
+  head_ = 0;
+  frameCount_ = 0;
+  writePos_ = 0;
+  usedBytes_ = 0;
+  isPlaying_ = false;
+  isEndOfStream_ = false;
+  isSilence_ = false;
+  silenceInRow_ = 0;
+  concealedInRow_ = 0;
+  hasArrival_ = false;
+  lastBurstMs_ = 0;
+  maxBurstMs_ = 0;
+  burstFrames_ = 0;
+  // jitter is a property of the link, so it is kept between streams
+  stats_.underruns = 0;
+  stats_.overruns = 0;
+  stats_.concealed = 0;
+  updateTargetDelay();
+}
+
+bool JitterBuffer::allocate(int frameSize, int &offset)
+{
+  if (usedBytes_ == 0) writePos_ = 0;
+  int freeBytes = CfgBufferSize - usedBytes_;
+  // frame is never split, storage tail is skipped if it does not fit
+  if (frameSize <= freeBytes && writePos_ + frameSize <= CfgBufferSize) {
+    offset = writePos_;
+    return true;
+  }
+  if (CfgBufferSize - writePos_ + frameSize <= freeBytes) {
+    offset = 0;
+    return true;
+  }
+  return false;
+}
+
+void JitterBuffer::onSilence()
+{
+  if (!isPlaying_) return;
+  isSilence_ = true;
+  silenceInRow_ = 0;
+}
+
+void JitterBuffer::onTalkSpurt()
+{
+  if (!isSilence_) return;
+  // next talk spurt is buffered from scratch as a new stream
+  isSilence_ = false;
+  if (frameCount_ == 0) {
+    isPlaying_ = false;
+    hasArrival_ = false;
+  }
+}
+
+bool JitterBuffer::push(const uint8_t *frame, int frameSize)
+{
+  if (frameSize <= 0 || frameSize > CfgBufferSize) return false;
+  onTalkSpurt();
+  int offset = 0;
+  while (frameCount_ == CfgMaxFrames || !allocate(frameSize, offset)) {
+    dropOldest();
+  }
+  Entry &entry = entries_[(head_ + frameCount_) % CfgMaxFrames];
+  entry.offset = offset;
+  entry.size = frameSize;
+  entry.span = frameSize + (offset == writePos_ ? 0 : CfgBufferSize - writePos_);
+  memcpy(storage_ + offset, frame, frameSize);
+  writePos_ = offset + frameSize;
+  usedBytes_ += entry.span;
+  frameCount_++;
+  burstFrames_++;
+  return true;
+}
+
+bool JitterBuffer::pushErased()
+{
+  onTalkSpurt();
+  if (frameCount_ == CfgMaxFrames) dropOldest();
+  Entry &entry = entries_[(head_ + frameCount_) % CfgMaxFrames];
+  entry.offset = writePos_;
+  entry.size = 0;
+  entry.span = 0;
+  frameCount_++;
+  burstFrames_++;
+  return true;
+}
+
+void JitterBuffer::pushLost(int frameCount)
+{
+  int skipCount = frameCount < concealedInRow_ ? frameCount : concealedInRow_;
+  concealedInRow_ -= skipCount;
+  for (int i = skipCount; i < frameCount; i++) {
+    pushErased();
+  }
+}
+
+void JitterBuffer::dropOldest()
+{
+  if (frameCount_ == 0) return;
+  usedBytes_ -= entries_[head_].span;
+  head_ = (head_ + 1) % CfgMaxFrames;
+  frameCount_--;
+  stats_.overruns++;
+}
+
+void JitterBuffer::onArrival(uint32_t nowMs)
+{
+  int burstMs = burstFrames_ * frameMs_;
+  burstFrames_ = 0;
+  if (hasArrival_) {
+    // deviation from the expected arrival, which is the previous burst duration
+    int deviationMs = (int32_t)(nowMs - lastArrivalMs_) - lastBurstMs_;
+    if (deviationMs < 0) deviationMs = -deviationMs;
+    if (deviationMs > CfgMaxDelayMs) deviationMs = CfgMaxDelayMs;
+    jitterMs16_ += deviationMs - (jitterMs16_ >> CfgJitterGainShift);
+  } else {
+    firstFrameMs_ = nowMs;
+  }
+  hasArrival_ = true;
+  lastArrivalMs_ = nowMs;
+  lastBurstMs_ = burstMs;
+  if (burstMs > maxBurstMs_) maxBurstMs_ = burstMs;
+  updateTargetDelay();
+}
+
+void JitterBuffer::updateTargetDelay()
+{
+  stats_.jitterMs = jitterMs16_ >> CfgJitterGainShift;
+  int delayMs = CfgJitterFactor * stats_.jitterMs + frameMs_;
+  stats_.targetDelayMs = delayMs > CfgMaxDelayMs ? CfgMaxDelayMs : delayMs;
+}
+
+JitterBuffer::Frame JitterBuffer::pop(uint32_t nowMs, const uint8_t *&frame, int &frameSize)
+{
+  if (!isPlaying_) {
+    if (frameCount_ == 0) return Frame::None;
+    if (!isEndOfStream_ && (int32_t)(nowMs - firstFrameMs_) < stats_.targetDelayMs) return Frame::None;
+    isPlaying_ = true;
+    concealedInRow_ = 0;
+  }
+  // sender backlog arrives faster than real time, drop frames to bound the latency
+  int maxBufferedMs = maxBurstMs_ + 2 * stats_.targetDelayMs + frameMs_;
+  while (!isEndOfStream_ && frameCount_ > 1 && frameCount_ * frameMs_ > maxBufferedMs) {
+    dropOldest();
+  }
+  if (frameCount_ > 0) {
+    const Entry &entry = entries_[head_];
+    usedBytes_ -= entry.span;
+    head_ = (head_ + 1) % CfgMaxFrames;
+    frameCount_--;
+    if (entry.size == 0) {
+      stats_.concealed++;
+      return Frame::Conceal;
+    }
+    concealedInRow_ = 0;
+    frame = storage_ + entry.offset;
+    frameSize = entry.size;
+    return Frame::Audio;
+  }
+  // sender paused, stream lasts while silence updates come
+  if (isSilence_ && !isEndOfStream_ && ++silenceInRow_ * frameMs_ < CfgSilenceTimeoutMs) {
+    return Frame::Silence;
+  }
+  // stream is over, either by its end marker or when nothing comes for too long
+  if (isEndOfStream_ || isSilence_ || concealedInRow_ * frameMs_ >= CfgStreamTimeoutMs) {
+    isPlaying_ = false;
+    return Frame::None;
+  }
+  concealedInRow_++;
+  stats_.underruns++;
+  stats_.concealed++;
+  return Frame::Conceal;
+}
+
+bool JitterBuffer::peek(const uint8_t *&frame, int &frameSize) const
+{
+  if (frameCount_ == 0 || entries_[head_].size == 0) return false;
+  frame = storage_ + entries_[head_].offset;
+  frameSize = entries_[head_].size;
+  return true;
+}
+
+} // LoraDv
@@ -35,6 +35,8 @@ void Config::InitializeDefault()
   LoraSync_ = CFG_LORA_SYNC;
   LoraCrc_ = CFG_LORA_CRC; // set to 0 to disable
   LoraPreambleLen_ = CFG_LORA_PREAMBLE_LEN;
+  LoraAdaptive = CFG_LORA_ADAPTIVE;
+  LoraImplicit = CFG_LORA_IMPLICIT;
 
   // fsk parameters
   FskBitRate = CFG_FSK_BIT_RATE;
@@ -65,13 +67,26 @@ void Config::InitializeDefault()
   AudioSampleRate_ = CFG_AUDIO_SAMPLE_RATE;
   AudioCodec2Mode = CFG_AUDIO_CODEC2_MODE;
   AudioMaxPktSize = CFG_AUDIO_MAX_PKT_SIZE;
+  AudioCodec2BitPack = CFG_AUDIO_CODEC2_BITPACK;
+  AudioFecDepth = CFG_AUDIO_FEC_DEPTH;
+  AudioVoiceHdr = CFG_AUDIO_VOICE_HDR;
+  AudioMicDsp = CFG_AUDIO_MIC_DSP;
+  AudioNoiseSup = CFG_AUDIO_NOISE_SUP;
+  AudioDtx = CFG_AUDIO_DTX;
+  AudioVox = CFG_AUDIO_VOX;
+  AudioVoxHangMs = CFG_AUDIO_VOX_HANG_MS;
+  AudioVoxPreRollMs_ = CFG_AUDIO_VOX_PREROLL_MS;
   AudioMaxVol_ = CFG_AUDIO_MAX_VOL;
   AudioVol = CFG_AUDIO_VOL;
   AudioEnPriv = CFG_AUDIO_ENABLE_PRIVACY;
 
   // audio, opus
   AudioOpusRate = CFG_AUDIO_OPUS_BITRATE;
+  AudioOpusSampleRate_ = CFG_AUDIO_OPUS_SAMPLE_RATE;
   AudioOpusPcmLen = CFG_AUDIO_OPUS_PCMLEN;
+  AudioOpusSuperframe = CFG_AUDIO_OPUS_SUPERFRAME;
+  AudioOpusCbr = CFG_AUDIO_OPUS_CBR;
+  AudioOpusFec = CFG_AUDIO_OPUS_FEC;
 
   // i2s speaker
   AudioSpkPinBclk_ = CFG_AUDIO_SPK_PIN_BCLK;
@@ -154,6 +169,16 @@ void Config::Load()
   } else {
     prefs_.putInt(N(LoraCodingRate), LoraCodingRate);
   }
+  if (prefs_.isKey(N(LoraAdaptive))) {
+    LoraAdaptive = prefs_.getBool(N(LoraAdaptive));
+  } else {
+    prefs_.putBool(N(LoraAdaptive), LoraAdaptive);
+  }
+  if (prefs_.isKey(N(LoraImplicit))) {
+    LoraImplicit = prefs_.getBool(N(LoraImplicit));
+  } else {
+    prefs_.putBool(N(LoraImplicit), LoraImplicit);
+  }
   if (prefs_.isKey(N(LoraPower))) {
     LoraPower = prefs_.getInt(N(LoraPower));
   } else {
@@ -174,6 +199,47 @@ void Config::Load()
   } else {
     prefs_.putInt(N(AudioMaxPktSize), AudioMaxPktSize);
   }
+  if (prefs_.isKey(N(AudioFecDepth))) {
+    AudioFecDepth = prefs_.getInt(N(AudioFecDepth));
+  } else {
+    prefs_.putInt(N(AudioFecDepth), AudioFecDepth);
+  }
+  // nvs keys are limited to 15 characters
+  if (prefs_.isKey("AudioC2BitPack")) {
+    AudioCodec2BitPack = prefs_.getBool("AudioC2BitPack");
+  } else {
+    prefs_.putBool("AudioC2BitPack", AudioCodec2BitPack);
+  }
+  if (prefs_.isKey(N(AudioVoiceHdr))) {
+    AudioVoiceHdr = prefs_.getBool(N(AudioVoiceHdr));
+  } else {
+    prefs_.putBool(N(AudioVoiceHdr), AudioVoiceHdr);
+  }
+  if (prefs_.isKey(N(AudioMicDsp))) {
+    AudioMicDsp = prefs_.getBool(N(AudioMicDsp));
+  } else {
+    prefs_.putBool(N(AudioMicDsp), AudioMicDsp);
+  }
+  if (prefs_.isKey(N(AudioNoiseSup))) {
+    AudioNoiseSup = prefs_.getBool(N(AudioNoiseSup));
+  } else {
+    prefs_.putBool(N(AudioNoiseSup), AudioNoiseSup);
+  }
+  if (prefs_.isKey(N(AudioDtx))) {
+    AudioDtx = prefs_.getBool(N(AudioDtx));
+  } else {
+    prefs_.putBool(N(AudioDtx), AudioDtx);
+  }
+  if (prefs_.isKey(N(AudioVox))) {
+    AudioVox = prefs_.getBool(N(AudioVox));
+  } else {
+    prefs_.putBool(N(AudioVox), AudioVox);
+  }
+  if (prefs_.isKey(N(AudioVoxHangMs))) {
+    AudioVoxHangMs = prefs_.getInt(N(AudioVoxHangMs));
+  } else {
+    prefs_.putInt(N(AudioVoxHangMs), AudioVoxHangMs);
+  }
   if (prefs_.isKey(N(AudioEnPriv))) {
     AudioEnPriv = prefs_.getBool(N(AudioEnPriv));
   } else {
@@ -224,6 +290,22 @@ void Config::Load()
   } else {
     prefs_.putInt(N(AudioOpusPcmLen), AudioOpusPcmLen);
   }
+  // nvs keys are limited to 15 characters
+  if (prefs_.isKey("AudioOpusSframe")) {
+    AudioOpusSuperframe = prefs_.getBool("AudioOpusSframe");
+  } else {
+    prefs_.putBool("AudioOpusSframe", AudioOpusSuperframe);
+  }
+  if (prefs_.isKey(N(AudioOpusCbr))) {
+    AudioOpusCbr = prefs_.getBool(N(AudioOpusCbr));
+  } else {
+    prefs_.putBool(N(AudioOpusCbr), AudioOpusCbr);
+  }
+  if (prefs_.isKey(N(AudioOpusFec))) {
+    AudioOpusFec = prefs_.getBool(N(AudioOpusFec));
+  } else {
+    prefs_.putBool(N(AudioOpusFec), AudioOpusFec);
+  }
   if (prefs_.isKey(N(AudioCodec))) {
     AudioCodec = prefs_.getInt(N(AudioCodec));
   } else {
@@ -246,9 +328,19 @@ void Config::Save()
   prefs_.putInt(N(LoraSf), LoraSf);
   prefs_.putInt(N(LoraCodingRate), LoraCodingRate);
   prefs_.putInt(N(LoraPower), LoraPower);
+  prefs_.putBool(N(LoraAdaptive), LoraAdaptive);
+  prefs_.putBool(N(LoraImplicit), LoraImplicit);
   prefs_.putInt(N(AudioCodec2Mode), AudioCodec2Mode);
   prefs_.putInt(N(AudioVol), AudioVol);
   prefs_.putInt(N(AudioMaxPktSize), AudioMaxPktSize);
+  prefs_.putInt(N(AudioFecDepth), AudioFecDepth);
+  prefs_.putBool("AudioC2BitPack", AudioCodec2BitPack);
+  prefs_.putBool(N(AudioVoiceHdr), AudioVoiceHdr);
+  prefs_.putBool(N(AudioMicDsp), AudioMicDsp);
+  prefs_.putBool(N(AudioNoiseSup), AudioNoiseSup);
+  prefs_.putBool(N(AudioDtx), AudioDtx);
+  prefs_.putBool(N(AudioVox), AudioVox);
+  prefs_.putInt(N(AudioVoxHangMs), AudioVoxHangMs);
   prefs_.putBool(N(AudioEnPriv), AudioEnPriv);
   prefs_.putFloat(N(BatteryMonCal), BatteryMonCal);
   prefs_.putInt(N(PmSleepAfterMs), PmSleepAfterMs);
@@ -259,6 +351,9 @@ void Config::Save()
   prefs_.putInt(N(ModType), ModType);
   prefs_.putInt(N(AudioOpusRate), AudioOpusRate);
   prefs_.putInt(N(AudioOpusPcmLen), AudioOpusPcmLen);
+  prefs_.putBool("AudioOpusSframe", AudioOpusSuperframe);
+  prefs_.putBool(N(AudioOpusCbr), AudioOpusCbr);
+  prefs_.putBool(N(AudioOpusFec), AudioOpusFec);
   prefs_.putInt(N(AudioCodec), AudioCodec);
   prefs_.end();
   LOG_INFO("Saved settings");
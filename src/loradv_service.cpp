@@ -11,6 +11,7 @@ Service::Service()
   , hwMonitor_(std::make_shared<HwMonitor>())
   , display_(nullptr)
   , settingsMenu_(nullptr)
+  , isSettingsMenuOpen_(false)
   , btnPressed_(false)
 {
 }
@@ -30,12 +31,14 @@ void Service::setup(std::shared_ptr<Config> config)
   LOG_INFO("PTT setup completed");
 
   hwMonitor_->setup(config);
+  settingsMenu_ = std::make_shared<SettingsMenu>(config_);
   pmService_->setup(config, display_);
   audioTask_->start(config, radioTask_, pmService_);
   radioTask_->start(config, audioTask_);
 
   updateScreen();
 
+  HeapArena::logHeap();
   LOG_INFO("Board setup completed");
 }
 
@@ -115,7 +118,7 @@ bool Service::processRotaryEncoder()
   if (encoderDelta != 0)
   {
     LOG_INFO("Encoder changed:", rotaryEncoder_->readEncoder(), encoderDelta);
-    if (settingsMenu_ == nullptr) {
+    if (!isSettingsMenuOpen_) {
       audioTask_->changeVolume(encoderDelta);
       shouldUpdateScreen = true;
     } else {
@@ -127,7 +130,7 @@ bool Service::processRotaryEncoder()
   if (rotaryEncoder_->isEncoderButtonClicked())
   {
     LOG_INFO("Encoder button clicked", esp_get_free_heap_size());
-    if (settingsMenu_ == nullptr) {
+    if (!isSettingsMenuOpen_) {
       shouldUpdateScreen = true;
     } else {
       settingsMenu_->onEncoderButtonClicked();
@@ -138,11 +141,14 @@ bool Service::processRotaryEncoder()
   if (rotaryEncoder_->isEncoderButtonClicked(CfgEncoderBtnLongMs))
   {
     LOG_INFO("Encoder button long clicked");
-    if (settingsMenu_ == nullptr) {
-      settingsMenu_ = std::make_shared<SettingsMenu>(config_);
+    if (!isSettingsMenuOpen_) {
+      isSettingsMenuOpen_ = true;
+      settingsMenu_->reset();
       settingsMenu_->draw(display_);
     } else {
-      settingsMenu_.reset();
+      isSettingsMenuOpen_ = false;
+      // codec settings take effect without reboot
+      audioTask_->reconfigure();
       shouldUpdateScreen = true;
     }
     pmService_->lightSleepReset();
@@ -0,0 +1,197 @@
+#include "mic_dsp.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static inline uint32_t getCycleCount() { return ESP.getCycleCount(); }
+#else
+static inline uint32_t getCycleCount() { return 0; }
+#endif
+
+namespace LoraDv {
+
+MicDsp::MicDsp()
+  : sampleRate_(8000)
+  , stageMask_(CfgStageAll)
+  , highPassCoef_(0)
+  , highPassInput_(0)
+  , highPassState_(0)
+  , noiseSuppressor_()
+  , isGateOpen_(false)
+  , gateHoldSamples_(0)
+  , gateGain_(CfgGateFloorGain)
+  , agcGain_(CfgUnityGain)
+  , compGain_(CfgUnityGain)
+  , stats_()
+{
+}
+
+size_t MicDsp::getArenaSize(int sampleRate, uint32_t stageMask)
+{
+  return (stageMask & (1 << CfgStageNoise)) ? NoiseSuppressor::getArenaSize(sampleRate) : 0;
+}
+
+bool MicDsp::setup(int sampleRate, uint32_t stageMask, HeapArena *arena)
+{
+  sampleRate_ = sampleRate;
+  stageMask_ = stageMask;
+  // first order pole distance from 1 sets the corner frequency
+  highPassCoef_ = (int32_t)((2 * 314159LL * CfgHighPassHz << CfgHighPassCoefBits) / (100000LL * sampleRate));
+  bool isValid = true;
+  if (stageMask_ & (1 << CfgStageNoise)) {
+    isValid = arena != nullptr && noiseSuppressor_.setup(sampleRate, arena);
+    if (!isValid) stageMask_ &= ~(1 << CfgStageNoise);
+  }
+  reset();
+  resetStats();
+  return isValid;
+}
+
+void MicDsp::reset()
+{
+  // agc gain and noise estimate are kept, speaker, mic and background do not change between transmissions
+  highPassInput_ = 0;
+  highPassState_ = 0;
+  if (stageMask_ & (1 << CfgStageNoise)) noiseSuppressor_.reset();
+  isGateOpen_ = false;
+  gateHoldSamples_ = 0;
+  gateGain_ = CfgGateFloorGain;
+  compGain_ = CfgUnityGain;
+}
+
+void MicDsp::resetStats()
+{
+  stats_ = MicDspStats();
+}
+
+void MicDsp::process(int16_t *pcm, int sampleCount)
+{
+  if (sampleCount <= 0) return;
+  for (int stage = 0; stage < CfgStageCount; stage++) {
+    if ((stageMask_ & (1 << stage)) == 0) continue;
+    uint32_t startCycles = getCycleCount();
+    switch (stage) {
+      case CfgStageHighPass: processHighPass(pcm, sampleCount); break;
+      case CfgStageNoise: noiseSuppressor_.process(pcm, sampleCount); break;
+      case CfgStageGate: processGate(pcm, sampleCount); break;
+      case CfgStageAgc: processAgc(pcm, sampleCount); break;
+      case CfgStageCompressor: processCompressor(pcm, sampleCount); break;
+    }
+    uint32_t cycles = getCycleCount() - startCycles;
+    stats_.totalCycles[stage] += cycles;
+    if (cycles > stats_.maxCycles[stage]) stats_.maxCycles[stage] = cycles;
+  }
+  stats_.frames++;
+}
+
+int16_t MicDsp::saturate(int32_t sample)
+{
+  if (sample > 32767) return 32767;
+  if (sample < -32768) return -32768;
+  return sample;
+}
+
+int32_t MicDsp::getMeanLevel(const int16_t *pcm, int sampleCount)
+{
+  int32_t sum = 0;
+  for (int i = 0; i < sampleCount; i++) {
+    sum += pcm[i] < 0 ? -(int32_t)pcm[i] : pcm[i];
+  }
+  return sum / sampleCount;
+}
+
+void MicDsp::applyGain(int16_t *pcm, int sampleCount, int32_t fromGain, int32_t toGain, int rampLength)
+{
+  if (fromGain == CfgUnityGain && toGain == CfgUnityGain) return;
+  // ramp in gain units with 8 extra bits, then hold the target
+  int32_t rampGain = fromGain << 8;
+  int32_t rampStep = ((toGain - fromGain) << 8) / rampLength;
+  for (int i = 0; i < rampLength; i++) {
+    rampGain += rampStep;
+    pcm[i] = saturate((pcm[i] * (rampGain >> 8)) >> CfgGainShift);
+  }
+  for (int i = rampLength; i < sampleCount; i++) {
+    pcm[i] = saturate((pcm[i] * toGain) >> CfgGainShift);
+  }
+}
+
+void MicDsp::processHighPass(int16_t *pcm, int sampleCount)
+{
+  // y[n] = x[n] - x[n-1] + (1 - c) y[n-1]
+  int32_t state = highPassState_;
+  int32_t input = highPassInput_;
+  for (int i = 0; i < sampleCount; i++) {
+    int32_t sample = pcm[i];
+    state += ((sample - input) << CfgHighPassFracBits) - (int32_t)(((int64_t)state * highPassCoef_) >> CfgHighPassCoefBits);
+    input = sample;
+    pcm[i] = saturate(state >> CfgHighPassFracBits);
+  }
+  highPassState_ = state;
+  highPassInput_ = input;
+}
+
+void MicDsp::processGate(int16_t *pcm, int sampleCount)
+{
+  int32_t level = getMeanLevel(pcm, sampleCount);
+  if (level >= CfgGateOpenLevel) {
+    isGateOpen_ = true;
+    gateHoldSamples_ = CfgGateHoldMs * sampleRate_ / 1000;
+  } else if (level < CfgGateCloseLevel) {
+    gateHoldSamples_ -= sampleCount;
+    if (gateHoldSamples_ <= 0) {
+      gateHoldSamples_ = 0;
+      isGateOpen_ = false;
+    }
+  }
+  // opens within one frame, closes over one frame after the hold time
+  int32_t targetGain = isGateOpen_ ? CfgUnityGain : CfgGateFloorGain;
+  applyGain(pcm, sampleCount, gateGain_, targetGain, sampleCount);
+  gateGain_ = targetGain;
+}
+
+void MicDsp::processAgc(int16_t *pcm, int sampleCount)
+{
+  int32_t targetGain = agcGain_;
+  // background noise should not pull the gain up
+  if ((stageMask_ & (1 << CfgStageGate)) == 0 || isGateOpen_) {
+    int32_t level = getMeanLevel(pcm, sampleCount);
+    int32_t desiredGain = level > 0 ? (CfgAgcTargetLevel << CfgGainShift) / level : CfgAgcMaxGain;
+    if (desiredGain > CfgAgcMaxGain) desiredGain = CfgAgcMaxGain;
+    if (desiredGain < CfgAgcMinGain) desiredGain = CfgAgcMinGain;
+    if (desiredGain < agcGain_) {
+      targetGain -= (agcGain_ - desiredGain + (1 << CfgAgcAttackShift) - 1) >> CfgAgcAttackShift;
+    } else {
+      targetGain += (desiredGain - agcGain_) >> CfgAgcReleaseShift;
+    }
+  }
+  applyGain(pcm, sampleCount, agcGain_, targetGain, sampleCount);
+  agcGain_ = targetGain;
+}
+
+void MicDsp::processCompressor(int16_t *pcm, int sampleCount)
+{
+  int32_t peak = 0;
+  int peakIndex = 0;
+  for (int i = 0; i < sampleCount; i++) {
+    int32_t level = pcm[i] < 0 ? -(int32_t)pcm[i] : pcm[i];
+    if (level > peak) {
+      peak = level;
+      peakIndex = i;
+    }
+  }
+  int32_t targetGain = CfgUnityGain;
+  if (peak > CfgCompThreshold) {
+    int32_t compressedPeak = CfgCompThreshold + ((peak - CfgCompThreshold) >> CfgCompRatioShift);
+    targetGain = (compressedPeak << CfgGainShift) / peak;
+  }
+  // gain is reached by the peak on attack, released slowly
+  int rampLength = sampleCount;
+  if (targetGain < compGain_) {
+    rampLength = peakIndex + 1;
+  } else {
+    targetGain = compGain_ + ((targetGain - compGain_ + (1 << CfgCompReleaseShift) - 1) >> CfgCompReleaseShift);
+  }
+  applyGain(pcm, sampleCount, compGain_, targetGain, rampLength);
+  compGain_ = targetGain;
+}
+
+} // LoraDv
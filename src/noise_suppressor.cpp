@@ -0,0 +1,257 @@
+#include <math.h>
+#include <string.h>
+
+#include "noise_suppressor.h"
+
+namespace LoraDv {
+
+static const float CfgPi = 3.14159265f;
+static const float CfgPowerSmoothing = 0.5f;      // power used for the gain
+static const float CfgNoiseSmoothing = 0.85f;     // power used for the noise minimum search
+static const float CfgNoiseBias = 1.5f;           // minimum is below the mean noise power
+static const float CfgOverSubtraction = 2.0f;     // suppresses musical noise
+static const float CfgMinGain = 0.01f;            // power gain floor, -20 dB
+static const float CfgMaxPower = 1e12f;           // initial minimum
+
+NoiseSuppressor::NoiseSuppressor()
+  : fftSize_(0)
+  , hopSize_(0)
+  , binCount_(0)
+  , window_(nullptr)
+  , cos_(nullptr)
+  , sin_(nullptr)
+  , bitReverse_(nullptr)
+  , history_(nullptr)
+  , overlap_(nullptr)
+  , re_(nullptr)
+  , im_(nullptr)
+  , inHop_(nullptr)
+  , outHop_(nullptr)
+  , hopPos_(0)
+  , power_(nullptr)
+  , smoothedPower_(nullptr)
+  , subwindowMin_(nullptr)
+  , windowMin_(nullptr)
+  , noise_(nullptr)
+  , subwindowBlocksMax_(0)
+  , subwindowBlocks_(0)
+  , subwindowIndex_(0)
+{
+}
+
+int NoiseSuppressor::getFftSize(int sampleRate)
+{
+  // power of two closest to the block length
+  int blockSize = sampleRate * CfgBlockMs / 1000;
+  int fftSize = 16;
+  while (fftSize < CfgMaxFftSize && 3 * fftSize < 2 * blockSize) fftSize <<= 1;
+  return fftSize;
+}
+
+size_t NoiseSuppressor::getArenaSize(int sampleRate)
+{
+  size_t fftSize = getFftSize(sampleRate);
+  size_t hopSize = fftSize / 2;
+  size_t binCount = fftSize / 2 + 1;
+  return 5 * HeapArena::getBlockSize(sizeof(float) * fftSize)
+    + 3 * HeapArena::getBlockSize(sizeof(float) * hopSize)
+    + HeapArena::getBlockSize(sizeof(uint16_t) * fftSize)
+    + 2 * HeapArena::getBlockSize(sizeof(int16_t) * hopSize)
+    + 4 * HeapArena::getBlockSize(sizeof(float) * binCount)
+    + HeapArena::getBlockSize(sizeof(float) * binCount * CfgSubwindowCount);
+}
+
+bool NoiseSuppressor::setup(int sampleRate, HeapArena *arena)
+{
+  fftSize_ = getFftSize(sampleRate);
+  hopSize_ = fftSize_ / 2;
+  binCount_ = fftSize_ / 2 + 1;
+  int hopMs = hopSize_ * 1000 / sampleRate;
+  subwindowBlocksMax_ = hopMs > 0 && CfgSubwindowMs > hopMs ? CfgSubwindowMs / hopMs : 1;
+
+  window_ = arena->allocate<float>(fftSize_);
+  cos_ = arena->allocate<float>(hopSize_);
+  sin_ = arena->allocate<float>(hopSize_);
+  bitReverse_ = arena->allocate<uint16_t>(fftSize_);
+  history_ = arena->allocate<float>(hopSize_);
+  overlap_ = arena->allocate<float>(fftSize_);
+  re_ = arena->allocate<float>(fftSize_);
+  im_ = arena->allocate<float>(fftSize_);
+  inHop_ = arena->allocate<int16_t>(hopSize_);
+  outHop_ = arena->allocate<int16_t>(hopSize_);
+  power_ = arena->allocate<float>(binCount_);
+  smoothedPower_ = arena->allocate<float>(binCount_);
+  subwindowMin_ = arena->allocate<float>(binCount_);
+  windowMin_ = arena->allocate<float>(binCount_ * CfgSubwindowCount);
+  noise_ = arena->allocate<float>(binCount_);
+  if (window_ == nullptr || cos_ == nullptr || sin_ == nullptr || bitReverse_ == nullptr || history_ == nullptr
+      || overlap_ == nullptr || re_ == nullptr || im_ == nullptr || inHop_ == nullptr || outHop_ == nullptr
+      || power_ == nullptr || smoothedPower_ == nullptr || subwindowMin_ == nullptr || windowMin_ == nullptr
+      || noise_ == nullptr) {
+    fftSize_ = 0;
+    return false;
+  }
+
+  // sqrt hann for analysis and synthesis sums to one with 50% overlap
+  for (int i = 0; i < fftSize_; i++) {
+    window_[i] = sqrtf(0.5f * (1.0f - cosf(2.0f * CfgPi * i / fftSize_)));
+  }
+  for (int i = 0; i < hopSize_; i++) {
+    cos_[i] = cosf(2.0f * CfgPi * i / fftSize_);
+    sin_[i] = -sinf(2.0f * CfgPi * i / fftSize_);
+  }
+  int bits = 0;
+  while ((1 << bits) < fftSize_) bits++;
+  for (int i = 0; i < fftSize_; i++) {
+    int reversed = 0;
+    for (int b = 0; b < bits; b++) {
+      if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+    }
+    bitReverse_[i] = reversed;
+  }
+  resetNoise();
+  reset();
+  return true;
+}
+
+void NoiseSuppressor::reset()
+{
+  if (fftSize_ == 0) return;
+  memset(history_, 0, sizeof(float) * hopSize_);
+  memset(overlap_, 0, sizeof(float) * fftSize_);
+  memset(outHop_, 0, sizeof(int16_t) * hopSize_);
+  hopPos_ = 0;
+  for (int k = 0; k < binCount_; k++) {
+    power_[k] = 0;
+  }
+}
+
+void NoiseSuppressor::resetNoise()
+{
+  if (fftSize_ == 0) return;
+  for (int k = 0; k < binCount_; k++) {
+    smoothedPower_[k] = 0;
+    subwindowMin_[k] = CfgMaxPower;
+    noise_[k] = 0;
+  }
+  for (int i = 0; i < binCount_ * CfgSubwindowCount; i++) {
+    windowMin_[i] = CfgMaxPower;
+  }
+  subwindowBlocks_ = 0;
+  subwindowIndex_ = 0;
+}
+
+void NoiseSuppressor::process(int16_t *pcm, int sampleCount)
+{
+  if (fftSize_ == 0) return;
+  for (int i = 0; i < sampleCount; i++) {
+    int16_t sample = pcm[i];
+    pcm[i] = outHop_[hopPos_];
+    inHop_[hopPos_] = sample;
+    if (++hopPos_ == hopSize_) {
+      processBlock();
+      hopPos_ = 0;
+    }
+  }
+}
+
+void NoiseSuppressor::fft(float *re, float *im) const
+{
+  for (int i = 0; i < fftSize_; i++) {
+    int j = bitReverse_[i];
+    if (j > i) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (int size = 2; size <= fftSize_; size <<= 1) {
+    int half = size >> 1;
+    int step = fftSize_ / size;
+    for (int start = 0; start < fftSize_; start += size) {
+      for (int k = 0; k < half; k++) {
+        float wr = cos_[k * step];
+        float wi = sin_[k * step];
+        int a = start + k;
+        int b = a + half;
+        float tr = re[b] * wr - im[b] * wi;
+        float ti = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
+
+void NoiseSuppressor::processBlock()
+{
+  const int historySize = fftSize_ - hopSize_;
+
+  // analysis block is the previous hop followed by the new one
+  for (int i = 0; i < historySize; i++) {
+    re_[i] = history_[i] * window_[i];
+  }
+  for (int i = 0; i < hopSize_; i++) {
+    re_[historySize + i] = inHop_[i] * window_[historySize + i];
+    history_[i] = inHop_[i];
+  }
+  memset(im_, 0, sizeof(float) * fftSize_);
+  fft(re_, im_);
+
+  // noise minimum search window moves by one subwindow
+  bool isSubwindowDone = ++subwindowBlocks_ == subwindowBlocksMax_;
+  for (int k = 0; k < binCount_; k++) {
+    float power = re_[k] * re_[k] + im_[k] * im_[k];
+    power_[k] = CfgPowerSmoothing * power_[k] + (1.0f - CfgPowerSmoothing) * power;
+    smoothedPower_[k] = CfgNoiseSmoothing * smoothedPower_[k] + (1.0f - CfgNoiseSmoothing) * power;
+    if (smoothedPower_[k] < subwindowMin_[k]) subwindowMin_[k] = smoothedPower_[k];
+
+    float minPower = subwindowMin_[k];
+    for (int u = 0; u < CfgSubwindowCount; u++) {
+      if (windowMin_[u * binCount_ + k] < minPower) minPower = windowMin_[u * binCount_ + k];
+    }
+    noise_[k] = CfgNoiseBias * minPower;
+    if (isSubwindowDone) {
+      windowMin_[subwindowIndex_ * binCount_ + k] = subwindowMin_[k];
+      subwindowMin_[k] = CfgMaxPower;
+    }
+
+    // power subtraction with floor, applied to the magnitude
+    float gain = power_[k] > 0 ? 1.0f - CfgOverSubtraction * noise_[k] / power_[k] : CfgMinGain;
+    if (gain < CfgMinGain) gain = CfgMinGain;
+    gain = sqrtf(gain);
+    re_[k] *= gain;
+    im_[k] *= gain;
+    if (k > 0 && k < fftSize_ / 2) {
+      re_[fftSize_ - k] *= gain;
+      im_[fftSize_ - k] *= gain;
+    }
+  }
+  if (isSubwindowDone) {
+    subwindowBlocks_ = 0;
+    subwindowIndex_ = (subwindowIndex_ + 1) % CfgSubwindowCount;
+  }
+
+  // inverse transform as forward one of the conjugate
+  for (int i = 0; i < fftSize_; i++) {
+    im_[i] = -im_[i];
+  }
+  fft(re_, im_);
+
+  // overlap-add, first hop is complete
+  const float scale = 1.0f / fftSize_;
+  for (int i = 0; i < fftSize_; i++) {
+    overlap_[i] += re_[i] * scale * window_[i];
+  }
+  for (int i = 0; i < hopSize_; i++) {
+    float sample = overlap_[i];
+    if (sample > 32767.0f) sample = 32767.0f;
+    if (sample < -32768.0f) sample = -32768.0f;
+    outHop_[i] = (int16_t)sample;
+  }
+  memmove(overlap_, overlap_ + hopSize_, sizeof(float) * historySize);
+  memset(overlap_ + historySize, 0, sizeof(float) * hopSize_);
+}
+
+} // LoraDv
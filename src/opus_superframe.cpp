@@ -0,0 +1,120 @@
+#include <math.h>
+#include <string.h>
+
+#include "opus_superframe.h"
+
+namespace LoraDv {
+
+OpusSuperframe::OpusSuperframe()
+  : repacketizer_(nullptr)
+  , maxPacketSize_(0)
+  , maxFrames_(1)
+  , bufferSize_(0)
+  , frameCount_(0)
+  , lengthBytes_(0)
+  , lastLengthSize_(0)
+{
+}
+
+OpusSuperframe::~OpusSuperframe()
+{
+  if (repacketizer_ != nullptr) opus_repacketizer_destroy(repacketizer_);
+}
+
+bool OpusSuperframe::setup(float frameMs, int maxPacketSize)
+{
+  if (repacketizer_ == nullptr) repacketizer_ = opus_repacketizer_create();
+  if (repacketizer_ == nullptr) return false;
+  maxPacketSize_ = maxPacketSize < CfgBufferSize ? maxPacketSize : CfgBufferSize;
+  maxFrames_ = frameMs > 0 ? (int)floor(CfgMaxPacketMs / frameMs) : 1;
+  if (maxFrames_ < 1) maxFrames_ = 1;
+  if (maxFrames_ > CfgMaxFrames) maxFrames_ = CfgMaxFrames;
+  reset();
+  return true;
+}
+
+void OpusSuperframe::reset()
+{
+  if (repacketizer_ != nullptr) opus_repacketizer_init(repacketizer_);
+  bufferSize_ = 0;
+  frameCount_ = 0;
+  lengthBytes_ = 0;
+  lastLengthSize_ = 0;
+}
+
+bool OpusSuperframe::canAppend(const uint8_t *frame, int frameSize) const
+{
+  if (frameSize <= 0 || bufferSize_ + frameSize > CfgBufferSize) return false;
+  if (frameCount_ == 0) return true;
+  if (isFull()) return false;
+  // repacketizer combines only frames of the same opus configuration
+  if ((frame[0] & CfgTocConfigMask) != (buffer_[0] & CfgTocConfigMask)) return false;
+  // every frame loses its toc and gets a length prefix, encoder could emit several frames at once
+  int subFrames = opus_packet_get_nb_frames(frame, frameSize);
+  if (subFrames <= 0) return false;
+  int packetSize = CfgTocSize + CfgCountSize
+    + bufferSize_ - frameCount_ * CfgTocSize + lengthBytes_
+    + frameSize - CfgTocSize + subFrames * getLengthSize(frameSize) - getLengthSize(frameSize);
+  return packetSize <= maxPacketSize_;
+}
+
+bool OpusSuperframe::append(const uint8_t *frame, int frameSize)
+{
+  if (frameSize <= 0 || bufferSize_ + frameSize > CfgBufferSize) return false;
+  int subFrames = opus_packet_get_nb_frames(frame, frameSize);
+  if (subFrames <= 0) return false;
+  uint8_t *stored = buffer_ + bufferSize_;
+  memcpy(stored, frame, frameSize);
+  if (opus_repacketizer_cat(repacketizer_, stored, frameSize) != OPUS_OK) return false;
+  bufferSize_ += frameSize;
+  frameCount_++;
+  lastLengthSize_ = getLengthSize(frameSize);
+  lengthBytes_ += subFrames * lastLengthSize_;
+  return true;
+}
+
+int OpusSuperframe::write(uint8_t *packet, int maxPacketSize)
+{
+  int packetSize = frameCount_ > 0 ? opus_repacketizer_out(repacketizer_, packet, maxPacketSize) : 0;
+  reset();
+  return packetSize > 0 ? packetSize : 0;
+}
+
+int OpusSuperframe::readBegin(const uint8_t *packet, int packetSize)
+{
+  if (repacketizer_ == nullptr) return 0;
+  reset();
+  if (packetSize <= 0 || opus_repacketizer_cat(repacketizer_, packet, packetSize) != OPUS_OK) return 0;
+  return opus_repacketizer_get_nb_frames(repacketizer_);
+}
+
+int OpusSuperframe::readFrame(int index, uint8_t *frame, int maxFrameSize)
+{
+  int frameSize = opus_repacketizer_out_range(repacketizer_, index, index + 1, frame, maxFrameSize);
+  return frameSize > 0 ? frameSize : 0;
+}
+
+bool OpusSuperframe::isValidPacket(const uint8_t *packet, int packetSize)
+{
+  const uint8_t *frames[CfgMaxFrames];
+  opus_int16 frameSizes[CfgMaxFrames];
+  return packetSize > 0 && opus_packet_parse(packet, packetSize, NULL, frames, frameSizes, NULL) > 0;
+}
+
+int OpusSuperframe::getPacketSize(int frameCount, int frameSize, bool isCbr)
+{
+  if (frameCount <= 1) return frameSize;
+  // code 3 packet, vbr frames except the last one carry their length
+  int lengthBytes = isCbr ? 0 : (frameCount - 1) * getLengthSize(frameSize);
+  return CfgTocSize + CfgCountSize + frameCount * (frameSize - CfgTocSize) + lengthBytes;
+}
+
+int OpusSuperframe::getFramesPerPacket(float frameMs, int frameSize, int maxPacketSize, bool isCbr)
+{
+  int frameCount = frameMs > 0 ? (int)floor(CfgMaxPacketMs / frameMs) : 1;
+  if (frameCount > CfgMaxFrames) frameCount = CfgMaxFrames;
+  while (frameCount > 1 && getPacketSize(frameCount, frameSize, isCbr) > maxPacketSize) frameCount--;
+  return frameCount > 0 ? frameCount : 1;
+}
+
+} // LoraDv
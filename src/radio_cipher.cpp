@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include "radio_cipher.h"
+
+namespace LoraDv {
+
+static const uint8_t CounterMac[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t CounterData[8] = { 1, 0, 0, 0, 0, 0, 0, 0 };
+
+RadioCipher::RadioCipher()
+  : salt_(0)
+  , txCounter_(0)
+  , streamSize_(CfgMaxPayload)
+  , authFailCount_(0)
+{
+  for (int i = 0; i < CfgPrecomputeCount; i++) {
+    txStreams_[i].isReady = false;
+  }
+}
+
+void RadioCipher::setKey(const uint8_t *key, size_t keyLen)
+{
+  chacha_.setKey(key, keyLen);
+  setSalt(salt_);
+}
+
+void RadioCipher::setSalt(uint32_t salt)
+{
+  // nonces must never repeat for the same key, counter restarts with new salt
+  salt_ = salt;
+  txCounter_ = 0;
+  for (int i = 0; i < CfgPrecomputeCount; i++) {
+    txStreams_[i].isReady = false;
+  }
+}
+
+void RadioCipher::setStreamSize(int streamSize)
+{
+  streamSize_ = streamSize > 0 && streamSize < CfgMaxPayload ? streamSize : CfgMaxPayload;
+  for (int i = 0; i < CfgPrecomputeCount; i++) {
+    txStreams_[i].isReady = false;
+  }
+}
+
+void RadioCipher::makeNonce(uint32_t counter, uint8_t *nonce) const
+{
+  for (int i = 0; i < 4; i++) {
+    nonce[i] = salt_ >> (8 * i);
+    nonce[4 + i] = counter >> (8 * i);
+  }
+}
+
+void RadioCipher::generate(const uint8_t *nonce, uint8_t *polyKey, uint8_t *stream, int streamLen)
+{
+  chacha_.setIV(nonce, CfgNonceLen);
+  chacha_.setCounter(CounterMac, sizeof(CounterMac));
+  memset(polyKey, 0, CfgPolyKeyLen);
+  chacha_.encrypt(polyKey, polyKey, CfgPolyKeyLen);
+  if (stream == nullptr) return;
+  chacha_.setCounter(CounterData, sizeof(CounterData));
+  memset(stream, 0, streamLen);
+  chacha_.encrypt(stream, stream, streamLen);
+}
+
+void RadioCipher::computeTag(const uint8_t *polyKey, const uint8_t *data, int dataLen, uint8_t *tag)
+{
+  uint8_t fullTag[CfgPolyTagLen];
+  poly_.reset(polyKey);
+  poly_.update(data, dataLen);
+  poly_.finalize(polyKey + CfgPolyTagLen, fullTag, CfgPolyTagLen);
+  memcpy(tag, fullTag, CfgTagLen);
+}
+
+void RadioCipher::precompute()
+{
+  for (int i = 0; i < CfgPrecomputeCount; i++) {
+    uint32_t counter = txCounter_ + i;
+    KeyStream &ks = txStreams_[counter % CfgPrecomputeCount];
+    if (ks.isReady && ks.counter == counter) continue;
+    uint8_t nonce[CfgNonceLen];
+    makeNonce(counter, nonce);
+    generate(nonce, ks.polyKey, ks.stream, streamSize_);
+    ks.counter = counter;
+    ks.isReady = true;
+  }
+}
+
+int RadioCipher::encrypt(uint8_t *packet, int headerSize, const uint8_t *payload, int payloadSize)
+{
+  if (payloadSize > CfgMaxPayload) return -1;
+  uint32_t counter = txCounter_++;
+  uint8_t *nonce = packet + headerSize;
+  uint8_t *cipherText = nonce + CfgNonceLen;
+  makeNonce(counter, nonce);
+
+  // keystream is normally ready, generated now only if transmitting faster than idle allows
+  // or payload is longer than the precomputed part
+  KeyStream &ks = txStreams_[counter % CfgPrecomputeCount];
+  if (!ks.isReady || ks.counter != counter || payloadSize > streamSize_) {
+    generate(nonce, ks.polyKey, ks.stream, payloadSize);
+  }
+  ks.isReady = false;
+
+  for (int i = 0; i < payloadSize; i++) {
+    cipherText[i] = payload[i] ^ ks.stream[i];
+  }
+  int authSize = headerSize + CfgNonceLen + payloadSize;
+  computeTag(ks.polyKey, packet, authSize, packet + authSize);
+  return authSize + CfgTagLen;
+}
+
+int RadioCipher::decrypt(uint8_t *packet, int headerSize, int packetSize)
+{
+  int payloadSize = packetSize - headerSize - CfgOverhead;
+  if (payloadSize <= 0) {
+    authFailCount_++;
+    return -1;
+  }
+  // check tag before spending time on payload keystream
+  uint8_t *nonce = packet + headerSize;
+  uint8_t *cipherText = nonce + CfgNonceLen;
+  uint8_t polyKey[CfgPolyKeyLen];
+  generate(nonce, polyKey, nullptr, 0);
+
+  int authSize = headerSize + CfgNonceLen + payloadSize;
+  uint8_t tag[CfgTagLen];
+  computeTag(polyKey, packet, authSize, tag);
+  uint8_t diff = 0;
+  for (int i = 0; i < CfgTagLen; i++) {
+    diff |= tag[i] ^ packet[authSize + i];
+  }
+  if (diff != 0) {
+    authFailCount_++;
+    return -1;
+  }
+  chacha_.setCounter(CounterData, sizeof(CounterData));
+  chacha_.decrypt(cipherText, cipherText, payloadSize);
+  return payloadSize;
+}
+
+} // LoraDv
@@ -0,0 +1,111 @@
+#include "radio_device_radiolib.h"
+
+namespace LoraDv {
+
+RadioDeviceRadioLib::RadioDeviceRadioLib(std::shared_ptr<const Config> config)
+  : config_(config)
+  , rig_(nullptr)
+  , isr_(nullptr)
+  , isIsrInstalled_(false)
+  , implicitLen_(0)
+  , imageCalBand_(-1)
+{
+}
+
+void RadioDeviceRadioLib::setupModule()
+{
+  // module is reused on reconfiguration, begin() resets the radio anyway
+  if (rig_ != nullptr) return;
+  rig_ = std::make_shared<MODULE_NAME>(new Module(config_->LoraPinSs_, config_->LoraPinA_, config_->LoraPinRst_, config_->LoraPinB_));
+}
+
+int RadioDeviceRadioLib::getImageCalBand(long freq)
+{
+  // same bands as used by radiolib sx126x image calibration
+  if (freq > 900e6) return 4;
+  if (freq > 850e6) return 3;
+  if (freq > 770e6) return 2;
+  if (freq > 460e6) return 1;
+  return 0;
+}
+
+int RadioDeviceRadioLib::beginLora(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes, int preambleLen)
+{
+  setupModule();
+  int state = rig_->begin((float)freq / 1e6, (float)bw / 1e3, sf, cr, sync, pwr);
+  if (state != RADIOLIB_ERR_NONE) return state;
+  imageCalBand_ = getImageCalBand(freq);
+  rig_->setCRC(crcBytes);
+  rig_->setPreambleLength(preambleLen);
+  setIsr(isr_);
+  return explicitHeader();
+}
+
+int RadioDeviceRadioLib::beginFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, uint8_t shaping)
+{
+  setupModule();
+  int state = rig_->beginFSK((float)freq / 1e6, bitRate, freqDev, rxBw, pwr);
+  if (state != RADIOLIB_ERR_NONE) return state;
+  imageCalBand_ = getImageCalBand(freq);
+  rig_->disableAddressFiltering();
+  rig_->setDataShaping(shaping);
+  setIsr(isr_);
+  return RADIOLIB_ERR_NONE;
+}
+
+void RadioDeviceRadioLib::setIsr(void (*isr)(void))
+{
+  isr_ = isr;
+  if (rig_ == nullptr || isr_ == nullptr) return;
+#ifdef USE_SX126X
+    #pragma message("Using SX126X")
+    LOG_INFO("Using SX126X module");
+    rig_->setRfSwitchPins(config_->LoraPinSwitchRx_, config_->LoraPinSwitchTx_);
+    if (isIsrInstalled_) rig_->clearDio1Action();
+    rig_->setDio1Action(isr_);
+    isIsrInstalled_ = true;
+#else
+    #pragma message("Using SX127X")
+    LOG_INFO("Using SX127X module");
+    if (isIsrInstalled_) rig_->clearDio0Action();
+    rig_->setDio0Action(isr_, RISING);
+    isIsrInstalled_ = true;
+#endif
+}
+
+int RadioDeviceRadioLib::setFrequency(long freq)
+{
+#ifdef USE_SX126X
+  // image calibration takes milliseconds, only needed when band changes
+  int band = getImageCalBand(freq);
+  int state = rig_->setFrequency((float)freq / (float)1e6, band != imageCalBand_);
+  if (state == RADIOLIB_ERR_NONE) imageCalBand_ = band;
+  return state;
+#else
+  return rig_->setFrequency((float)freq / (float)1e6);
+#endif
+}
+
+int RadioDeviceRadioLib::implicitHeader(size_t len)
+{
+  implicitLen_ = len;
+  return rig_->implicitHeader(len);
+}
+
+int RadioDeviceRadioLib::explicitHeader()
+{
+  implicitLen_ = 0;
+  return rig_->explicitHeader();
+}
+
+int RadioDeviceRadioLib::startReceive()
+{
+#ifdef USE_SX126X
+  return rig_->startReceive();
+#else
+  // sx127x needs expected length in implicit header mode
+  return rig_->startReceive(implicitLen_, RADIOLIB_SX127X_RXCONTINUOUS);
+#endif
+}
+
+} // LoraDv
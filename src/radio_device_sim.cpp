@@ -0,0 +1,317 @@
+#include "radio_device_sim.h"
+
+#ifndef ARDUINO
+
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "air_time.h"
+
+namespace LoraDv {
+
+RadioChannelSim::RadioChannelSim(const RadioChannelParams &params, unsigned int seed)
+  : params_(params)
+  , stats_{ 0, 0, 0, 0 }
+  , rng_(seed)
+{
+}
+
+std::shared_ptr<RadioDeviceSim> RadioChannelSim::createDevice()
+{
+  std::shared_ptr<RadioDeviceSim> device = std::make_shared<RadioDeviceSim>(shared_from_this());
+  std::lock_guard<std::mutex> lock(mutex_);
+  devices_.push_back(device);
+  return device;
+}
+
+void RadioChannelSim::setParams(const RadioChannelParams &params)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  params_ = params;
+}
+
+RadioChannelParams RadioChannelSim::getParams()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return params_;
+}
+
+RadioChannelStats RadioChannelSim::getStats()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void RadioChannelSim::transmit(std::weak_ptr<RadioDeviceSim> sender, const RadioModulationSim &modulation,
+  const std::vector<uint8_t> &packet, float airTimeMs)
+{
+  RadioChannelParams params = getParams();
+  std::shared_ptr<RadioChannelSim> self = shared_from_this();
+  int airTimeUs = params.isAirTimeEnabled ? (int)(1000 * airTimeMs) : 0;
+  // sender could be destroyed while its packet is on air, packet is still delivered
+  std::thread([self, sender, modulation, packet, airTimeUs, params]() {
+    std::this_thread::sleep_for(std::chrono::microseconds(airTimeUs));
+    std::shared_ptr<RadioDeviceSim> device = sender.lock();
+    if (device != nullptr) device->onTransmitDone();
+    device.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(params.latencyMs));
+    self->deliver(sender, modulation, packet);
+  }).detach();
+}
+
+void RadioChannelSim::deliver(const std::weak_ptr<RadioDeviceSim> &sender, const RadioModulationSim &modulation,
+  const std::vector<uint8_t> &packet)
+{
+  std::shared_ptr<RadioDeviceSim> senderDevice = sender.lock();
+  std::vector<std::shared_ptr<RadioDeviceSim>> receivers;
+  std::vector<uint8_t> rxPacket(packet);
+  bool isCorrupted = false;
+  float rssi, snr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.sent++;
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    if (uniform(rng_) < params_.lossRate) {
+      stats_.lost++;
+      return;
+    }
+    // flip bits with given probability
+    if (params_.bitErrorRate > 0) {
+      for (size_t i = 0; i < rxPacket.size(); i++) {
+        for (int bit = 0; bit < 8; bit++) {
+          if (uniform(rng_) < params_.bitErrorRate) {
+            rxPacket[i] ^= 1 << bit;
+            isCorrupted = true;
+          }
+        }
+      }
+    }
+    if (isCorrupted) stats_.corrupted++;
+    std::uniform_real_distribution<float> jitter(-params_.rssiJitter, params_.rssiJitter);
+    rssi = params_.rssi + jitter(rng_);
+    snr = params_.snr + jitter(rng_);
+    for (auto it = devices_.begin(); it != devices_.end(); ) {
+      std::shared_ptr<RadioDeviceSim> device = it->lock();
+      if (device == nullptr) {
+        it = devices_.erase(it);
+        continue;
+      }
+      if (device != senderDevice) receivers.push_back(device);
+      ++it;
+    }
+  }
+  for (auto &device : receivers) {
+    if (!device->isListening(modulation)) continue;
+    device->onReceive(rxPacket, isCorrupted, rssi, snr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.delivered++;
+  }
+}
+
+RadioDeviceSim::RadioDeviceSim(std::shared_ptr<RadioChannelSim> channel)
+  : channel_(channel)
+  , isr_(nullptr)
+  , mode_(Mode::Standby)
+  , isLora_(true)
+  , freq_(0)
+  , bw_(0)
+  , sf_(0)
+  , cr_(0)
+  , preambleLen_(0)
+  , sync_(0)
+  , isCrcOn_(true)
+  , implicitLen_(0)
+  , bitRate_(0)
+  , isRxCorrupted_(false)
+  , rssi_(0)
+  , snr_(0)
+{
+}
+
+int RadioDeviceSim::beginLora(long freq, long bw, int sf, int cr, int pwr, int sync, int crcBytes, int preambleLen)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  isLora_ = true;
+  freq_ = freq;
+  bw_ = bw;
+  sf_ = sf;
+  cr_ = cr;
+  sync_ = sync;
+  isCrcOn_ = crcBytes != 0;
+  preambleLen_ = preambleLen;
+  mode_ = Mode::Standby;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::beginFsk(long freq, float bitRate, float freqDev, float rxBw, int pwr, uint8_t shaping)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  isLora_ = false;
+  freq_ = freq;
+  bitRate_ = bitRate;
+  isCrcOn_ = true;
+  mode_ = Mode::Standby;
+  return CfgErrNone;
+}
+
+void RadioDeviceSim::setIsr(void (*isr)(void))
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  isr_ = isr;
+}
+
+int RadioDeviceSim::setFrequency(long freq)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  freq_ = freq;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::setSpreadingFactor(int sf)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  sf_ = sf;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::implicitHeader(size_t len)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  implicitLen_ = len;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::explicitHeader()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  implicitLen_ = 0;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::startReceive()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mode_ == Mode::Transmit) return CfgErrTxBusy;
+  mode_ = Mode::Receive;
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::getPacketLength()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rxPacket_.size();
+}
+
+int RadioDeviceSim::readData(uint8_t *data, size_t len)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t size = len < rxPacket_.size() ? len : rxPacket_.size();
+  memcpy(data, rxPacket_.data(), size);
+  rxPacket_.clear();
+  return (isRxCorrupted_ && isCrcOn_) ? CfgErrCrcMismatch : CfgErrNone;
+}
+
+int RadioDeviceSim::startTransmit(uint8_t *data, size_t len)
+{
+  float airTimeMs;
+  RadioModulationSim modulation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_ == Mode::Transmit) return CfgErrTxBusy;
+    mode_ = Mode::Transmit;
+    airTimeMs = getTimeOnAirMs(len);
+    modulation = getModulation();
+  }
+  channel_->transmit(shared_from_this(), modulation, std::vector<uint8_t>(data, data + len), airTimeMs);
+  return CfgErrNone;
+}
+
+int RadioDeviceSim::finishTransmit()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  mode_ = Mode::Standby;
+  return CfgErrNone;
+}
+
+float RadioDeviceSim::getRssi()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rssi_;
+}
+
+float RadioDeviceSim::getSnr()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return snr_;
+}
+
+long RadioDeviceSim::random(long max)
+{
+  return std::rand() % max;
+}
+
+float RadioDeviceSim::getTimeOnAirMs(size_t len) const
+{
+  if (isLora_)
+    return AirTime::getLoraTimeOnAirMs(len, sf_, bw_, cr_, preambleLen_, implicitLen_ > 0, isCrcOn_);
+  return AirTime::getFskTimeOnAirMs(len, bitRate_);
+}
+
+RadioModulationSim RadioDeviceSim::getModulation() const
+{
+  RadioModulationSim modulation;
+  modulation.isLora = isLora_;
+  modulation.freq = freq_;
+  modulation.bw = bw_;
+  modulation.sf = sf_;
+  modulation.sync = sync_;
+  modulation.isImplicitHeader = implicitLen_ > 0;
+  modulation.bitRate = bitRate_;
+  return modulation;
+}
+
+bool RadioDeviceSim::isListening(const RadioModulationSim &modulation)
+{
+  // sender modulation is a copy taken when transmit started
+  std::lock_guard<std::mutex> lock(mutex_);
+  return mode_ == Mode::Receive && freq_ == modulation.freq && isLora_ == modulation.isLora &&
+    (isLora_ ? (bw_ == modulation.bw && sf_ == modulation.sf && sync_ == modulation.sync &&
+      (implicitLen_ > 0) == modulation.isImplicitHeader) : bitRate_ == modulation.bitRate);
+}
+
+void RadioDeviceSim::callIsr()
+{
+  void (*isr)(void);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isr = isr_;
+  }
+  if (isr != nullptr) isr();
+}
+
+void RadioDeviceSim::onTransmitDone()
+{
+  callIsr();
+}
+
+void RadioDeviceSim::onReceive(const std::vector<uint8_t> &packet, bool isCorrupted, float rssi, float snr)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rxPacket_ = packet;
+    isRxCorrupted_ = isCorrupted;
+    // without header receiver demodulates the length it expects
+    if (isLora_ && implicitLen_ > 0) {
+      if (rxPacket_.size() != implicitLen_) isRxCorrupted_ = true;
+      rxPacket_.resize(implicitLen_);
+    }
+    rssi_ = rssi;
+    snr_ = snr;
+  }
+  callIsr();
+}
+
+} // LoraDv
+
+#endif // ARDUINO
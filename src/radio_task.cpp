@@ -1,17 +1,33 @@
 #include "radio_task.h"
+#include "radio_device_radiolib.h"
 
 namespace LoraDv {
 
 volatile bool RadioTask::loraIsrEnabled_ = true;
+volatile bool RadioTask::rigIsTxActive_ = false;
 TaskHandle_t RadioTask::loraTaskHandle_;
 
 RadioTask::RadioTask()
   : config_(nullptr)
   , rig_(nullptr)
   , audioTask_(nullptr)
-  , cipher_(new ChaCha())
+  , radioArena_("Radio")
+  , txBuf_{ nullptr, nullptr }
+  , txBufSize_{ 0, 0 }
+  , txBufIndex_(0)
   , rigIsImplicitMode_(false)
-  , isIsrInstalled_(false)
+  , rigImplicitSize_(0)
+  , rigFreq_(0)
+  , rigSwitchUs_(0)
+  , rigSwitchMaxUs_(0)
+  , isRateAdaptive_(false)
+  , txProfile_(0)
+  , rxProfile_(0)
+  , rigProfile_(0)
+  , sentProfile_(0)
+  , lastRxMs_(0)
+  , lostPackets_(0)
+  , isRxStartPending_(false)
   , isRunning_(false)
   , shouldUpdateScreen_(false)
   , lastRssi_(0)
@@ -22,8 +38,8 @@ void RadioTask::start(std::shared_ptr<const Config> config, std::shared_ptr<Audi
 {
   config_ = config;
   audioTask_ = audioTask;
-  cipher_->setKey(config->AudioPrivacyKey_, sizeof(config->AudioPrivacyKey_));
-  xTaskCreate(&task, "RadioTask", CfgRadioTaskStack, this, 5, &loraTaskHandle_);
+  cipher_.setKey(config->AudioPrivacyKey_, sizeof(config->AudioPrivacyKey_));
+  xTaskCreatePinnedToCore(&task, "RadioTask", CfgRadioTaskStack, this, 5, &loraTaskHandle_, CfgRadioTaskCore);
 }
 
 void RadioTask::setupRig(long loraFreq, long bw, int sf, int cr, int pwr, int sync, int crcBytes)
@@ -38,28 +54,10 @@ void RadioTask::setupRig(long loraFreq, long bw, int sf, int cr, int pwr, int sy
   LOG_INFO("CRC:", crcBytes);
   LOG_INFO("Speed:", Utils::getLoraSpeed(sf, cr, bw), "bps");
   LOG_INFO("Min level:", Utils::getLoraSnrLimit(sf, bw));
-  rig_ = std::make_shared<MODULE_NAME>(new Module(config_->LoraPinSs_, config_->LoraPinA_, config_->LoraPinRst_, config_->LoraPinB_));
-  int state = rig_->begin((float)loraFreq / 1e6, (float)bw / 1e3, sf, cr, sync, pwr);
+  int state = rig_->beginLora(loraFreq, bw, sf, cr, pwr, sync, crcBytes, config_->LoraPreambleLen_);
   if (state != RADIOLIB_ERR_NONE) {
     LOG_ERROR("Radio start error:", state);
   }
-  rig_->setCRC(crcBytes);
-  rig_->setPreambleLength(config_->LoraPreambleLen_);
-#ifdef USE_SX126X
-    #pragma message("Using SX126X")
-    LOG_INFO("Using SX126X module");
-    rig_->setRfSwitchPins(config_->LoraPinSwitchRx_, config_->LoraPinSwitchTx_);
-    if (isIsrInstalled_) rig_->clearDio1Action();
-    rig_->setDio1Action(onRigIsrRxPacket);
-    isIsrInstalled_ = true;
-#else
-    #pragma message("Using SX127X")
-    LOG_INFO("Using SX127X module");
-    if (isIsrInstalled_) rig_->clearDio0Action();
-    rig_->setDio0Action(onRigIsrRxPacket, RISING);
-    isIsrInstalled_ = true;
-#endif
-  rig_->explicitHeader();
   LOG_INFO("LoRa initialized");
 }
 
@@ -72,69 +70,41 @@ void RadioTask::setupRigFsk(long freq, float bitRate, float freqDev, float rxBw,
   LOG_INFO("Bandwidth:", rxBw, "kHz");
   LOG_INFO("Power:", pwr, "dBm");
   LOG_INFO("Shaping:", shaping);
-  rig_ = std::make_shared<MODULE_NAME>(new Module(config_->LoraPinSs_, config_->LoraPinA_, config_->LoraPinRst_, config_->LoraPinB_));
-  int state = rig_->beginFSK((float)freq / 1e6, bitRate, freqDev, rxBw, pwr);
+  int state = rig_->beginFsk(freq, bitRate, freqDev, rxBw, pwr, shaping);
   if (state != RADIOLIB_ERR_NONE) {
     LOG_ERROR("Radio start error:", state);
   }
-  rig_->disableAddressFiltering();
-  rig_->setDataShaping(shaping);
-#ifdef USE_SX126X
-    #pragma message("Using SX126X")
-    LOG_INFO("Using SX126X module");
-    rig_->setRfSwitchPins(config_->LoraPinSwitchRx_, config_->LoraPinSwitchTx_);
-    if (isIsrInstalled_) rig_->clearDio1Action();
-    rig_->setDio1Action(onRigIsrRxPacket);
-    isIsrInstalled_ = true;
-#else
-    #pragma message("Using SX127X")
-    LOG_INFO("Using SX127X module");
-    if (isIsrInstalled_) rig_->clearDio0Action();
-    rig_->setDio0Action(onRigIsrRxPacket, RISING);
-    isIsrInstalled_ = true;
-#endif
   LOG_INFO("FSK initialized");
 }
 
 void RadioTask::setFreq(long loraFreq) const 
 {
-  rig_->setFrequency((float)loraFreq / (float)1e6);
+  rig_->setFrequency(loraFreq);
 }
 
-bool RadioTask::hasData() const 
+void RadioTask::setRigFreq(long freq)
 {
-  return loraRadioRxQueueIndex_.size() > 0;
-}
-
-bool RadioTask::readPacketSize(byte &packetSize)
-{
-  if (!hasData()) return false;
-  packetSize = loraRadioRxQueueIndex_.shift();
-  return true;
-}
-
-bool RadioTask::readNextByte(byte &b)
-{
-  if (loraRadioRxQueue_.size() == 0) return false;
-  b = loraRadioRxQueue_.shift();
-  return true;
-}
-
-bool RadioTask::writePacketSize(byte packetSize)
-{
-  return loraRadioTxQueueIndex_.push(packetSize);
-}
-
-bool RadioTask::writeNextByte(byte b) 
-{
-  return loraRadioTxQueue_.push(b);
+  // turnaround retunes the existing module, measure how long it takes
+  if (freq == rigFreq_) return;
+  uint32_t startUs = micros();
+  int state = rig_->setFrequency(freq);
+  rigSwitchUs_ = micros() - startUs;
+  if (rigSwitchUs_ > rigSwitchMaxUs_) rigSwitchMaxUs_ = rigSwitchUs_;
+  if (state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Set frequency error:", state, freq);
+    return;
+  }
+  LOG_DEBUG("Channel switch", freq, rigSwitchUs_, "us");
+  rigFreq_ = freq;
 }
 
 IRAM_ATTR void RadioTask::onRigIsrRxPacket() 
 {
-  if (!loraIsrEnabled_) return;
+  // same dio line signals rx packet and tx done depending on the radio mode
+  if (!loraIsrEnabled_ && !rigIsTxActive_) return;
   BaseType_t xHigherPriorityTaskWoken;
-  xTaskNotifyFromISR(loraTaskHandle_, CfgRadioRxBit, eSetBits, &xHigherPriorityTaskWoken);
+  xTaskNotifyFromISR(loraTaskHandle_, rigIsTxActive_ ? CfgRadioTxDoneBit : CfgRadioRxBit, 
+    eSetBits, &xHigherPriorityTaskWoken);
 }
 
 void RadioTask::task(void *param)
@@ -152,6 +122,18 @@ void RadioTask::startReceive() const
   xTaskNotify(loraTaskHandle_, CfgRadioRxStartBit, eSetBits);
 }
 
+void RadioTask::codecChanged() const
+{
+  xTaskNotify(loraTaskHandle_, CfgRadioCodecBit, eSetBits);
+}
+
+void RadioTask::packetsLost(int count)
+{
+  if (!isRateAdaptive_ || count <= 0) return;
+  lostPackets_.fetch_add(count, std::memory_order_relaxed);
+  xTaskNotify(loraTaskHandle_, CfgRadioLossBit, eSetBits);
+}
+
 void RadioTask::transmit() const
 {
   xTaskNotify(loraTaskHandle_, CfgRadioTxBit, eSetBits);
@@ -162,6 +144,11 @@ void RadioTask::rigTask()
   LOG_INFO("Radio task started");
   isRunning_ = true;
 
+  // hardware radio unless other device is provided
+  if (rig_ == nullptr) {
+    rig_ = std::make_shared<RadioDeviceRadioLib>(config_);
+  }
+  rig_->setIsr(onRigIsrRxPacket);
   if (config_->ModType == CFG_MOD_TYPE_LORA) {
     setupRig(config_->LoraFreqRx, config_->LoraBw, config_->LoraSf, 
       config_->LoraCodingRate, config_->LoraPower, config_->LoraSync_, config_->LoraCrc_);
@@ -169,11 +156,45 @@ void RadioTask::rigTask()
     setupRigFsk(config_->LoraFreqRx, config_->FskBitRate, config_->FskFreqDev,
       config_->FskRxBw, config_->LoraPower, config_->FskShaping);
   }
+  rigFreq_ = config_->LoraFreqRx;
   randomSeed(rig_->random(0x7FFFFFFF));
-  rigTaskStartReceive();
+  rigTaskCipherSetup();
+  logAirTime();
+
+  // validate split tx channel early, also calibrates its band
+  if (isHalfDuplex()) {
+    setRigFreq(config_->LoraFreqTx);
+    setRigFreq(config_->LoraFreqRx);
+    LOG_INFO("Channel switch:", rigSwitchMaxUs_, "us");
+  }
 
-  byte *packetBuf = new byte[CfgRadioPacketBufLen];
-  byte *tmpBuf = new byte[CfgRadioPacketBufLen];
+  // both peers start with the configured profile
+  isRateAdaptive_ = config_->LoraAdaptive && config_->ModType == CFG_MOD_TYPE_LORA;
+  if (isRateAdaptive_) {
+    rateController_.setup(*config_);
+    rigProfile_ = txProfile_ = rxProfile_ = sentProfile_ = rateController_.getBaseIndex();
+    LOG_INFO("Adaptive rate,", rateController_.getProfileCount(), "profiles");
+  }
+  // codec2 superframes have known size, lora header is not needed
+  rigIsImplicitMode_ = AirTime::isLoraImplicitHeader(*config_);
+  if (rigIsImplicitMode_) {
+    setRigImplicitHeader(rigProfile_);
+  } else if (config_->ModType == CFG_MOD_TYPE_LORA && (config_->LoraImplicit || config_->LoraSf == 6)) {
+    LOG_ERROR("Implicit header and SF6 need Codec2, using explicit header");
+  }
+
+  // packet buffers must be in place before the first receive interrupt
+  if (!radioArena_.reserve(3 * HeapArena::getBlockSize(CfgRadioPacketBufLen))) {
+    LOG_ERROR("Radio task stopped, no memory for packet buffers");
+    isRunning_ = false;
+    vTaskDelete(NULL);
+    return;
+  }
+  byte *packetBuf = radioArena_.allocate<byte>(CfgRadioPacketBufLen);
+  txBuf_[0] = radioArena_.allocate<byte>(CfgRadioPacketBufLen);
+  txBuf_[1] = radioArena_.allocate<byte>(CfgRadioPacketBufLen);
+  radioArena_.logReport();
+  rigTaskStartReceive();
 
   while (isRunning_) {
     uint32_t cmdBits = 0;
@@ -181,27 +202,109 @@ void RadioTask::rigTask()
 
     LOG_DEBUG("Radio task bits", cmdBits);
     if (cmdBits & CfgRadioRxBit) {
-      rigTaskReceive(packetBuf, tmpBuf);
+      rigTaskReceive(packetBuf);
+    }
+    if (cmdBits & CfgRadioTxDoneBit) {
+      rigTaskTransmitDone();
     }
-    else if (cmdBits & CfgRadioTxBit) {
-      rigTaskTransmit(packetBuf, tmpBuf);
+    if (cmdBits & CfgRadioTxBit) {
+      rigTaskTransmit();
     } 
     if (cmdBits & CfgRadioRxStartBit) {
-      rigTaskStartReceive();
+      // switch to receive after all queued packets are sent
+      if (rigIsTxActive_) 
+        isRxStartPending_ = true;
+      else
+        rigTaskStartReceive();
     }
     else if (cmdBits & CfgRadioTxStartBit) {
       rigTaskStartTransmit();
     }
+    if (cmdBits & CfgRadioLossBit) {
+      int lostCount = lostPackets_.exchange(0, std::memory_order_relaxed);
+      if (isRateAdaptive_ && lostCount > 0) rateController_.onPacketLost(lostCount);
+    }
+    if (cmdBits & CfgRadioCodecBit) {
+      rigTaskCodecChanged();
+    } else if (cmdBits & CfgRadioRateResetBit) {
+      rigTaskRateReset();
+    }
   } 
 
-  delete tmpBuf;
-  delete packetBuf;
+  txBuf_[0] = txBuf_[1] = nullptr;
+  radioArena_.release();
   LOG_INFO("Radio task stopped");
   vTaskDelete(NULL);
 }
 
+void RadioTask::logAirTime() const
+{
+  AirTimeReport report;
+  AirTime::evaluate(*config_, report);
+  LOG_INFO("Packet size:", report.payloadSize, "bytes,", report.framesPerPacket, "frames");
+  LOG_INFO("Air time:", report.packetAirTimeMs, "ms, audio:", report.packetAudioMs, "ms");
+  LOG_INFO("Duty cycle:", report.dutyCycle, "latency:", report.latencyMs, "ms");
+  if (!report.isRealTime) {
+    LOG_ERROR("Modulation is too slow for the audio codec, TX backlog will build up");
+  }
+}
+
+RateProfile RadioTask::getProfile(int profileIndex) const
+{
+  if (isRateAdaptive_) return rateController_.getProfile(profileIndex);
+  RateProfile profile;
+  profile.sf = config_->LoraSf;
+  profile.codecMode = config_->AudioCodec == CFG_AUDIO_CODEC_OPUS ? config_->AudioOpusRate : config_->AudioCodec2Mode;
+  return profile;
+}
+
+RateProfile RadioTask::getTxProfile() const
+{
+  return getProfile(txProfile_);
+}
+
+RateProfile RadioTask::getRxProfile() const
+{
+  return getProfile(rxProfile_);
+}
+
+void RadioTask::setRigProfile(int profileIndex)
+{
+  if (!isRateAdaptive_ || profileIndex == rigProfile_) return;
+  int sf = rateController_.getProfile(profileIndex).sf;
+  int state = rig_->setSpreadingFactor(sf);
+  if (state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Set spreading factor error:", state);
+    return;
+  }
+  LOG_INFO("Rate profile", profileIndex, "SF", sf);
+  rigProfile_ = profileIndex;
+  if (rigIsImplicitMode_) setRigImplicitHeader(profileIndex);
+}
+
+void RadioTask::setRigImplicitHeader(int profileIndex)
+{
+  // same size is derived by the peer from the shared config
+  AirTimeReport report;
+  RateProfile profile = getProfile(profileIndex);
+  AirTime::evaluate(*config_, profile.sf, profile.codecMode, report);
+  int state = rig_->implicitHeader(report.payloadSize);
+  if (state != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Implicit header error:", state);
+    return;
+  }
+  LOG_INFO("Implicit header, packet size", report.payloadSize);
+  rigImplicitSize_ = report.payloadSize;
+}
+
 bool RadioTask::loop() 
 {
+  // peer is gone or cannot hear us, fall back to the profile both sides know
+  if (isRateAdaptive_ && (txProfile_ != rateController_.getBaseIndex() || rxProfile_ != rateController_.getBaseIndex())
+      && millis() - lastRxMs_ > CfgRateResetMs) {
+    lastRxMs_ = millis();
+    xTaskNotify(loraTaskHandle_, CfgRadioRateResetBit, eSetBits);
+  }
   bool shouldUpdateScreen = shouldUpdateScreen_;
   shouldUpdateScreen_ = false;
   return shouldUpdateScreen;
@@ -210,7 +313,10 @@ bool RadioTask::loop()
 void RadioTask::rigTaskStartReceive() 
 {
   LOG_INFO("Start receive");
-  if (isHalfDuplex()) setFreq(config_->LoraFreqRx);
+  if (isHalfDuplex()) setRigFreq(config_->LoraFreqRx);
+  // peer transmits with the profile we have recommended in the last transmission
+  rxProfile_ = sentProfile_;
+  setRigProfile(rxProfile_);
   int loraRadioState = rig_->startReceive();
   if (loraRadioState != RADIOLIB_ERR_NONE) {
     LOG_ERROR("Start receive error: ", loraRadioState);
@@ -223,36 +329,97 @@ void RadioTask::rigTaskStartTransmit()
 {
   LOG_INFO("Start transmit");
   loraIsrEnabled_ = false;
-  if (isHalfDuplex()) setFreq(config_->LoraFreqTx);
+  if (isHalfDuplex()) setRigFreq(config_->LoraFreqTx);
+  setRigProfile(txProfile_);
+  // audio needs a few frames before first packet, enough to get keystream ready
+  if (config_->AudioEnPriv) cipher_.precompute();
+}
+
+void RadioTask::rigTaskRateReset()
+{
+  LOG_INFO("Rate profile reset");
+  rateController_.reset();
+  txProfile_ = sentProfile_ = rateController_.getBaseIndex();
+  // apply now if listening, otherwise on the next receive start
+  if (loraIsrEnabled_ && !rigIsTxActive_) rigTaskStartReceive();
 }
 
-void RadioTask::rigTaskReceive(byte *packetBuf, byte *tmpBuf) 
+void RadioTask::rigTaskCodecChanged()
 {
-  int packetSize = rig_->getPacketLength();
-  if (packetSize > 8 && packetSize < CfgRadioPacketBufLen) {
-    // receive packet
-    int state = rig_->readData(packetBuf, packetSize);
-    if (state == RADIOLIB_ERR_NONE) {
-      byte *receiveBuf = packetBuf;
-      // if privacy enabled
-      if (config_->AudioEnPriv){
-        // read iv and decrypt packet
-        cipher_->setIV(packetBuf, sizeof(iv_));
-        packetSize -= sizeof(iv_);
-        cipher_->decrypt(tmpBuf, packetBuf + sizeof(iv_), packetSize);
-        receiveBuf = tmpBuf;
-      }
+  // implicit header size and profile codec modes are derived from the codec
+  bool isImplicitMode = AirTime::isLoraImplicitHeader(*config_);
+  if (rigIsImplicitMode_ && !isImplicitMode) {
+    int state = rig_->explicitHeader();
+    if (state != RADIOLIB_ERR_NONE) {
+      LOG_ERROR("Explicit header error:", state);
+    }
+  }
+  rigIsImplicitMode_ = isImplicitMode;
+  if (isRateAdaptive_) {
+    // both peers start over from the configured profile, it is applied on the next receive start
+    rateController_.setup(*config_);
+    LOG_INFO("Adaptive rate,", rateController_.getProfileCount(), "profiles");
+    rigProfile_ = -1;
+    rigTaskRateReset();
+  } else if (rigIsImplicitMode_) {
+    setRigImplicitHeader(rigProfile_);
+  }
+  // privacy could have been enabled from the menu
+  rigTaskCipherSetup();
+}
+
+void RadioTask::rigTaskCipherSetup()
+{
+  // salted even with privacy off, nonces never repeat ones of previous boots or settings
+  cipher_.setSalt(rig_->random(0x7FFFFFFF));
+  // keystream ahead only for the longest audio packet, larger ones are encrypted inline
+  int headerSize = config_->AudioVoiceHdr ? VoiceHeader::CfgSize : 0;
+  cipher_.setStreamSize(min(config_->AudioMaxPktSize, getMaxPacketSize()) + headerSize);
+  if (config_->AudioEnPriv) cipher_.precompute();
+}
+
+void RadioTask::rigTaskReceive(byte *packetBuf) 
+{
+  int packetSize = rigIsImplicitMode_ ? rigImplicitSize_ : rig_->getPacketLength();
+  int headerSize = isRateAdaptive_ ? CfgRadioRateDescLen : 0;
+  int minPacketSize = headerSize + (config_->AudioEnPriv ? RadioCipher::CfgOverhead : 0);
+  if (packetSize > minPacketSize && packetSize < CfgRadioPacketBufLen) {
+    // receive packet directly into the queue slot, headers are skipped by offset
+    byte *rxBuf = loraRadioRxQueue_.writeBegin();
+    byte *readBuf = rxBuf == nullptr ? packetBuf : rxBuf;
+    int state = rig_->readData(readBuf, packetSize);
+    int payloadOffset = headerSize;
+    int payloadSize = packetSize - headerSize;
+    bool isValid = state == RADIOLIB_ERR_NONE;
+    // foreign or damaged packets are dropped before they reach audio task
+    if (isValid && config_->AudioEnPriv) {
+      payloadSize = cipher_.decrypt(readBuf, headerSize, packetSize);
+      payloadOffset += RadioCipher::CfgNonceLen;
+      isValid = payloadSize > 0;
+      if (!isValid) LOG_ERROR("Packet authentication failed");
+    }
+    if (isValid && isRateAdaptive_) {
+      // peer tells which profile it is sending with and which one we should use
+      uint8_t descriptor = readBuf[0];
+      int peerRxProfile = RateController::getDescriptorRxIndex(descriptor);
+      if (rateController_.isValidIndex(peerRxProfile)) txProfile_ = peerRxProfile;
+      rateController_.onPacketReceived(rig_->getSnr());
+      lastRxMs_ = millis();
+    } else if (state == RADIOLIB_ERR_CRC_MISMATCH && isRateAdaptive_ && !config_->AudioVoiceHdr) {
+      // with voice header damaged packets show up as sequence gaps, so they are not counted twice
+      rateController_.onPacketLost(1);
+    }
+    if (state != RADIOLIB_ERR_NONE) {
+      LOG_ERROR("Read data error: ", state);
+    } else if (rxBuf == nullptr) {
+      LOG_ERROR("RX queue is full, packet dropped");
+    } else if (isValid) {
       // send packet to the queue
-      LOG_DEBUG("Received packet, size", packetSize);
-      for (int i = 0; i < packetSize; i++) {
-        loraRadioRxQueue_.push(receiveBuf[i]);
-      }
-      loraRadioRxQueueIndex_.push(packetSize);
+      LOG_DEBUG("Received packet, size", payloadSize);
+      loraRadioRxQueue_.writeEnd(payloadSize, payloadOffset);
       audioTask_->play();
-    } else {
-      LOG_ERROR("Read data error: ", state);
     }
-    lastRssi_ = rig_->getRSSI();
+    lastRssi_ = rig_->getRssi();
     // probably not needed, still in receive
     state = rig_->startReceive();
     if (state != RADIOLIB_ERR_NONE) {
@@ -263,37 +430,87 @@ void RadioTask::rigTaskReceive(byte *packetBuf, byte *tmpBuf)
   }
 }
 
-void RadioTask::rigTaskTransmit(byte *packetBuf, byte *tmpBuf) 
+void RadioTask::rigTaskTransmit() 
 {
-  while (loraRadioTxQueueIndex_.size() > 0) {
-    // fetch packet size and packet from the queue
-    int txBytesCnt = loraRadioTxQueueIndex_.shift();
-    for (int i = 0; i < txBytesCnt; i++) {
-        packetBuf[i] = loraRadioTxQueue_.shift();
-    }
-    byte *sendBuf = packetBuf;
-    // if privacy enabled
-    if (config_->AudioEnPriv) {
-      // generate IV
-      for (int i = 0; i < sizeof(iv_); i++) {
-        iv_[i] = random(255);
-        tmpBuf[i] = iv_[i];
-      }
-      // encrypt
-      cipher_->setIV(iv_, sizeof(iv_));
-      cipher_->encrypt(tmpBuf + sizeof(iv_), packetBuf, txBytesCnt);
-      txBytesCnt += sizeof(iv_);
-      sendBuf = tmpBuf;
-    }
-    // transmit
-    int loraRadioState = rig_->transmit(sendBuf, txBytesCnt);
-    if (loraRadioState != RADIOLIB_ERR_NONE) {
-        LOG_ERROR("Radio transmit failed:", loraRadioState, txBytesCnt);
-    } else {
-      LOG_DEBUG("Transmitted packet", txBytesCnt);
+  // if radio is busy, packet is prepared now and sent on tx done
+  if (rigIsTxActive_) {
+    if (txBufSize_[txBufIndex_ ^ 1] == 0) 
+      rigTaskTransmitPrepare(txBufIndex_ ^ 1);
+  } else {
+    rigTaskTransmitNext();
+  }
+}
+
+void RadioTask::rigTaskTransmitNext()
+{
+  // packet could be already prepared while previous one was on air
+  if (txBufSize_[txBufIndex_] == 0 && !rigTaskTransmitPrepare(txBufIndex_)) return;
+  rigIsTxActive_ = true;
+  int loraRadioState = rig_->startTransmit(txBuf_[txBufIndex_], txBufSize_[txBufIndex_]);
+  if (loraRadioState != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Radio start transmit failed:", loraRadioState, txBufSize_[txBufIndex_]);
+    rigIsTxActive_ = false;
+    txBufSize_[txBufIndex_] = 0;
+    return;
+  }
+  // prepare next packet while current one is on air
+  rigTaskTransmitPrepare(txBufIndex_ ^ 1);
+  if (config_->AudioEnPriv) cipher_.precompute();
+}
+
+void RadioTask::rigTaskTransmitDone()
+{
+  int loraRadioState = rig_->finishTransmit();
+  if (loraRadioState != RADIOLIB_ERR_NONE) {
+    LOG_ERROR("Radio transmit failed:", loraRadioState, txBufSize_[txBufIndex_]);
+  } else {
+    LOG_DEBUG("Transmitted packet", txBufSize_[txBufIndex_]);
+  }
+  rigIsTxActive_ = false;
+  txBufSize_[txBufIndex_] = 0;
+  txBufIndex_ ^= 1;
+  rigTaskTransmitNext();
+  if (!rigIsTxActive_ && isRxStartPending_) {
+    isRxStartPending_ = false;
+    rigTaskStartReceive();
+  }
+}
+
+bool RadioTask::rigTaskTransmitPrepare(int txBufIndex) 
+{
+  PacketView packet;
+  if (!loraRadioTxQueue_.readBegin(packet)) return false;
+  byte *txBuf = txBuf_[txBufIndex];
+  int headerSize = 0;
+  if (isRateAdaptive_) {
+    // tell the peer which profile we are sending with and which one it should use
+    sentProfile_ = rateController_.getRecommended();
+    txBuf[0] = RateController::encodeDescriptor(txProfile_, sentProfile_);
+    headerSize = CfgRadioRateDescLen;
+  }
+  int payloadSize = packet.size;
+  int overheadSize = headerSize + (config_->AudioEnPriv ? RadioCipher::CfgOverhead : 0);
+  // implicit header packets have fixed size, padding is encrypted with the payload
+  if (rigIsImplicitMode_) {
+    if (payloadSize + overheadSize > rigImplicitSize_) {
+      LOG_ERROR("Packet does not fit implicit header size", payloadSize + overheadSize, rigImplicitSize_);
+      loraRadioTxQueue_.readEnd();
+      return false;
     }
-    vTaskDelay(1);
+    memset(packet.data + payloadSize, 0, rigImplicitSize_ - overheadSize - payloadSize);
+    payloadSize = rigImplicitSize_ - overheadSize;
   }
+  int txBytesCnt;
+  if (config_->AudioEnPriv) {
+    // keystream is precomputed, encryption is done while copying from the queue slot
+    txBytesCnt = cipher_.encrypt(txBuf, headerSize, packet.data, payloadSize);
+  } else {
+    memcpy(txBuf + headerSize, packet.data, payloadSize);
+    txBytesCnt = headerSize + payloadSize;
+  }
+  loraRadioTxQueue_.readEnd();
+  txBufSize_[txBufIndex] = txBytesCnt;
+  return true;
 }
 
 } // LoraDv
\ No newline at end of file
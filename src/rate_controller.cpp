@@ -0,0 +1,104 @@
+#include <codec2.h>
+
+#include "rate_controller.h"
+#include "air_time.h"
+#include "loradv_config.h"
+
+namespace LoraDv {
+
+static const int Codec2Modes[] = {
+  CODEC2_MODE_3200, CODEC2_MODE_2400, CODEC2_MODE_1600, CODEC2_MODE_1400, 
+  CODEC2_MODE_1300, CODEC2_MODE_1200, CODEC2_MODE_700C 
+};
+static const int OpusRates[] = { 16000, 12000, 9600, 8000, 6400, 4800, 3200, 2400 };
+
+RateController::RateController()
+  : profileCount_(0)
+  , baseIndex_(0)
+  , recommended_(0)
+  , packetsSinceStep_(0)
+  , hasSnr_(false)
+  , snrAvg_(0)
+  , lossAvg_(0)
+{
+}
+
+void RateController::setup(const Config &config)
+{
+  // from dense to robust, best real time codec mode for each spreading factor
+  bool isOpus = config.AudioCodec == CFG_AUDIO_CODEC_OPUS;
+  const int *modes = isOpus ? OpusRates : Codec2Modes;
+  int modesCount = isOpus ? sizeof(OpusRates) / sizeof(int) : sizeof(Codec2Modes) / sizeof(int);
+  profileCount_ = 0;
+  baseIndex_ = 0;
+  int minSf = AirTime::isLoraImplicitHeader(config) ? 6 : 7;
+  for (int sf = minSf; sf <= 12 && profileCount_ < CfgMaxProfiles; sf++) {
+    int codecMode = -1;
+    for (int i = 0; i < modesCount; i++) {
+      AirTimeReport report;
+      AirTime::evaluate(config, sf, modes[i], report);
+      if (report.isRealTime) {
+        codecMode = modes[i];
+        break;
+      }
+    }
+    // configured profile is always there as fallback
+    if (sf == config.LoraSf) {
+      codecMode = isOpus ? config.AudioOpusRate : config.AudioCodec2Mode;
+      baseIndex_ = profileCount_;
+    }
+    if (codecMode < 0) continue;
+    profiles_[profileCount_].sf = sf;
+    profiles_[profileCount_].codecMode = codecMode;
+    profileCount_++;
+  }
+  reset();
+}
+
+void RateController::reset()
+{
+  recommended_ = baseIndex_;
+  packetsSinceStep_ = 0;
+  hasSnr_ = false;
+  snrAvg_ = 0;
+  lossAvg_ = 0;
+}
+
+void RateController::onPacketReceived(float snr)
+{
+  snrAvg_ = hasSnr_ ? snrAvg_ + CfgAvgFactor * (snr - snrAvg_) : snr;
+  hasSnr_ = true;
+  lossAvg_ -= CfgAvgFactor * lossAvg_;
+  update();
+}
+
+void RateController::onPacketLost(int count)
+{
+  for (int i = 0; i < count; i++) {
+    lossAvg_ += CfgAvgFactor * (1.0f - lossAvg_);
+  }
+  update();
+}
+
+void RateController::update()
+{
+  if (profileCount_ == 0 || !hasSnr_) return;
+  if (++packetsSinceStep_ < CfgMinPacketsPerStep) return;
+
+  // snr does not depend on spreading factor for the same bandwidth
+  float margin = snrAvg_ - AirTime::getLoraRequiredSnr(profiles_[recommended_].sf);
+  if (lossAvg_ > CfgLossStepDown || margin < CfgSnrMarginDb) {
+    if (recommended_ + 1 < profileCount_) {
+      recommended_++;
+      packetsSinceStep_ = 0;
+    }
+  } else if (recommended_ > 0 && lossAvg_ < CfgLossStepUp) {
+    float denserMargin = snrAvg_ - AirTime::getLoraRequiredSnr(profiles_[recommended_ - 1].sf);
+    if (denserMargin >= CfgSnrMarginDb + CfgSnrHysteresisDb) {
+      recommended_--;
+      packetsSinceStep_ = 0;
+    }
+  }
+}
+
+} // LoraDv
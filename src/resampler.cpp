@@ -0,0 +1,99 @@
+#include <math.h>
+#include <string.h>
+
+#include "resampler.h"
+
+namespace LoraDv {
+
+Resampler::Resampler()
+  : up_(1)
+  , down_(1)
+  , taps_(0)
+  , phase_(0)
+  , pos_(0)
+{
+  memset(coefs_, 0, sizeof(coefs_));
+  memset(history_, 0, sizeof(history_));
+}
+
+static int gcd(int a, int b)
+{
+  while (b != 0) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+bool Resampler::setup(int inRate, int outRate)
+{
+  up_ = down_ = 1;
+  taps_ = 0;
+  if (inRate <= 0 || outRate <= 0) return false;
+  int divisor = gcd(inRate, outRate);
+  int up = outRate / divisor;
+  int down = inRate / divisor;
+  if (up > CfgMaxRatio || down > CfgMaxRatio) return false;
+  up_ = up;
+  down_ = down;
+  reset();
+  if (!isActive()) return true;
+
+  // decimation needs longer filter for the same transition band at the lower rate
+  taps_ = CfgTapsPerPhase * ((down_ + up_ - 1) / up_);
+  int length = taps_ * up_;
+  // cutoff is normalized to the upsampled rate, below nyquist of the lower rate
+  float cutoff = CfgPassbandPercent / 100.0f * 0.5f / (up_ > down_ ? up_ : down_);
+  float center = (length - 1) / 2.0f;
+  float h[CfgMaxTaps];
+  float sum = 0;
+  for (int k = 0; k < length; k++) {
+    float t = k - center;
+    float sinc = t == 0 ? 2.0f * cutoff : sinf(2.0f * (float)M_PI * cutoff * t) / ((float)M_PI * t);
+    float window = 0.42f - 0.5f * cosf(2.0f * (float)M_PI * k / (length - 1)) 
+      + 0.08f * cosf(4.0f * (float)M_PI * k / (length - 1));
+    h[k] = sinc * window;
+    sum += h[k];
+  }
+  // every phase gets unity dc gain on average, upsampling gain is included
+  float scale = up_ * (float)(1 << CfgCoefShift) / sum;
+  for (int p = 0; p < up_; p++) {
+    for (int i = 0; i < taps_; i++) {
+      coefs_[p * taps_ + i] = (int16_t)lrintf(h[p + i * up_] * scale);
+    }
+  }
+  return true;
+}
+
+void Resampler::reset()
+{
+  phase_ = 0;
+  pos_ = 0;
+  memset(history_, 0, sizeof(history_));
+}
+
+int Resampler::process(const int16_t *in, int inCount, int16_t *out, int maxOutCount)
+{
+  int outCount = 0;
+  for (int n = 0; n < inCount; n++) {
+    pos_ = (pos_ == 0 ? taps_ : pos_) - 1;
+    history_[pos_] = history_[pos_ + taps_] = in[n];
+    // outputs which fall between this input and the next one
+    for (; phase_ < up_; phase_ += down_) {
+      if (outCount == maxOutCount) continue;
+      const int16_t *coef = coefs_ + phase_ * taps_;
+      const int16_t *x = history_ + pos_;
+      int32_t acc = 1 << (CfgCoefShift - 1);
+      for (int i = 0; i < taps_; i++) {
+        acc += (int32_t)coef[i] * x[i];
+      }
+      acc >>= CfgCoefShift;
+      out[outCount++] = acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc);
+    }
+    phase_ -= up_;
+  }
+  return outCount;
+}
+
+} // LoraDv
@@ -162,6 +162,42 @@ public:
   void getValue(std::stringstream &s) const { s << config_->AudioMaxPktSize << "bytes"; }
 };
 
+class SettingsAudioCodec2BitPackItem : public SettingsItem {
+public:
+  SettingsAudioCodec2BitPackItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioCodec2BitPack = !config_->AudioCodec2BitPack;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Bit Packing"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioCodec2BitPack ? "ON" : "OFF"); }
+};
+
+class SettingsAudioFecDepthItem : public SettingsItem {
+public:
+  SettingsAudioFecDepthItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    int newVal = config_->AudioFecDepth + delta;
+    if (newVal >= 0 && newVal <= VoiceFec::CfgMaxDepth) config_->AudioFecDepth = newVal;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Codec2 FEC"; }
+  void getValue(std::stringstream &s) const { 
+    if (config_->AudioFecDepth == 0) 
+      s << "OFF";
+    else
+      s << config_->AudioFecDepth << "+1 pkts";
+  }
+};
+
+class SettingsAudioVoiceHdrItem : public SettingsItem {
+public:
+  SettingsAudioVoiceHdrItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioVoiceHdr = !config_->AudioVoiceHdr;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Voice Header"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioVoiceHdr ? "ON" : "OFF"); }
+};
+
 class SettingsAudioOpusRate : public SettingsItem {
 public:
   SettingsAudioOpusRate(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
@@ -173,6 +209,36 @@ public:
   void getValue(std::stringstream &s) const { s << config_->AudioOpusRate << "bps"; }
 };
 
+class SettingsAudioOpusSuperframeItem : public SettingsItem {
+public:
+  SettingsAudioOpusSuperframeItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioOpusSuperframe = !config_->AudioOpusSuperframe;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".OPUS Superframe"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioOpusSuperframe ? "ON" : "OFF"); }
+};
+
+class SettingsAudioOpusCbrItem : public SettingsItem {
+public:
+  SettingsAudioOpusCbrItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioOpusCbr = !config_->AudioOpusCbr;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".OPUS CBR"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioOpusCbr ? "ON" : "OFF"); }
+};
+
+class SettingsAudioOpusFecItem : public SettingsItem {
+public:
+  SettingsAudioOpusFecItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioOpusFec = !config_->AudioOpusFec;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".OPUS FEC"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioOpusFec ? "ON" : "OFF"); }
+};
+
 class SettingsAudioOpusPcmLen : public SettingsItem {
 private:
   static const int CfgItemsCount = 9;
@@ -208,6 +274,57 @@ public:
   void getValue(std::stringstream &s) const { s << config_->AudioVol << "%"; }
 };
 
+class SettingsAudioMicDspItem : public SettingsItem {
+public:
+  SettingsAudioMicDspItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioMicDsp = !config_->AudioMicDsp;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Mic DSP"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioMicDsp ? "ON" : "OFF"); }
+};
+
+class SettingsAudioNoiseSupItem : public SettingsItem {
+public:
+  SettingsAudioNoiseSupItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioNoiseSup = !config_->AudioNoiseSup;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Noise Supp"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioNoiseSup ? "ON" : "OFF"); }
+};
+
+class SettingsAudioDtxItem : public SettingsItem {
+public:
+  SettingsAudioDtxItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioDtx = !config_->AudioDtx;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".DTX"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioDtx ? "ON" : "OFF"); }
+};
+
+class SettingsAudioVoxItem : public SettingsItem {
+public:
+  SettingsAudioVoxItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->AudioVox = !config_->AudioVox;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".VOX"; }
+  void getValue(std::stringstream &s) const { s << (config_->AudioVox ? "ON" : "OFF"); }
+};
+
+class SettingsAudioVoxHangMsItem : public SettingsItem {
+public:
+  SettingsAudioVoxHangMsItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    long newVal = config_->AudioVoxHangMs + 100 * delta;
+    if (newVal >= 100 && newVal <= 3000) config_->AudioVoxHangMs = newVal;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".VOX Hang"; }
+  void getValue(std::stringstream &s) const { s << config_->AudioVoxHangMs << "ms"; }
+};
+
 class SettingsAudioEnablePrivacy : public SettingsItem {
 public:
   SettingsAudioEnablePrivacy(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
@@ -288,7 +405,7 @@ public:
   SettingsLoraSfItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
   void changeValue(int delta) { 
     long newVal = config_->LoraSf + delta;
-    if (newVal >= 7 && newVal <= 12) config_->LoraSf = newVal;
+    if (newVal >= 6 && newVal <= 12) config_->LoraSf = newVal;
   }
   void getName(std::stringstream &s) const { s << index_ << ".LoRa Spreading"; }
   void getValue(std::stringstream &s) const { s << config_->LoraSf; }
@@ -305,6 +422,26 @@ public:
   void getValue(std::stringstream &s) const { s << config_->LoraCodingRate; }
 };
 
+class SettingsLoraAdaptiveItem : public SettingsItem {
+public:
+  SettingsLoraAdaptiveItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->LoraAdaptive = !config_->LoraAdaptive;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Adaptive Rate"; }
+  void getValue(std::stringstream &s) const { s << (config_->LoraAdaptive ? "ON" : "OFF"); }
+};
+
+class SettingsLoraImplicitItem : public SettingsItem {
+public:
+  SettingsLoraImplicitItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { 
+    config_->LoraImplicit = !config_->LoraImplicit;
+  }
+  void getName(std::stringstream &s) const { s << index_ << ".Implicit Header"; }
+  void getValue(std::stringstream &s) const { s << (config_->LoraImplicit ? "ON" : "OFF"); }
+};
+
 class SettingsFskBitRate : public SettingsItem {
 public:
   SettingsFskBitRate(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
@@ -461,6 +598,20 @@ public:
   }
 };
 
+class SettingsAirTimeItem : public SettingsItem {
+public:
+  SettingsAirTimeItem(std::shared_ptr<Config> config, int index) : SettingsItem(config, index) {}
+  void changeValue(int delta) { }
+  void getName(std::stringstream &s) const { s << index_ << ".Air Time"; }
+  void getValue(std::stringstream &s) const { 
+    AirTimeReport report;
+    AirTime::evaluate(*config_, report);
+    s << "Pkt:" << report.payloadSize << "B " << (int)report.packetAirTimeMs << "ms" << std::endl;
+    s << "Duty:" << (int)(100 * report.dutyCycle) << "% Lat:" << (int)report.latencyMs << "ms" << std::endl;
+    s << (report.isRealTime ? "Real time OK" : "Too slow, backlog!");
+  }
+};
+
 SettingsMenu::SettingsMenu(std::shared_ptr<Config> config)
   : config_(config)
   , selectedMenuItemIndex_(0)
@@ -478,16 +629,29 @@ SettingsMenu::SettingsMenu(std::shared_ptr<Config> config)
   // codec2
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioCodec2ModeItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioMaxPktSizeItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioCodec2BitPackItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioFecDepthItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioVoiceHdrItem(config, ++i)));
   // opus
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioOpusRate(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioOpusPcmLen(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioOpusSuperframeItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioOpusCbrItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioOpusFecItem(config, ++i)));
   // audio
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioVolItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioMicDspItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioNoiseSupItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioDtxItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioVoxItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioVoxHangMsItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAudioEnablePrivacy(config, ++i)));
   // lora
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsLoraBwItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsLoraSfItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsLoraCrItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsLoraAdaptiveItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsLoraImplicitItem(config, ++i)));
   // fsk
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsFskBitRate(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsFskFreqDev(config, ++i)));
@@ -499,9 +663,16 @@ SettingsMenu::SettingsMenu(std::shared_ptr<Config> config)
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsSaveItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsResetItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsRebootItem(config, ++i)));
+  items_.push_back(std::shared_ptr<SettingsItem>(new SettingsAirTimeItem(config, ++i)));
   items_.push_back(std::shared_ptr<SettingsItem>(new SettingsInfoItem(config, ++i)));
 }
 
+void SettingsMenu::reset()
+{
+  selectedMenuItemIndex_ = 0;
+  isValueSelected_ = false;
+}
+
 void SettingsMenu::draw(std::shared_ptr<Adafruit_SSD1306> display) 
 {
   std::stringstream s;
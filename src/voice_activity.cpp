@@ -0,0 +1,62 @@
+#include "voice_activity.h"
+
+namespace LoraDv {
+
+VoiceActivityDetector::VoiceActivityDetector()
+  : hangFramesMax_(0)
+  , hangFrames_(0)
+  , onsetFrames_(0)
+  , learnFrames_(0)
+  , noiseLevel_(CfgMinNoiseLevel)
+{
+}
+
+void VoiceActivityDetector::setup(int frameMs, int hangMs)
+{
+  hangFramesMax_ = frameMs > 0 ? (hangMs + frameMs - 1) / frameMs : 0;
+  noiseLevel_ = CfgMinNoiseLevel;
+  learnFrames_ = frameMs > 0 ? (CfgLearnMs + frameMs - 1) / frameMs : 0;
+  reset();
+}
+
+void VoiceActivityDetector::reset()
+{
+  // noise floor is kept, mic and surroundings do not change between transmissions
+  hangFrames_ = 0;
+  onsetFrames_ = 0;
+}
+
+bool VoiceActivityDetector::process(const int16_t *pcm, int sampleCount)
+{
+  if (sampleCount <= 0) return isActive();
+  int32_t sum = 0;
+  for (int i = 0; i < sampleCount; i++) {
+    sum += pcm[i] < 0 ? -(int32_t)pcm[i] : pcm[i];
+  }
+  int32_t level = sum / sampleCount;
+
+  // loud background right after setup is not taken for speech
+  bool isLearning = learnFrames_ > 0;
+  if (isLearning) learnFrames_--;
+  bool isSpeech = !isLearning && level >= CfgMinSpeechLevel && level >= CfgSpeechRatio * noiseLevel_;
+  if (level < noiseLevel_) {
+    noiseLevel_ -= (noiseLevel_ - level + (1 << CfgNoiseDownShift) - 1) >> CfgNoiseDownShift;
+  } else if (isLearning) {
+    noiseLevel_ += (level - noiseLevel_ + (1 << CfgNoiseDownShift) - 1) >> CfgNoiseDownShift;
+  } else {
+    // rises during speech too, but much slower, so the floor follows new steady noise
+    noiseLevel_ += (level - noiseLevel_) >> (isSpeech ? CfgNoiseUpShift + CfgSpeechUpShift : CfgNoiseUpShift);
+  }
+  if (noiseLevel_ < CfgMinNoiseLevel) noiseLevel_ = CfgMinNoiseLevel;
+
+  // single loud frames like clicks do not start speech
+  onsetFrames_ = isSpeech ? onsetFrames_ + 1 : 0;
+  if (isSpeech && (isActive() || onsetFrames_ >= CfgOnsetFrames)) {
+    hangFrames_ = hangFramesMax_ + 1;
+  } else if (hangFrames_ > 0) {
+    hangFrames_--;
+  }
+  return isActive();
+}
+
+} // LoraDv
@@ -0,0 +1,286 @@
+#include <string.h>
+
+#include "voice_fec.h"
+
+namespace LoraDv {
+
+VoiceFec::VoiceFec()
+  : depth_(0)
+  , frameSize_(0)
+  , packetSize_(0)
+  , framesPerPacket_(0)
+  , maxFrames_(0)
+  , frames_(nullptr)
+{
+}
+
+void VoiceFec::setup(int depth, int frameSize, int maxPacketSize, uint8_t *frames)
+{
+  if (frameSize < CfgMinFrameSize) frameSize = CfgMinFrameSize;
+  depth_ = getDepth(depth);
+  frameSize_ = frameSize;
+  packetSize_ = getPacketSize(maxPacketSize);
+  framesPerPacket_ = getFramesPerPacket(frameSize, packetSize_, depth_);
+  maxFrames_ = depth_ * framesPerPacket_;
+  frames_ = frames;
+}
+
+int VoiceFec::getPacketFrameCount(int index, int blockFrameCount) const
+{
+  // packet index holds frames index, index + depth, index + 2 * depth, ...
+  if (index >= blockFrameCount) return 0;
+  return (blockFrameCount - index + depth_ - 1) / depth_;
+}
+
+VoiceFecEncoder::VoiceFecEncoder()
+  : frameCount_(0)
+  , blockSeq_(0)
+{
+}
+
+size_t VoiceFecEncoder::getBufferSize(int depth, int maxPacketSize)
+{
+  return (size_t)getDepth(depth) * getPacketSize(maxPacketSize);
+}
+
+void VoiceFecEncoder::setup(int depth, int frameSize, int maxPacketSize, uint8_t *buffer)
+{
+  VoiceFec::setup(depth, frameSize, maxPacketSize, buffer);
+  frameCount_ = 0;
+}
+
+bool VoiceFecEncoder::writeFrame(const uint8_t *frame)
+{
+  if (frameCount_ < maxFrames_) {
+    memcpy(frames_ + frameCount_ * frameSize_, frame, frameSize_);
+    frameCount_++;
+  }
+  return frameCount_ >= maxFrames_;
+}
+
+int VoiceFecEncoder::getPacketCount() const
+{
+  int dataCount = frameCount_ < depth_ ? frameCount_ : depth_;
+  return dataCount > 0 ? dataCount + 1 : 0;
+}
+
+int VoiceFecEncoder::readPacket(int index, uint8_t *packetOut) const
+{
+  int dataCount = getPacketCount() - 1;
+  if (index < dataCount) {
+    packetOut[0] = (blockSeq_ << 4) | index;
+    uint8_t *out = packetOut + CfgDataHeaderSize;
+    for (int f = index; f < frameCount_; f += depth_) {
+      memcpy(out, frames_ + f * frameSize_, frameSize_);
+      out += frameSize_;
+    }
+    return out - packetOut;
+  }
+  // parity over data payloads, shorter payloads are zero padded
+  packetOut[0] = (blockSeq_ << 4) | CfgParityFlag;
+  packetOut[1] = frameCount_;
+  uint8_t *out = packetOut + CfgParityHeaderSize;
+  int paritySize = getPacketFrameCount(0, frameCount_) * frameSize_;
+  memset(out, 0, paritySize);
+  for (int f = 0; f < frameCount_; f++) {
+    uint8_t *parityFrame = out + (f / depth_) * frameSize_;
+    const uint8_t *frame = frames_ + f * frameSize_;
+    for (int i = 0; i < frameSize_; i++) {
+      parityFrame[i] ^= frame[i];
+    }
+  }
+  return paritySize + CfgParityHeaderSize;
+}
+
+void VoiceFecEncoder::nextBlock()
+{
+  frameCount_ = 0;
+  blockSeq_ = (blockSeq_ + 1) & 0x0F;
+}
+
+VoiceFecDecoder::VoiceFecDecoder()
+  : packets_(nullptr)
+  , parityFrameCount_(0)
+  , blockSeq_(0)
+  , isCollecting_(false)
+  , isBlockDone_(false)
+  , erased_(nullptr)
+  , frameCount_(0)
+  , readFrameIndex_(0)
+  , recoveredCount_(0)
+  , erasedCount_(0)
+{
+}
+
+size_t VoiceFecDecoder::getBufferSize(int depth, int maxPacketSize)
+{
+  // frames, payloads with parity and erasure flags of the smallest frames
+  size_t blockSize = (size_t)getDepth(depth) * getPacketSize(maxPacketSize);
+  return blockSize + blockSize + getPacketSize(maxPacketSize) + blockSize / CfgMinFrameSize * sizeof(bool);
+}
+
+void VoiceFecDecoder::setup(int depth, int frameSize, int maxPacketSize, uint8_t *buffer)
+{
+  VoiceFec::setup(depth, frameSize, maxPacketSize, buffer);
+  size_t blockSize = (size_t)depth_ * packetSize_;
+  packets_ = buffer + blockSize;
+  erased_ = (bool*)(packets_ + blockSize + packetSize_);
+  isCollecting_ = false;
+  isBlockDone_ = false;
+  frameCount_ = 0;
+  readFrameIndex_ = 0;
+}
+
+void VoiceFecDecoder::startBlock(uint8_t blockSeq)
+{
+  memset(packetSizes_, 0, sizeof(packetSizes_));
+  parityFrameCount_ = 0;
+  blockSeq_ = blockSeq;
+  isCollecting_ = true;
+  isBlockDone_ = false;
+}
+
+bool VoiceFecDecoder::writePacket(const uint8_t *packet, int packetSize)
+{
+  if (packetSize <= CfgDataHeaderSize) return false;
+  uint8_t blockSeq = packet[0] >> 4;
+  bool isParity = packet[0] & CfgParityFlag;
+  int index = isParity ? depth_ : packet[0] & CfgIndexMask;
+  if (index > depth_) return false;
+
+  // late packet of already completed block
+  if (isBlockDone_ && blockSeq == blockSeq_) return false;
+
+  // packet from the next block completes current one
+  bool isCompleted = false;
+  if (isCollecting_ && blockSeq != blockSeq_) {
+    completeBlock();
+    isCompleted = true;
+  }
+  if (!isCollecting_) startBlock(blockSeq);
+
+  // implicit header padding beyond the packet size is dropped
+  int headerSize = isParity ? CfgParityHeaderSize : CfgDataHeaderSize;
+  int payloadSize = packetSize - headerSize;
+  if (payloadSize > packetSize_) payloadSize = packetSize_;
+  if (payloadSize > 0) {
+    memcpy(getPacket(index), packet + headerSize, payloadSize);
+    packetSizes_[index] = payloadSize;
+    if (isParity) parityFrameCount_ = packet[1];
+  }
+  // previous block must be read first, current one completes on next packet
+  if (isCompleted) return true;
+
+  if (isBlockComplete()) {
+    completeBlock();
+    return true;
+  }
+  return false;
+}
+
+bool VoiceFecDecoder::isBlockComplete() const
+{
+  int dataCount = depth_;
+  if (parityFrameCount_ > 0 && parityFrameCount_ < depth_) dataCount = parityFrameCount_;
+  int receivedCount = 0;
+  for (int i = 0; i < dataCount; i++) {
+    if (packetSizes_[i] > 0) receivedCount++;
+  }
+  // all data is there or single missing packet can be recovered from parity
+  return receivedCount == dataCount || 
+    (parityFrameCount_ > 0 && packetSizes_[depth_] > 0 && receivedCount == dataCount - 1);
+}
+
+void VoiceFecDecoder::flush()
+{
+  if (isCollecting_) completeBlock();
+  // stream ended, next block could have any sequence number
+  isBlockDone_ = false;
+}
+
+int VoiceFecDecoder::getReceivedFrameCount(int index) const
+{
+  // implicit header packets are zero padded to fixed size, trailing zero frames are padding
+  int frameCount = packetSizes_[index] / frameSize_;
+  if (frameCount > framesPerPacket_) frameCount = framesPerPacket_;
+  while (frameCount > 0) {
+    const uint8_t *frame = getPacket(index) + (frameCount - 1) * frameSize_;
+    int i = 0;
+    while (i < frameSize_ && frame[i] == 0) i++;
+    if (i < frameSize_) break;
+    frameCount--;
+  }
+  return frameCount;
+}
+
+void VoiceFecDecoder::completeBlock()
+{
+  // number of frames, exact from parity, otherwise from the last received frame position
+  int blockFrameCount = parityFrameCount_;
+  if (blockFrameCount == 0) {
+    for (int i = 0; i < depth_; i++) {
+      int packetFrameCount = getReceivedFrameCount(i);
+      if (packetFrameCount > 0 && i + (packetFrameCount - 1) * depth_ + 1 > blockFrameCount)
+        blockFrameCount = i + (packetFrameCount - 1) * depth_ + 1;
+    }
+  }
+  if (blockFrameCount > maxFrames_) blockFrameCount = maxFrames_;
+
+  // recover single missing data packet from parity
+  int dataCount = blockFrameCount < depth_ ? blockFrameCount : depth_;
+  int missingIndex = -1, missingCount = 0;
+  for (int i = 0; i < dataCount; i++) {
+    if (packetSizes_[i] == 0) {
+      missingIndex = i;
+      missingCount++;
+    }
+  }
+  if (missingCount == 1 && packetSizes_[depth_] > 0 && parityFrameCount_ > 0) {
+    uint8_t *recovered = getPacket(missingIndex);
+    int paritySize = packetSizes_[depth_];
+    memcpy(recovered, getPacket(depth_), paritySize);
+    for (int i = 0; i < dataCount; i++) {
+      if (i == missingIndex) continue;
+      const uint8_t *received = getPacket(i);
+      for (int j = 0; j < packetSizes_[i] && j < paritySize; j++) {
+        recovered[j] ^= received[j];
+      }
+    }
+    packetSizes_[missingIndex] = getPacketFrameCount(missingIndex, blockFrameCount) * frameSize_;
+    recoveredCount_++;
+  }
+
+  // deinterleave into original frame order
+  for (int f = 0; f < blockFrameCount; f++) {
+    int index = f % depth_;
+    int offset = (f / depth_) * frameSize_;
+    erased_[f] = offset + frameSize_ > packetSizes_[index];
+    if (erased_[f]) {
+      erasedCount_++;
+    } else {
+      memcpy(frames_ + f * frameSize_, getPacket(index) + offset, frameSize_);
+    }
+  }
+  frameCount_ = blockFrameCount;
+  readFrameIndex_ = 0;
+  isCollecting_ = false;
+  isBlockDone_ = true;
+}
+
+bool VoiceFecDecoder::readFrame(const uint8_t *&frame, bool &isErased)
+{
+  if (readFrameIndex_ >= frameCount_) {
+    // block which followed the read one could be complete already
+    if (isCollecting_ && isBlockComplete())
+      completeBlock();
+    else
+      return false;
+  }
+  if (readFrameIndex_ >= frameCount_) return false;
+  frame = frames_ + readFrameIndex_ * frameSize_;
+  isErased = erased_[readFrameIndex_];
+  readFrameIndex_++;
+  return true;
+}
+
+} // LoraDv
@@ -0,0 +1,71 @@
+#include "voice_header.h"
+#include "config.h"
+
+namespace LoraDv {
+
+uint8_t VoiceHeader::getCodecId(int codecType, int codecMode)
+{
+  if (codecType == CFG_AUDIO_CODEC_OPUS) return CfgCodecOpus;
+  return codecMode & CfgCodecMask;
+}
+
+void VoiceHeader::write(uint8_t *packet, uint8_t codecId, uint8_t seq, bool isEot)
+{
+  packet[0] = (isEot ? CfgEotFlag : 0) | (codecId & CfgCodecMask);
+  packet[1] = seq;
+}
+
+bool VoiceHeader::read(const uint8_t *packet, int packetSize, uint8_t &codecId, uint8_t &seq, bool &isEot)
+{
+  if (packetSize < CfgSize) return false;
+  isEot = packet[0] & CfgEotFlag;
+  codecId = packet[0] & CfgCodecMask;
+  seq = packet[1];
+  return true;
+}
+
+void VoiceHeader::writeSid(uint8_t *packet, uint8_t seq, int noiseLevel)
+{
+  write(packet, CfgCodecNone, seq, false);
+  packet[0] |= CfgSidFlag;
+  noiseLevel >>= CfgSidLevelShift;
+  packet[CfgSize] = noiseLevel > 255 ? 255 : noiseLevel;
+}
+
+bool VoiceHeader::readSid(const uint8_t *packet, int packetSize, int &noiseLevel)
+{
+  if (packetSize < CfgSidSize || (packet[0] & CfgSidFlag) == 0) return false;
+  noiseLevel = packet[CfgSize] << CfgSidLevelShift;
+  return true;
+}
+
+VoiceStreamTracker::VoiceStreamTracker()
+  : stats_{ 0, 0, 0, 0 }
+  , expectedSeq_(0)
+  , isStarted_(false)
+{
+}
+
+void VoiceStreamTracker::reset()
+{
+  // stats are kept, next stream starts with any sequence number
+  isStarted_ = false;
+}
+
+bool VoiceStreamTracker::onPacket(uint8_t seq)
+{
+  if (isStarted_) {
+    uint8_t gap = seq - expectedSeq_;
+    if (gap >= CfgMaxSeqGap) {
+      stats_.duplicated++;
+      return false;
+    }
+    stats_.lost += gap;
+  }
+  isStarted_ = true;
+  expectedSeq_ = seq + 1;
+  stats_.received++;
+  return true;
+}
+
+} // LoraDv